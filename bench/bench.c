@@ -0,0 +1,350 @@
+/*
+ * bench.c -- Onigmo benchmark driver
+ *
+ * Measures compile time, search throughput and per-search latency of
+ * representative workloads in several encodings.  The subject text is
+ * generated from a fixed seed, so runs are reproducible across versions.
+ *
+ * Usage: onigbench [-s seed] [-n bytes] [-i iterations] [-w workload]
+ *
+ * Output is one tab separated line per (encoding, workload), preceded by
+ * header lines starting with '#'.  The columns are the average compile
+ * time (microseconds), the search throughput over the whole subject
+ * (MB/s), the average latency of one onig_search() call (nanoseconds),
+ * the number of matches found in the subject and the memory owned by
+ * the compiled regex (onig_memsize(), bytes).
+ */
+#include "config.h"
+#ifdef ONIG_ESCAPE_UCHAR_COLLISION
+#undef ONIG_ESCAPE_UCHAR_COLLISION
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#include "onigmo.h"
+
+#define DEFAULT_SUBJECT_SIZE   (1024 * 1024)
+#define DEFAULT_ITERATIONS     5
+#define COMPILE_ITERATIONS     200
+#define PATHOLOGICAL_LENGTH    24
+
+typedef struct {
+  const char* name;
+  const char* pattern;   /* ASCII; converted for wide encodings */
+  OnigOptionType option;
+  int pathological;      /* use the short pathological subject */
+} Workload;
+
+static const Workload workloads[] = {
+  { "literal",      "expression",           ONIG_OPTION_NONE, 0 },
+  { "icase",        "(?i)EXPRESSION",       ONIG_OPTION_NONE, 0 },
+  { "alternation",
+    "alpha|bravo|charlie|delta|echo|foxtrot|golf|hotel|india|juliett"
+    "|kilo|lima|mike|november|oscar|papa|quebec|romeo|sierra|tango"
+    "|uniform|victor|whiskey|xray|yankee|zulu",
+                                            ONIG_OPTION_NONE, 0 },
+  { "unicode-class", "\\p{Hiragana}{3,}",   ONIG_OPTION_NONE, 0 },
+  { "backref",      "\\b(\\w+)\\s+\\1\\b",  ONIG_OPTION_NONE, 0 },
+  { "pathological", "\\A(?:a|aa)+\\z",      ONIG_OPTION_NONE, 1 },
+};
+
+typedef struct {
+  const char* name;
+  OnigEncoding enc;
+  OnigCodePoint hiragana_base;   /* code of U+3041 in this encoding */
+} Target;
+
+static Target targets[] = {
+  { "UTF-8",    ONIG_ENCODING_UTF8,     0x3041 },
+  { "SJIS",     ONIG_ENCODING_SJIS,     0x829f },
+  { "UTF-16LE", ONIG_ENCODING_UTF16_LE, 0x3041 },
+};
+
+#define NUM_HIRAGANA  83   /* U+3041..U+3093 are contiguous in SJIS too */
+
+static const char* vocabulary[] = {
+  "regular", "expression", "onigmo", "search", "pattern", "match",
+  "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+  "hotel", "india", "juliett", "kilo", "lima", "mike", "november",
+  "oscar", "papa", "quebec", "romeo", "sierra", "tango", "uniform",
+  "victor", "whiskey", "xray", "yankee", "zulu", "the", "of", "and",
+  "buffer", "stack", "region", "encoding", "Unicode", "EXPRESSION",
+};
+
+#define numberof(a)  (sizeof(a) / sizeof((a)[0]))
+
+static unsigned long rand_state;
+
+static unsigned long
+next_rand(void)
+{
+  rand_state = rand_state * 1103515245UL + 12345UL;
+  return (rand_state >> 16) & 0x7fff;
+}
+
+static double
+now_sec(void)
+{
+#ifdef HAVE_SYS_TIME_H
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double )tv.tv_sec + (double )tv.tv_usec * 1e-6;
+#else
+  return (double )clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static int
+put_code(OnigEncoding enc, OnigCodePoint code, UChar* buf, UChar* buf_end)
+{
+  UChar tmp[ONIGENC_CODE_TO_MBC_MAXLEN];
+  int len;
+
+  len = ONIGENC_CODE_TO_MBC(enc, code, tmp);
+  if (len <= 0 || buf + len > buf_end) return 0;
+  memcpy(buf, tmp, len);
+  return len;
+}
+
+static int
+put_ascii(OnigEncoding enc, const char* s, UChar* buf, UChar* buf_end)
+{
+  int n, total = 0;
+
+  for (; *s != '\0'; s++) {
+    n = put_code(enc, (OnigCodePoint )(unsigned char )*s, buf + total, buf_end);
+    if (n == 0) break;
+    total += n;
+  }
+  return total;
+}
+
+/* Generate about `size' bytes of text: words from the vocabulary,
+   runs of Hiragana, doubled words and line breaks. */
+static UChar*
+make_subject(Target* t, unsigned long seed, size_t size, UChar** end)
+{
+  UChar *buf, *p, *buf_end;
+  const char* word = NULL;
+  int i, n, col = 0;
+
+  buf = (UChar* )malloc(size + ONIGENC_CODE_TO_MBC_MAXLEN);
+  if (buf == NULL) return NULL;
+  buf_end = buf + size;
+  p = buf;
+  rand_state = seed;
+
+  while (p < buf_end) {
+    unsigned long r = next_rand() % 100;
+
+    if (r < 15) {
+      n = 1 + (int )(next_rand() % 5);
+      for (i = 0; i < n; i++)
+	p += put_code(t->enc,
+		      t->hiragana_base + (OnigCodePoint )(next_rand() % NUM_HIRAGANA),
+		      p, buf_end);
+    }
+    else {
+      if (r >= 25 || word == NULL)   /* otherwise repeat the previous word */
+	word = vocabulary[next_rand() % numberof(vocabulary)];
+      p += put_ascii(t->enc, word, p, buf_end);
+    }
+
+    if (++col >= 12) {
+      p += put_code(t->enc, '\n', p, buf_end);
+      col = 0;
+    }
+    else {
+      n = put_code(t->enc, ' ', p, buf_end);
+      if (n == 0) break;
+      p += n;
+    }
+  }
+
+  *end = p;
+  return buf;
+}
+
+static UChar*
+make_pathological_subject(Target* t, UChar** end)
+{
+  UChar *buf, *p, *buf_end;
+  int i;
+
+  buf = (UChar* )malloc((PATHOLOGICAL_LENGTH + 1) * ONIGENC_CODE_TO_MBC_MAXLEN);
+  if (buf == NULL) return NULL;
+  buf_end = buf + (PATHOLOGICAL_LENGTH + 1) * ONIGENC_CODE_TO_MBC_MAXLEN;
+  p = buf;
+  for (i = 0; i < PATHOLOGICAL_LENGTH; i++)
+    p += put_code(t->enc, 'a', p, buf_end);
+  p += put_code(t->enc, '!', p, buf_end);
+  *end = p;
+  return buf;
+}
+
+static int
+compile(Target* t, const Workload* w, regex_t** reg)
+{
+  OnigCompileInfo ci;
+  OnigErrorInfo einfo;
+  const UChar* pat = (const UChar* )w->pattern;
+  int r;
+
+  ci.num_of_elements = 5;
+  ci.pattern_enc     = ONIG_ENCODING_ASCII;
+  ci.target_enc      = t->enc;
+  ci.syntax          = ONIG_SYNTAX_DEFAULT;
+  ci.option          = w->option;
+  ci.case_fold_flag  = ONIGENC_CASE_FOLD_DEFAULT;
+
+  if (ONIGENC_MBC_MINLEN(t->enc) == 1)
+    ci.pattern_enc = t->enc;
+
+  r = onig_new_deluxe(reg, pat, pat + strlen(w->pattern), &ci, &einfo);
+  if (r != ONIG_NORMAL) {
+    UChar s[ONIG_MAX_ERROR_MESSAGE_LEN];
+    onig_error_code_to_str(s, r, &einfo);
+    fprintf(stderr, "ERROR: %s: /%s/: %s\n", t->name, w->pattern, s);
+  }
+  return r;
+}
+
+static int
+run(Target* t, const Workload* w, UChar* str, UChar* end, int iterations)
+{
+  regex_t* reg;
+  OnigRegion* region;
+  double t0, compile_time, search_time;
+  long nmatch = 0, ncall = 0;
+  int i, r;
+  size_t bytes, memsize;
+
+  t0 = now_sec();
+  for (i = 0; i < COMPILE_ITERATIONS; i++) {
+    r = compile(t, w, &reg);
+    if (r != ONIG_NORMAL) return r;
+    onig_free(reg);
+  }
+  compile_time = (now_sec() - t0) / COMPILE_ITERATIONS;
+
+  r = compile(t, w, &reg);
+  if (r != ONIG_NORMAL) return r;
+  memsize = onig_memsize(reg);
+  region = onig_region_new();
+
+  t0 = now_sec();
+  for (i = 0; i < iterations; i++) {
+    UChar* start = str;
+
+    while (start <= end) {
+      OnigPosition pos;
+
+      pos = onig_search(reg, str, end, start, end, region, ONIG_OPTION_NONE);
+      ncall++;
+      if (pos < 0) {
+	if (pos != ONIG_MISMATCH) {
+	  UChar s[ONIG_MAX_ERROR_MESSAGE_LEN];
+	  onig_error_code_to_str(s, pos);
+	  fprintf(stderr, "ERROR: %s: /%s/: %s\n", t->name, w->pattern, s);
+	}
+	break;
+      }
+      nmatch++;
+      if (region->end[0] > pos)
+	start = str + region->end[0];
+      else {
+	start = str + pos;
+	if (start >= end) break;
+	start += onigenc_mbclen_approximate(start, end, t->enc);
+      }
+    }
+  }
+  search_time = now_sec() - t0;
+
+  bytes = (size_t )(end - str) * iterations;
+  printf("%s\t%s\t%.2f\t%.2f\t%.1f\t%ld\t%lu\n", t->name, w->name,
+	 compile_time * 1e6,
+	 search_time > 0 ? (double )bytes / search_time / (1024.0 * 1024.0) : 0.0,
+	 search_time * 1e9 / ncall,
+	 nmatch / iterations, (unsigned long )memsize);
+  fflush(stdout);
+
+  onig_region_free(region, 1);
+  onig_free(reg);
+  return 0;
+}
+
+static void
+usage(const char* prog)
+{
+  fprintf(stderr,
+	  "usage: %s [-s seed] [-n bytes] [-i iterations] [-w workload]\n",
+	  prog);
+}
+
+extern int
+main(int argc, char* argv[])
+{
+  unsigned long seed = 1;
+  size_t size = DEFAULT_SUBJECT_SIZE;
+  int iterations = DEFAULT_ITERATIONS;
+  const char* only = NULL;
+  int i, j, r = 0;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-s") == 0)
+      seed = strtoul(argv[++i], NULL, 10);
+    else if (i + 1 < argc && strcmp(argv[i], "-n") == 0)
+      size = (size_t )strtoul(argv[++i], NULL, 10);
+    else if (i + 1 < argc && strcmp(argv[i], "-i") == 0)
+      iterations = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-w") == 0)
+      only = argv[++i];
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (iterations <= 0) iterations = 1;
+
+  onig_init();
+
+  printf("# %s seed=%lu bytes=%lu iterations=%d\n", onig_version(),
+	 seed, (unsigned long )size, iterations);
+  printf("# encoding\tworkload\tcompile_us\tsearch_mb_s\tcall_ns\tmatches\tmemsize\n");
+
+  for (i = 0; i < (int )numberof(targets); i++) {
+    Target* t = &targets[i];
+    UChar *text, *text_end, *patho, *patho_end;
+
+    text  = make_subject(t, seed, size, &text_end);
+    patho = make_pathological_subject(t, &patho_end);
+    if (text == NULL || patho == NULL) {
+      fprintf(stderr, "ERROR: memory\n");
+      return 1;
+    }
+
+    for (j = 0; j < (int )numberof(workloads); j++) {
+      const Workload* w = &workloads[j];
+
+      if (only != NULL && strcmp(only, w->name) != 0) continue;
+      if (w->pathological)
+	r |= run(t, w, patho, patho_end, iterations);
+      else
+	r |= run(t, w, text, text_end, iterations);
+    }
+
+    free(text);
+    free(patho);
+  }
+
+  onig_end();
+  return r != 0;
+}
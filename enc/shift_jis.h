@@ -316,7 +316,7 @@ get_upper_case(OnigCodePoint code)
 	   ONIGENC_IS_IN_RANGE(code, 0x8480, 0x8491)) {
     /* Cyrillic */
     int d = (code >= 0x8480) ? 1 : 0;
-    return (OnigCodePoint )(code - (0x0030 - d));
+    return (OnigCodePoint )(code - (0x0030 + d));
   }
   return code;
 }
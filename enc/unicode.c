@@ -218,6 +218,46 @@ onigenc_utf16_32_get_ctype_code_range(OnigCtype ctype, OnigCodePoint* sb_out,
   return onigenc_unicode_ctype_code_range(ctype, ranges);
 }
 
+#ifdef USE_UNICODE_PROPERTIES
+typedef struct {
+  OnigCodePoint from;
+  OnigCodePoint to;
+  int gcb;
+} GraphemeBreakRange;
+
+# include "graphemebreak.h"
+
+/* One lookup classifies a code point for all the rules of \X. */
+extern int
+onigenc_unicode_grapheme_cluster_break(OnigCodePoint code)
+{
+  int low, high, mid;
+
+  if (code < 0x80) {
+    if (code == 0x0d) return ONIGENC_GCB_CR;
+    if (code == 0x0a) return ONIGENC_GCB_LF;
+    if (code < 0x20 || code == 0x7f) return ONIGENC_GCB_CONTROL;
+    return ONIGENC_GCB_OTHER;
+  }
+  if (code >= 0xac00 && code <= 0xd7a3)   /* Hangul syllables */
+    return ((code - 0xac00) % 28 == 0) ? ONIGENC_GCB_LV : ONIGENC_GCB_LVT;
+
+  low  = 0;
+  high = numberof(GraphemeBreakTable);
+  while (low < high) {
+    mid = (low + high) >> 1;
+    if (code > GraphemeBreakTable[mid].to)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low < numberof(GraphemeBreakTable) &&
+      code >= GraphemeBreakTable[low].from)
+    return GraphemeBreakTable[low].gcb;
+  return ONIGENC_GCB_OTHER;
+}
+#endif /* USE_UNICODE_PROPERTIES */
+
 #define PROPERTY_NAME_MAX_SIZE    (MAX_WORD_LENGTH + 1)
 
 extern int
@@ -0,0 +1,605 @@
+/* This file was generated by tool/grapheme-break.py. */
+
+/* Grapheme_Cluster_Break (and Extended_Pictographic) of the code
+ * points above U+007F, except Hangul syllables. */
+static const GraphemeBreakRange GraphemeBreakTable[] = {
+  { 0x00a9, 0x00a9, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x00ad, 0x00ad, ONIGENC_GCB_CONTROL },
+  { 0x00ae, 0x00ae, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x0300, 0x036f, ONIGENC_GCB_EXTEND },
+  { 0x0483, 0x0489, ONIGENC_GCB_EXTEND },
+  { 0x0591, 0x05bd, ONIGENC_GCB_EXTEND },
+  { 0x05bf, 0x05bf, ONIGENC_GCB_EXTEND },
+  { 0x05c1, 0x05c2, ONIGENC_GCB_EXTEND },
+  { 0x05c4, 0x05c5, ONIGENC_GCB_EXTEND },
+  { 0x05c7, 0x05c7, ONIGENC_GCB_EXTEND },
+  { 0x0600, 0x0605, ONIGENC_GCB_PREPEND },
+  { 0x0610, 0x061a, ONIGENC_GCB_EXTEND },
+  { 0x061c, 0x061c, ONIGENC_GCB_CONTROL },
+  { 0x064b, 0x065f, ONIGENC_GCB_EXTEND },
+  { 0x0670, 0x0670, ONIGENC_GCB_EXTEND },
+  { 0x06d6, 0x06dc, ONIGENC_GCB_EXTEND },
+  { 0x06dd, 0x06dd, ONIGENC_GCB_PREPEND },
+  { 0x06df, 0x06e4, ONIGENC_GCB_EXTEND },
+  { 0x06e7, 0x06e8, ONIGENC_GCB_EXTEND },
+  { 0x06ea, 0x06ed, ONIGENC_GCB_EXTEND },
+  { 0x070f, 0x070f, ONIGENC_GCB_PREPEND },
+  { 0x0711, 0x0711, ONIGENC_GCB_EXTEND },
+  { 0x0730, 0x074a, ONIGENC_GCB_EXTEND },
+  { 0x07a6, 0x07b0, ONIGENC_GCB_EXTEND },
+  { 0x07eb, 0x07f3, ONIGENC_GCB_EXTEND },
+  { 0x07fd, 0x07fd, ONIGENC_GCB_EXTEND },
+  { 0x0816, 0x0819, ONIGENC_GCB_EXTEND },
+  { 0x081b, 0x0823, ONIGENC_GCB_EXTEND },
+  { 0x0825, 0x0827, ONIGENC_GCB_EXTEND },
+  { 0x0829, 0x082d, ONIGENC_GCB_EXTEND },
+  { 0x0859, 0x085b, ONIGENC_GCB_EXTEND },
+  { 0x08d3, 0x08e1, ONIGENC_GCB_EXTEND },
+  { 0x08e2, 0x08e2, ONIGENC_GCB_PREPEND },
+  { 0x08e3, 0x0902, ONIGENC_GCB_EXTEND },
+  { 0x0903, 0x0903, ONIGENC_GCB_SPACINGMARK },
+  { 0x093a, 0x093a, ONIGENC_GCB_EXTEND },
+  { 0x093b, 0x093b, ONIGENC_GCB_SPACINGMARK },
+  { 0x093c, 0x093c, ONIGENC_GCB_EXTEND },
+  { 0x093e, 0x0940, ONIGENC_GCB_SPACINGMARK },
+  { 0x0941, 0x0948, ONIGENC_GCB_EXTEND },
+  { 0x0949, 0x094c, ONIGENC_GCB_SPACINGMARK },
+  { 0x094d, 0x094d, ONIGENC_GCB_EXTEND },
+  { 0x094e, 0x094f, ONIGENC_GCB_SPACINGMARK },
+  { 0x0951, 0x0957, ONIGENC_GCB_EXTEND },
+  { 0x0962, 0x0963, ONIGENC_GCB_EXTEND },
+  { 0x0981, 0x0981, ONIGENC_GCB_EXTEND },
+  { 0x0982, 0x0983, ONIGENC_GCB_SPACINGMARK },
+  { 0x09bc, 0x09bc, ONIGENC_GCB_EXTEND },
+  { 0x09be, 0x09be, ONIGENC_GCB_EXTEND },
+  { 0x09bf, 0x09c0, ONIGENC_GCB_SPACINGMARK },
+  { 0x09c1, 0x09c4, ONIGENC_GCB_EXTEND },
+  { 0x09c7, 0x09c8, ONIGENC_GCB_SPACINGMARK },
+  { 0x09cb, 0x09cc, ONIGENC_GCB_SPACINGMARK },
+  { 0x09cd, 0x09cd, ONIGENC_GCB_EXTEND },
+  { 0x09d7, 0x09d7, ONIGENC_GCB_EXTEND },
+  { 0x09e2, 0x09e3, ONIGENC_GCB_EXTEND },
+  { 0x09fe, 0x09fe, ONIGENC_GCB_EXTEND },
+  { 0x0a01, 0x0a02, ONIGENC_GCB_EXTEND },
+  { 0x0a03, 0x0a03, ONIGENC_GCB_SPACINGMARK },
+  { 0x0a3c, 0x0a3c, ONIGENC_GCB_EXTEND },
+  { 0x0a3e, 0x0a40, ONIGENC_GCB_SPACINGMARK },
+  { 0x0a41, 0x0a42, ONIGENC_GCB_EXTEND },
+  { 0x0a47, 0x0a48, ONIGENC_GCB_EXTEND },
+  { 0x0a4b, 0x0a4d, ONIGENC_GCB_EXTEND },
+  { 0x0a51, 0x0a51, ONIGENC_GCB_EXTEND },
+  { 0x0a70, 0x0a71, ONIGENC_GCB_EXTEND },
+  { 0x0a75, 0x0a75, ONIGENC_GCB_EXTEND },
+  { 0x0a81, 0x0a82, ONIGENC_GCB_EXTEND },
+  { 0x0a83, 0x0a83, ONIGENC_GCB_SPACINGMARK },
+  { 0x0abc, 0x0abc, ONIGENC_GCB_EXTEND },
+  { 0x0abe, 0x0ac0, ONIGENC_GCB_SPACINGMARK },
+  { 0x0ac1, 0x0ac5, ONIGENC_GCB_EXTEND },
+  { 0x0ac7, 0x0ac8, ONIGENC_GCB_EXTEND },
+  { 0x0ac9, 0x0ac9, ONIGENC_GCB_SPACINGMARK },
+  { 0x0acb, 0x0acc, ONIGENC_GCB_SPACINGMARK },
+  { 0x0acd, 0x0acd, ONIGENC_GCB_EXTEND },
+  { 0x0ae2, 0x0ae3, ONIGENC_GCB_EXTEND },
+  { 0x0afa, 0x0aff, ONIGENC_GCB_EXTEND },
+  { 0x0b01, 0x0b01, ONIGENC_GCB_EXTEND },
+  { 0x0b02, 0x0b03, ONIGENC_GCB_SPACINGMARK },
+  { 0x0b3c, 0x0b3c, ONIGENC_GCB_EXTEND },
+  { 0x0b3e, 0x0b3f, ONIGENC_GCB_EXTEND },
+  { 0x0b40, 0x0b40, ONIGENC_GCB_SPACINGMARK },
+  { 0x0b41, 0x0b44, ONIGENC_GCB_EXTEND },
+  { 0x0b47, 0x0b48, ONIGENC_GCB_SPACINGMARK },
+  { 0x0b4b, 0x0b4c, ONIGENC_GCB_SPACINGMARK },
+  { 0x0b4d, 0x0b4d, ONIGENC_GCB_EXTEND },
+  { 0x0b56, 0x0b57, ONIGENC_GCB_EXTEND },
+  { 0x0b62, 0x0b63, ONIGENC_GCB_EXTEND },
+  { 0x0b82, 0x0b82, ONIGENC_GCB_EXTEND },
+  { 0x0bbe, 0x0bbe, ONIGENC_GCB_EXTEND },
+  { 0x0bbf, 0x0bbf, ONIGENC_GCB_SPACINGMARK },
+  { 0x0bc0, 0x0bc0, ONIGENC_GCB_EXTEND },
+  { 0x0bc1, 0x0bc2, ONIGENC_GCB_SPACINGMARK },
+  { 0x0bc6, 0x0bc8, ONIGENC_GCB_SPACINGMARK },
+  { 0x0bca, 0x0bcc, ONIGENC_GCB_SPACINGMARK },
+  { 0x0bcd, 0x0bcd, ONIGENC_GCB_EXTEND },
+  { 0x0bd7, 0x0bd7, ONIGENC_GCB_EXTEND },
+  { 0x0c00, 0x0c00, ONIGENC_GCB_EXTEND },
+  { 0x0c01, 0x0c03, ONIGENC_GCB_SPACINGMARK },
+  { 0x0c04, 0x0c04, ONIGENC_GCB_EXTEND },
+  { 0x0c3e, 0x0c40, ONIGENC_GCB_EXTEND },
+  { 0x0c41, 0x0c44, ONIGENC_GCB_SPACINGMARK },
+  { 0x0c46, 0x0c48, ONIGENC_GCB_EXTEND },
+  { 0x0c4a, 0x0c4d, ONIGENC_GCB_EXTEND },
+  { 0x0c55, 0x0c56, ONIGENC_GCB_EXTEND },
+  { 0x0c62, 0x0c63, ONIGENC_GCB_EXTEND },
+  { 0x0c81, 0x0c81, ONIGENC_GCB_EXTEND },
+  { 0x0c82, 0x0c83, ONIGENC_GCB_SPACINGMARK },
+  { 0x0cbc, 0x0cbc, ONIGENC_GCB_EXTEND },
+  { 0x0cbe, 0x0cbe, ONIGENC_GCB_SPACINGMARK },
+  { 0x0cbf, 0x0cbf, ONIGENC_GCB_EXTEND },
+  { 0x0cc0, 0x0cc1, ONIGENC_GCB_SPACINGMARK },
+  { 0x0cc2, 0x0cc2, ONIGENC_GCB_EXTEND },
+  { 0x0cc3, 0x0cc4, ONIGENC_GCB_SPACINGMARK },
+  { 0x0cc6, 0x0cc6, ONIGENC_GCB_EXTEND },
+  { 0x0cc7, 0x0cc8, ONIGENC_GCB_SPACINGMARK },
+  { 0x0cca, 0x0ccb, ONIGENC_GCB_SPACINGMARK },
+  { 0x0ccc, 0x0ccd, ONIGENC_GCB_EXTEND },
+  { 0x0cd5, 0x0cd6, ONIGENC_GCB_EXTEND },
+  { 0x0ce2, 0x0ce3, ONIGENC_GCB_EXTEND },
+  { 0x0d00, 0x0d01, ONIGENC_GCB_EXTEND },
+  { 0x0d02, 0x0d03, ONIGENC_GCB_SPACINGMARK },
+  { 0x0d3b, 0x0d3c, ONIGENC_GCB_EXTEND },
+  { 0x0d3e, 0x0d3e, ONIGENC_GCB_EXTEND },
+  { 0x0d3f, 0x0d40, ONIGENC_GCB_SPACINGMARK },
+  { 0x0d41, 0x0d44, ONIGENC_GCB_EXTEND },
+  { 0x0d46, 0x0d48, ONIGENC_GCB_SPACINGMARK },
+  { 0x0d4a, 0x0d4c, ONIGENC_GCB_SPACINGMARK },
+  { 0x0d4d, 0x0d4d, ONIGENC_GCB_EXTEND },
+  { 0x0d4e, 0x0d4e, ONIGENC_GCB_PREPEND },
+  { 0x0d57, 0x0d57, ONIGENC_GCB_EXTEND },
+  { 0x0d62, 0x0d63, ONIGENC_GCB_EXTEND },
+  { 0x0d82, 0x0d83, ONIGENC_GCB_SPACINGMARK },
+  { 0x0dca, 0x0dca, ONIGENC_GCB_EXTEND },
+  { 0x0dcf, 0x0dcf, ONIGENC_GCB_EXTEND },
+  { 0x0dd0, 0x0dd1, ONIGENC_GCB_SPACINGMARK },
+  { 0x0dd2, 0x0dd4, ONIGENC_GCB_EXTEND },
+  { 0x0dd6, 0x0dd6, ONIGENC_GCB_EXTEND },
+  { 0x0dd8, 0x0dde, ONIGENC_GCB_SPACINGMARK },
+  { 0x0ddf, 0x0ddf, ONIGENC_GCB_EXTEND },
+  { 0x0df2, 0x0df3, ONIGENC_GCB_SPACINGMARK },
+  { 0x0e31, 0x0e31, ONIGENC_GCB_EXTEND },
+  { 0x0e33, 0x0e33, ONIGENC_GCB_SPACINGMARK },
+  { 0x0e34, 0x0e3a, ONIGENC_GCB_EXTEND },
+  { 0x0e47, 0x0e4e, ONIGENC_GCB_EXTEND },
+  { 0x0eb1, 0x0eb1, ONIGENC_GCB_EXTEND },
+  { 0x0eb3, 0x0eb3, ONIGENC_GCB_SPACINGMARK },
+  { 0x0eb4, 0x0ebc, ONIGENC_GCB_EXTEND },
+  { 0x0ec8, 0x0ecd, ONIGENC_GCB_EXTEND },
+  { 0x0f18, 0x0f19, ONIGENC_GCB_EXTEND },
+  { 0x0f35, 0x0f35, ONIGENC_GCB_EXTEND },
+  { 0x0f37, 0x0f37, ONIGENC_GCB_EXTEND },
+  { 0x0f39, 0x0f39, ONIGENC_GCB_EXTEND },
+  { 0x0f3e, 0x0f3f, ONIGENC_GCB_SPACINGMARK },
+  { 0x0f71, 0x0f7e, ONIGENC_GCB_EXTEND },
+  { 0x0f7f, 0x0f7f, ONIGENC_GCB_SPACINGMARK },
+  { 0x0f80, 0x0f84, ONIGENC_GCB_EXTEND },
+  { 0x0f86, 0x0f87, ONIGENC_GCB_EXTEND },
+  { 0x0f8d, 0x0f97, ONIGENC_GCB_EXTEND },
+  { 0x0f99, 0x0fbc, ONIGENC_GCB_EXTEND },
+  { 0x0fc6, 0x0fc6, ONIGENC_GCB_EXTEND },
+  { 0x102d, 0x1030, ONIGENC_GCB_EXTEND },
+  { 0x1031, 0x1031, ONIGENC_GCB_SPACINGMARK },
+  { 0x1032, 0x1037, ONIGENC_GCB_EXTEND },
+  { 0x1039, 0x103a, ONIGENC_GCB_EXTEND },
+  { 0x103b, 0x103c, ONIGENC_GCB_SPACINGMARK },
+  { 0x103d, 0x103e, ONIGENC_GCB_EXTEND },
+  { 0x1056, 0x1057, ONIGENC_GCB_SPACINGMARK },
+  { 0x1058, 0x1059, ONIGENC_GCB_EXTEND },
+  { 0x105e, 0x1060, ONIGENC_GCB_EXTEND },
+  { 0x1071, 0x1074, ONIGENC_GCB_EXTEND },
+  { 0x1082, 0x1082, ONIGENC_GCB_EXTEND },
+  { 0x1084, 0x1084, ONIGENC_GCB_SPACINGMARK },
+  { 0x1085, 0x1086, ONIGENC_GCB_EXTEND },
+  { 0x108d, 0x108d, ONIGENC_GCB_EXTEND },
+  { 0x109d, 0x109d, ONIGENC_GCB_EXTEND },
+  { 0x1100, 0x115f, ONIGENC_GCB_L },
+  { 0x1160, 0x11a7, ONIGENC_GCB_V },
+  { 0x11a8, 0x11ff, ONIGENC_GCB_T },
+  { 0x135d, 0x135f, ONIGENC_GCB_EXTEND },
+  { 0x1712, 0x1714, ONIGENC_GCB_EXTEND },
+  { 0x1732, 0x1734, ONIGENC_GCB_EXTEND },
+  { 0x1752, 0x1753, ONIGENC_GCB_EXTEND },
+  { 0x1772, 0x1773, ONIGENC_GCB_EXTEND },
+  { 0x17b4, 0x17b5, ONIGENC_GCB_EXTEND },
+  { 0x17b6, 0x17b6, ONIGENC_GCB_SPACINGMARK },
+  { 0x17b7, 0x17bd, ONIGENC_GCB_EXTEND },
+  { 0x17be, 0x17c5, ONIGENC_GCB_SPACINGMARK },
+  { 0x17c6, 0x17c6, ONIGENC_GCB_EXTEND },
+  { 0x17c7, 0x17c8, ONIGENC_GCB_SPACINGMARK },
+  { 0x17c9, 0x17d3, ONIGENC_GCB_EXTEND },
+  { 0x17dd, 0x17dd, ONIGENC_GCB_EXTEND },
+  { 0x180b, 0x180d, ONIGENC_GCB_EXTEND },
+  { 0x180e, 0x180e, ONIGENC_GCB_CONTROL },
+  { 0x1885, 0x1886, ONIGENC_GCB_EXTEND },
+  { 0x18a9, 0x18a9, ONIGENC_GCB_EXTEND },
+  { 0x1920, 0x1922, ONIGENC_GCB_EXTEND },
+  { 0x1923, 0x1926, ONIGENC_GCB_SPACINGMARK },
+  { 0x1927, 0x1928, ONIGENC_GCB_EXTEND },
+  { 0x1929, 0x192b, ONIGENC_GCB_SPACINGMARK },
+  { 0x1930, 0x1931, ONIGENC_GCB_SPACINGMARK },
+  { 0x1932, 0x1932, ONIGENC_GCB_EXTEND },
+  { 0x1933, 0x1938, ONIGENC_GCB_SPACINGMARK },
+  { 0x1939, 0x193b, ONIGENC_GCB_EXTEND },
+  { 0x1a17, 0x1a18, ONIGENC_GCB_EXTEND },
+  { 0x1a19, 0x1a1a, ONIGENC_GCB_SPACINGMARK },
+  { 0x1a1b, 0x1a1b, ONIGENC_GCB_EXTEND },
+  { 0x1a55, 0x1a55, ONIGENC_GCB_SPACINGMARK },
+  { 0x1a56, 0x1a56, ONIGENC_GCB_EXTEND },
+  { 0x1a57, 0x1a57, ONIGENC_GCB_SPACINGMARK },
+  { 0x1a58, 0x1a5e, ONIGENC_GCB_EXTEND },
+  { 0x1a60, 0x1a60, ONIGENC_GCB_EXTEND },
+  { 0x1a62, 0x1a62, ONIGENC_GCB_EXTEND },
+  { 0x1a65, 0x1a6c, ONIGENC_GCB_EXTEND },
+  { 0x1a6d, 0x1a72, ONIGENC_GCB_SPACINGMARK },
+  { 0x1a73, 0x1a7c, ONIGENC_GCB_EXTEND },
+  { 0x1a7f, 0x1a7f, ONIGENC_GCB_EXTEND },
+  { 0x1ab0, 0x1abe, ONIGENC_GCB_EXTEND },
+  { 0x1b00, 0x1b03, ONIGENC_GCB_EXTEND },
+  { 0x1b04, 0x1b04, ONIGENC_GCB_SPACINGMARK },
+  { 0x1b34, 0x1b3a, ONIGENC_GCB_EXTEND },
+  { 0x1b3b, 0x1b3b, ONIGENC_GCB_SPACINGMARK },
+  { 0x1b3c, 0x1b3c, ONIGENC_GCB_EXTEND },
+  { 0x1b3d, 0x1b41, ONIGENC_GCB_SPACINGMARK },
+  { 0x1b42, 0x1b42, ONIGENC_GCB_EXTEND },
+  { 0x1b43, 0x1b44, ONIGENC_GCB_SPACINGMARK },
+  { 0x1b6b, 0x1b73, ONIGENC_GCB_EXTEND },
+  { 0x1b80, 0x1b81, ONIGENC_GCB_EXTEND },
+  { 0x1b82, 0x1b82, ONIGENC_GCB_SPACINGMARK },
+  { 0x1ba1, 0x1ba1, ONIGENC_GCB_SPACINGMARK },
+  { 0x1ba2, 0x1ba5, ONIGENC_GCB_EXTEND },
+  { 0x1ba6, 0x1ba7, ONIGENC_GCB_SPACINGMARK },
+  { 0x1ba8, 0x1ba9, ONIGENC_GCB_EXTEND },
+  { 0x1baa, 0x1baa, ONIGENC_GCB_SPACINGMARK },
+  { 0x1bab, 0x1bad, ONIGENC_GCB_EXTEND },
+  { 0x1be6, 0x1be6, ONIGENC_GCB_EXTEND },
+  { 0x1be7, 0x1be7, ONIGENC_GCB_SPACINGMARK },
+  { 0x1be8, 0x1be9, ONIGENC_GCB_EXTEND },
+  { 0x1bea, 0x1bec, ONIGENC_GCB_SPACINGMARK },
+  { 0x1bed, 0x1bed, ONIGENC_GCB_EXTEND },
+  { 0x1bee, 0x1bee, ONIGENC_GCB_SPACINGMARK },
+  { 0x1bef, 0x1bf1, ONIGENC_GCB_EXTEND },
+  { 0x1bf2, 0x1bf3, ONIGENC_GCB_SPACINGMARK },
+  { 0x1c24, 0x1c2b, ONIGENC_GCB_SPACINGMARK },
+  { 0x1c2c, 0x1c33, ONIGENC_GCB_EXTEND },
+  { 0x1c34, 0x1c35, ONIGENC_GCB_SPACINGMARK },
+  { 0x1c36, 0x1c37, ONIGENC_GCB_EXTEND },
+  { 0x1cd0, 0x1cd2, ONIGENC_GCB_EXTEND },
+  { 0x1cd4, 0x1ce0, ONIGENC_GCB_EXTEND },
+  { 0x1ce1, 0x1ce1, ONIGENC_GCB_SPACINGMARK },
+  { 0x1ce2, 0x1ce8, ONIGENC_GCB_EXTEND },
+  { 0x1ced, 0x1ced, ONIGENC_GCB_EXTEND },
+  { 0x1cf4, 0x1cf4, ONIGENC_GCB_EXTEND },
+  { 0x1cf7, 0x1cf7, ONIGENC_GCB_SPACINGMARK },
+  { 0x1cf8, 0x1cf9, ONIGENC_GCB_EXTEND },
+  { 0x1dc0, 0x1df9, ONIGENC_GCB_EXTEND },
+  { 0x1dfb, 0x1dff, ONIGENC_GCB_EXTEND },
+  { 0x200b, 0x200b, ONIGENC_GCB_CONTROL },
+  { 0x200c, 0x200c, ONIGENC_GCB_EXTEND },
+  { 0x200d, 0x200d, ONIGENC_GCB_ZWJ },
+  { 0x200e, 0x200f, ONIGENC_GCB_CONTROL },
+  { 0x2028, 0x202e, ONIGENC_GCB_CONTROL },
+  { 0x203c, 0x203c, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2049, 0x2049, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2060, 0x206f, ONIGENC_GCB_CONTROL },
+  { 0x20d0, 0x20f0, ONIGENC_GCB_EXTEND },
+  { 0x2122, 0x2122, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2139, 0x2139, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2194, 0x2199, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x21a9, 0x21aa, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x231a, 0x231b, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2328, 0x2328, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2388, 0x2388, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x23cf, 0x23cf, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x23e9, 0x23f3, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x23f8, 0x23fa, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x24c2, 0x24c2, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x25aa, 0x25ab, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x25b6, 0x25b6, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x25c0, 0x25c0, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x25fb, 0x25fe, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2600, 0x2605, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2607, 0x2612, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2614, 0x2685, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2690, 0x2705, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2708, 0x2712, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2714, 0x2714, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2716, 0x2716, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x271d, 0x271d, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2721, 0x2721, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2728, 0x2728, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2733, 0x2734, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2744, 0x2744, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2747, 0x2747, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x274c, 0x274c, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x274e, 0x274e, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2753, 0x2755, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2757, 0x2757, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2763, 0x2767, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2795, 0x2797, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x27a1, 0x27a1, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x27b0, 0x27b0, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x27bf, 0x27bf, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2934, 0x2935, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2b05, 0x2b07, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2b1b, 0x2b1c, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2b50, 0x2b50, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2b55, 0x2b55, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x2cef, 0x2cf1, ONIGENC_GCB_EXTEND },
+  { 0x2d7f, 0x2d7f, ONIGENC_GCB_EXTEND },
+  { 0x2de0, 0x2dff, ONIGENC_GCB_EXTEND },
+  { 0x302a, 0x302f, ONIGENC_GCB_EXTEND },
+  { 0x3030, 0x3030, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x303d, 0x303d, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x3099, 0x309a, ONIGENC_GCB_EXTEND },
+  { 0x3297, 0x3297, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x3299, 0x3299, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0xa66f, 0xa672, ONIGENC_GCB_EXTEND },
+  { 0xa674, 0xa67d, ONIGENC_GCB_EXTEND },
+  { 0xa69e, 0xa69f, ONIGENC_GCB_EXTEND },
+  { 0xa6f0, 0xa6f1, ONIGENC_GCB_EXTEND },
+  { 0xa802, 0xa802, ONIGENC_GCB_EXTEND },
+  { 0xa806, 0xa806, ONIGENC_GCB_EXTEND },
+  { 0xa80b, 0xa80b, ONIGENC_GCB_EXTEND },
+  { 0xa823, 0xa824, ONIGENC_GCB_SPACINGMARK },
+  { 0xa825, 0xa826, ONIGENC_GCB_EXTEND },
+  { 0xa827, 0xa827, ONIGENC_GCB_SPACINGMARK },
+  { 0xa880, 0xa881, ONIGENC_GCB_SPACINGMARK },
+  { 0xa8b4, 0xa8c3, ONIGENC_GCB_SPACINGMARK },
+  { 0xa8c4, 0xa8c5, ONIGENC_GCB_EXTEND },
+  { 0xa8e0, 0xa8f1, ONIGENC_GCB_EXTEND },
+  { 0xa8ff, 0xa8ff, ONIGENC_GCB_EXTEND },
+  { 0xa926, 0xa92d, ONIGENC_GCB_EXTEND },
+  { 0xa947, 0xa951, ONIGENC_GCB_EXTEND },
+  { 0xa952, 0xa953, ONIGENC_GCB_SPACINGMARK },
+  { 0xa960, 0xa97c, ONIGENC_GCB_L },
+  { 0xa980, 0xa982, ONIGENC_GCB_EXTEND },
+  { 0xa983, 0xa983, ONIGENC_GCB_SPACINGMARK },
+  { 0xa9b3, 0xa9b3, ONIGENC_GCB_EXTEND },
+  { 0xa9b4, 0xa9b5, ONIGENC_GCB_SPACINGMARK },
+  { 0xa9b6, 0xa9b9, ONIGENC_GCB_EXTEND },
+  { 0xa9ba, 0xa9bb, ONIGENC_GCB_SPACINGMARK },
+  { 0xa9bc, 0xa9bd, ONIGENC_GCB_EXTEND },
+  { 0xa9be, 0xa9c0, ONIGENC_GCB_SPACINGMARK },
+  { 0xa9e5, 0xa9e5, ONIGENC_GCB_EXTEND },
+  { 0xaa29, 0xaa2e, ONIGENC_GCB_EXTEND },
+  { 0xaa2f, 0xaa30, ONIGENC_GCB_SPACINGMARK },
+  { 0xaa31, 0xaa32, ONIGENC_GCB_EXTEND },
+  { 0xaa33, 0xaa34, ONIGENC_GCB_SPACINGMARK },
+  { 0xaa35, 0xaa36, ONIGENC_GCB_EXTEND },
+  { 0xaa43, 0xaa43, ONIGENC_GCB_EXTEND },
+  { 0xaa4c, 0xaa4c, ONIGENC_GCB_EXTEND },
+  { 0xaa4d, 0xaa4d, ONIGENC_GCB_SPACINGMARK },
+  { 0xaa7c, 0xaa7c, ONIGENC_GCB_EXTEND },
+  { 0xaab0, 0xaab0, ONIGENC_GCB_EXTEND },
+  { 0xaab2, 0xaab4, ONIGENC_GCB_EXTEND },
+  { 0xaab7, 0xaab8, ONIGENC_GCB_EXTEND },
+  { 0xaabe, 0xaabf, ONIGENC_GCB_EXTEND },
+  { 0xaac1, 0xaac1, ONIGENC_GCB_EXTEND },
+  { 0xaaeb, 0xaaeb, ONIGENC_GCB_SPACINGMARK },
+  { 0xaaec, 0xaaed, ONIGENC_GCB_EXTEND },
+  { 0xaaee, 0xaaef, ONIGENC_GCB_SPACINGMARK },
+  { 0xaaf5, 0xaaf5, ONIGENC_GCB_SPACINGMARK },
+  { 0xaaf6, 0xaaf6, ONIGENC_GCB_EXTEND },
+  { 0xabe3, 0xabe4, ONIGENC_GCB_SPACINGMARK },
+  { 0xabe5, 0xabe5, ONIGENC_GCB_EXTEND },
+  { 0xabe6, 0xabe7, ONIGENC_GCB_SPACINGMARK },
+  { 0xabe8, 0xabe8, ONIGENC_GCB_EXTEND },
+  { 0xabe9, 0xabea, ONIGENC_GCB_SPACINGMARK },
+  { 0xabec, 0xabec, ONIGENC_GCB_SPACINGMARK },
+  { 0xabed, 0xabed, ONIGENC_GCB_EXTEND },
+  { 0xd7b0, 0xd7c6, ONIGENC_GCB_V },
+  { 0xd7cb, 0xd7fb, ONIGENC_GCB_T },
+  { 0xfb1e, 0xfb1e, ONIGENC_GCB_EXTEND },
+  { 0xfe00, 0xfe0f, ONIGENC_GCB_EXTEND },
+  { 0xfe20, 0xfe2f, ONIGENC_GCB_EXTEND },
+  { 0xfeff, 0xfeff, ONIGENC_GCB_CONTROL },
+  { 0xff9e, 0xff9f, ONIGENC_GCB_EXTEND },
+  { 0xfff0, 0xfffb, ONIGENC_GCB_CONTROL },
+  { 0x101fd, 0x101fd, ONIGENC_GCB_EXTEND },
+  { 0x102e0, 0x102e0, ONIGENC_GCB_EXTEND },
+  { 0x10376, 0x1037a, ONIGENC_GCB_EXTEND },
+  { 0x10a01, 0x10a03, ONIGENC_GCB_EXTEND },
+  { 0x10a05, 0x10a06, ONIGENC_GCB_EXTEND },
+  { 0x10a0c, 0x10a0f, ONIGENC_GCB_EXTEND },
+  { 0x10a38, 0x10a3a, ONIGENC_GCB_EXTEND },
+  { 0x10a3f, 0x10a3f, ONIGENC_GCB_EXTEND },
+  { 0x10ae5, 0x10ae6, ONIGENC_GCB_EXTEND },
+  { 0x10d24, 0x10d27, ONIGENC_GCB_EXTEND },
+  { 0x10f46, 0x10f50, ONIGENC_GCB_EXTEND },
+  { 0x11000, 0x11000, ONIGENC_GCB_SPACINGMARK },
+  { 0x11001, 0x11001, ONIGENC_GCB_EXTEND },
+  { 0x11002, 0x11002, ONIGENC_GCB_SPACINGMARK },
+  { 0x11038, 0x11046, ONIGENC_GCB_EXTEND },
+  { 0x1107f, 0x11081, ONIGENC_GCB_EXTEND },
+  { 0x11082, 0x11082, ONIGENC_GCB_SPACINGMARK },
+  { 0x110b0, 0x110b2, ONIGENC_GCB_SPACINGMARK },
+  { 0x110b3, 0x110b6, ONIGENC_GCB_EXTEND },
+  { 0x110b7, 0x110b8, ONIGENC_GCB_SPACINGMARK },
+  { 0x110b9, 0x110ba, ONIGENC_GCB_EXTEND },
+  { 0x110bd, 0x110bd, ONIGENC_GCB_PREPEND },
+  { 0x110cd, 0x110cd, ONIGENC_GCB_PREPEND },
+  { 0x11100, 0x11102, ONIGENC_GCB_EXTEND },
+  { 0x11127, 0x1112b, ONIGENC_GCB_EXTEND },
+  { 0x1112c, 0x1112c, ONIGENC_GCB_SPACINGMARK },
+  { 0x1112d, 0x11134, ONIGENC_GCB_EXTEND },
+  { 0x11145, 0x11146, ONIGENC_GCB_SPACINGMARK },
+  { 0x11173, 0x11173, ONIGENC_GCB_EXTEND },
+  { 0x11180, 0x11181, ONIGENC_GCB_EXTEND },
+  { 0x11182, 0x11182, ONIGENC_GCB_SPACINGMARK },
+  { 0x111b3, 0x111b5, ONIGENC_GCB_SPACINGMARK },
+  { 0x111b6, 0x111be, ONIGENC_GCB_EXTEND },
+  { 0x111bf, 0x111c0, ONIGENC_GCB_SPACINGMARK },
+  { 0x111c2, 0x111c3, ONIGENC_GCB_PREPEND },
+  { 0x111c9, 0x111cc, ONIGENC_GCB_EXTEND },
+  { 0x1122c, 0x1122e, ONIGENC_GCB_SPACINGMARK },
+  { 0x1122f, 0x11231, ONIGENC_GCB_EXTEND },
+  { 0x11232, 0x11233, ONIGENC_GCB_SPACINGMARK },
+  { 0x11234, 0x11234, ONIGENC_GCB_EXTEND },
+  { 0x11235, 0x11235, ONIGENC_GCB_SPACINGMARK },
+  { 0x11236, 0x11237, ONIGENC_GCB_EXTEND },
+  { 0x1123e, 0x1123e, ONIGENC_GCB_EXTEND },
+  { 0x112df, 0x112df, ONIGENC_GCB_EXTEND },
+  { 0x112e0, 0x112e2, ONIGENC_GCB_SPACINGMARK },
+  { 0x112e3, 0x112ea, ONIGENC_GCB_EXTEND },
+  { 0x11300, 0x11301, ONIGENC_GCB_EXTEND },
+  { 0x11302, 0x11303, ONIGENC_GCB_SPACINGMARK },
+  { 0x1133b, 0x1133c, ONIGENC_GCB_EXTEND },
+  { 0x1133e, 0x1133e, ONIGENC_GCB_EXTEND },
+  { 0x1133f, 0x1133f, ONIGENC_GCB_SPACINGMARK },
+  { 0x11340, 0x11340, ONIGENC_GCB_EXTEND },
+  { 0x11341, 0x11344, ONIGENC_GCB_SPACINGMARK },
+  { 0x11347, 0x11348, ONIGENC_GCB_SPACINGMARK },
+  { 0x1134b, 0x1134d, ONIGENC_GCB_SPACINGMARK },
+  { 0x11357, 0x11357, ONIGENC_GCB_EXTEND },
+  { 0x11362, 0x11363, ONIGENC_GCB_SPACINGMARK },
+  { 0x11366, 0x1136c, ONIGENC_GCB_EXTEND },
+  { 0x11370, 0x11374, ONIGENC_GCB_EXTEND },
+  { 0x11435, 0x11437, ONIGENC_GCB_SPACINGMARK },
+  { 0x11438, 0x1143f, ONIGENC_GCB_EXTEND },
+  { 0x11440, 0x11441, ONIGENC_GCB_SPACINGMARK },
+  { 0x11442, 0x11444, ONIGENC_GCB_EXTEND },
+  { 0x11445, 0x11445, ONIGENC_GCB_SPACINGMARK },
+  { 0x11446, 0x11446, ONIGENC_GCB_EXTEND },
+  { 0x1145e, 0x1145e, ONIGENC_GCB_EXTEND },
+  { 0x114b0, 0x114b0, ONIGENC_GCB_EXTEND },
+  { 0x114b1, 0x114b2, ONIGENC_GCB_SPACINGMARK },
+  { 0x114b3, 0x114b8, ONIGENC_GCB_EXTEND },
+  { 0x114b9, 0x114b9, ONIGENC_GCB_SPACINGMARK },
+  { 0x114ba, 0x114ba, ONIGENC_GCB_EXTEND },
+  { 0x114bb, 0x114bc, ONIGENC_GCB_SPACINGMARK },
+  { 0x114bd, 0x114bd, ONIGENC_GCB_EXTEND },
+  { 0x114be, 0x114be, ONIGENC_GCB_SPACINGMARK },
+  { 0x114bf, 0x114c0, ONIGENC_GCB_EXTEND },
+  { 0x114c1, 0x114c1, ONIGENC_GCB_SPACINGMARK },
+  { 0x114c2, 0x114c3, ONIGENC_GCB_EXTEND },
+  { 0x115af, 0x115af, ONIGENC_GCB_EXTEND },
+  { 0x115b0, 0x115b1, ONIGENC_GCB_SPACINGMARK },
+  { 0x115b2, 0x115b5, ONIGENC_GCB_EXTEND },
+  { 0x115b8, 0x115bb, ONIGENC_GCB_SPACINGMARK },
+  { 0x115bc, 0x115bd, ONIGENC_GCB_EXTEND },
+  { 0x115be, 0x115be, ONIGENC_GCB_SPACINGMARK },
+  { 0x115bf, 0x115c0, ONIGENC_GCB_EXTEND },
+  { 0x115dc, 0x115dd, ONIGENC_GCB_EXTEND },
+  { 0x11630, 0x11632, ONIGENC_GCB_SPACINGMARK },
+  { 0x11633, 0x1163a, ONIGENC_GCB_EXTEND },
+  { 0x1163b, 0x1163c, ONIGENC_GCB_SPACINGMARK },
+  { 0x1163d, 0x1163d, ONIGENC_GCB_EXTEND },
+  { 0x1163e, 0x1163e, ONIGENC_GCB_SPACINGMARK },
+  { 0x1163f, 0x11640, ONIGENC_GCB_EXTEND },
+  { 0x116ab, 0x116ab, ONIGENC_GCB_EXTEND },
+  { 0x116ac, 0x116ac, ONIGENC_GCB_SPACINGMARK },
+  { 0x116ad, 0x116ad, ONIGENC_GCB_EXTEND },
+  { 0x116ae, 0x116af, ONIGENC_GCB_SPACINGMARK },
+  { 0x116b0, 0x116b5, ONIGENC_GCB_EXTEND },
+  { 0x116b6, 0x116b6, ONIGENC_GCB_SPACINGMARK },
+  { 0x116b7, 0x116b7, ONIGENC_GCB_EXTEND },
+  { 0x1171d, 0x1171f, ONIGENC_GCB_EXTEND },
+  { 0x11720, 0x11721, ONIGENC_GCB_SPACINGMARK },
+  { 0x11722, 0x11725, ONIGENC_GCB_EXTEND },
+  { 0x11726, 0x11726, ONIGENC_GCB_SPACINGMARK },
+  { 0x11727, 0x1172b, ONIGENC_GCB_EXTEND },
+  { 0x1182c, 0x1182e, ONIGENC_GCB_SPACINGMARK },
+  { 0x1182f, 0x11837, ONIGENC_GCB_EXTEND },
+  { 0x11838, 0x11838, ONIGENC_GCB_SPACINGMARK },
+  { 0x11839, 0x1183a, ONIGENC_GCB_EXTEND },
+  { 0x119d1, 0x119d3, ONIGENC_GCB_SPACINGMARK },
+  { 0x119d4, 0x119d7, ONIGENC_GCB_EXTEND },
+  { 0x119da, 0x119db, ONIGENC_GCB_EXTEND },
+  { 0x119dc, 0x119df, ONIGENC_GCB_SPACINGMARK },
+  { 0x119e0, 0x119e0, ONIGENC_GCB_EXTEND },
+  { 0x119e4, 0x119e4, ONIGENC_GCB_SPACINGMARK },
+  { 0x11a01, 0x11a0a, ONIGENC_GCB_EXTEND },
+  { 0x11a33, 0x11a38, ONIGENC_GCB_EXTEND },
+  { 0x11a39, 0x11a39, ONIGENC_GCB_SPACINGMARK },
+  { 0x11a3a, 0x11a3a, ONIGENC_GCB_PREPEND },
+  { 0x11a3b, 0x11a3e, ONIGENC_GCB_EXTEND },
+  { 0x11a47, 0x11a47, ONIGENC_GCB_EXTEND },
+  { 0x11a51, 0x11a56, ONIGENC_GCB_EXTEND },
+  { 0x11a57, 0x11a58, ONIGENC_GCB_SPACINGMARK },
+  { 0x11a59, 0x11a5b, ONIGENC_GCB_EXTEND },
+  { 0x11a84, 0x11a89, ONIGENC_GCB_PREPEND },
+  { 0x11a8a, 0x11a96, ONIGENC_GCB_EXTEND },
+  { 0x11a97, 0x11a97, ONIGENC_GCB_SPACINGMARK },
+  { 0x11a98, 0x11a99, ONIGENC_GCB_EXTEND },
+  { 0x11c2f, 0x11c2f, ONIGENC_GCB_SPACINGMARK },
+  { 0x11c30, 0x11c36, ONIGENC_GCB_EXTEND },
+  { 0x11c38, 0x11c3d, ONIGENC_GCB_EXTEND },
+  { 0x11c3e, 0x11c3e, ONIGENC_GCB_SPACINGMARK },
+  { 0x11c3f, 0x11c3f, ONIGENC_GCB_EXTEND },
+  { 0x11c92, 0x11ca7, ONIGENC_GCB_EXTEND },
+  { 0x11ca9, 0x11ca9, ONIGENC_GCB_SPACINGMARK },
+  { 0x11caa, 0x11cb0, ONIGENC_GCB_EXTEND },
+  { 0x11cb1, 0x11cb1, ONIGENC_GCB_SPACINGMARK },
+  { 0x11cb2, 0x11cb3, ONIGENC_GCB_EXTEND },
+  { 0x11cb4, 0x11cb4, ONIGENC_GCB_SPACINGMARK },
+  { 0x11cb5, 0x11cb6, ONIGENC_GCB_EXTEND },
+  { 0x11d31, 0x11d36, ONIGENC_GCB_EXTEND },
+  { 0x11d3a, 0x11d3a, ONIGENC_GCB_EXTEND },
+  { 0x11d3c, 0x11d3d, ONIGENC_GCB_EXTEND },
+  { 0x11d3f, 0x11d45, ONIGENC_GCB_EXTEND },
+  { 0x11d46, 0x11d46, ONIGENC_GCB_PREPEND },
+  { 0x11d47, 0x11d47, ONIGENC_GCB_EXTEND },
+  { 0x11d8a, 0x11d8e, ONIGENC_GCB_SPACINGMARK },
+  { 0x11d90, 0x11d91, ONIGENC_GCB_EXTEND },
+  { 0x11d93, 0x11d94, ONIGENC_GCB_SPACINGMARK },
+  { 0x11d95, 0x11d95, ONIGENC_GCB_EXTEND },
+  { 0x11d96, 0x11d96, ONIGENC_GCB_SPACINGMARK },
+  { 0x11d97, 0x11d97, ONIGENC_GCB_EXTEND },
+  { 0x11ef3, 0x11ef4, ONIGENC_GCB_EXTEND },
+  { 0x11ef5, 0x11ef6, ONIGENC_GCB_SPACINGMARK },
+  { 0x13430, 0x13438, ONIGENC_GCB_CONTROL },
+  { 0x16af0, 0x16af4, ONIGENC_GCB_EXTEND },
+  { 0x16b30, 0x16b36, ONIGENC_GCB_EXTEND },
+  { 0x16f4f, 0x16f4f, ONIGENC_GCB_EXTEND },
+  { 0x16f51, 0x16f87, ONIGENC_GCB_SPACINGMARK },
+  { 0x16f8f, 0x16f92, ONIGENC_GCB_EXTEND },
+  { 0x1bc9d, 0x1bc9e, ONIGENC_GCB_EXTEND },
+  { 0x1bca0, 0x1bca3, ONIGENC_GCB_CONTROL },
+  { 0x1d165, 0x1d165, ONIGENC_GCB_EXTEND },
+  { 0x1d166, 0x1d166, ONIGENC_GCB_SPACINGMARK },
+  { 0x1d167, 0x1d169, ONIGENC_GCB_EXTEND },
+  { 0x1d16d, 0x1d16d, ONIGENC_GCB_SPACINGMARK },
+  { 0x1d16e, 0x1d172, ONIGENC_GCB_EXTEND },
+  { 0x1d173, 0x1d17a, ONIGENC_GCB_CONTROL },
+  { 0x1d17b, 0x1d182, ONIGENC_GCB_EXTEND },
+  { 0x1d185, 0x1d18b, ONIGENC_GCB_EXTEND },
+  { 0x1d1aa, 0x1d1ad, ONIGENC_GCB_EXTEND },
+  { 0x1d242, 0x1d244, ONIGENC_GCB_EXTEND },
+  { 0x1da00, 0x1da36, ONIGENC_GCB_EXTEND },
+  { 0x1da3b, 0x1da6c, ONIGENC_GCB_EXTEND },
+  { 0x1da75, 0x1da75, ONIGENC_GCB_EXTEND },
+  { 0x1da84, 0x1da84, ONIGENC_GCB_EXTEND },
+  { 0x1da9b, 0x1da9f, ONIGENC_GCB_EXTEND },
+  { 0x1daa1, 0x1daaf, ONIGENC_GCB_EXTEND },
+  { 0x1e000, 0x1e006, ONIGENC_GCB_EXTEND },
+  { 0x1e008, 0x1e018, ONIGENC_GCB_EXTEND },
+  { 0x1e01b, 0x1e021, ONIGENC_GCB_EXTEND },
+  { 0x1e023, 0x1e024, ONIGENC_GCB_EXTEND },
+  { 0x1e026, 0x1e02a, ONIGENC_GCB_EXTEND },
+  { 0x1e130, 0x1e136, ONIGENC_GCB_EXTEND },
+  { 0x1e2ec, 0x1e2ef, ONIGENC_GCB_EXTEND },
+  { 0x1e8d0, 0x1e8d6, ONIGENC_GCB_EXTEND },
+  { 0x1e944, 0x1e94a, ONIGENC_GCB_EXTEND },
+  { 0x1f000, 0x1f0ff, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f10d, 0x1f10f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f12f, 0x1f12f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f16c, 0x1f171, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f17e, 0x1f17f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f18e, 0x1f18e, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f191, 0x1f19a, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f1ad, 0x1f1e5, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f1e6, 0x1f1ff, ONIGENC_GCB_REGIONAL_INDICATOR },
+  { 0x1f201, 0x1f20f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f21a, 0x1f21a, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f22f, 0x1f22f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f232, 0x1f23a, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f23c, 0x1f23f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f249, 0x1f3fa, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f3fb, 0x1f3ff, ONIGENC_GCB_EXTEND },
+  { 0x1f400, 0x1f53d, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f546, 0x1f64f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f680, 0x1f6ff, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f774, 0x1f77f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f7d5, 0x1f7ff, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f80c, 0x1f80f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f848, 0x1f84f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f85a, 0x1f85f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f888, 0x1f88f, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f8ae, 0x1f8ff, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f90c, 0x1f93a, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f93c, 0x1f945, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0x1f947, 0x1fffd, ONIGENC_GCB_EXTENDED_PICTOGRAPHIC },
+  { 0xe0000, 0xe001f, ONIGENC_GCB_CONTROL },
+  { 0xe0020, 0xe007f, ONIGENC_GCB_EXTEND },
+  { 0xe0080, 0xe00ff, ONIGENC_GCB_CONTROL },
+  { 0xe0100, 0xe01ef, ONIGENC_GCB_EXTEND },
+  { 0xe01f0, 0xe0fff, ONIGENC_GCB_CONTROL },
+};
@@ -469,7 +469,11 @@ typedef unsigned int        OnigOptionType;
 #define ONIG_OPTION_WORD_BOUND_ALL_RANGE    (ONIG_OPTION_POSIX_BRACKET_ALL_RANGE << 1)
 /* options (newline) */
 #define ONIG_OPTION_NEWLINE_CRLF         (ONIG_OPTION_WORD_BOUND_ALL_RANGE << 1)
-#define ONIG_OPTION_MAXBIT               ONIG_OPTION_NEWLINE_CRLF  /* limit */
+/* options (compile time, memory layout) */
+#define ONIG_OPTION_CONTIGUOUS           (ONIG_OPTION_NEWLINE_CRLF << 1)
+/* options (POSIX leftmost-longest rule, implies ONIG_OPTION_FIND_LONGEST) */
+#define ONIG_OPTION_LEFTMOST_LONGEST     (ONIG_OPTION_CONTIGUOUS << 1)
+#define ONIG_OPTION_MAXBIT               ONIG_OPTION_LEFTMOST_LONGEST  /* limit */
 
 #define ONIG_OPTION_ON(options,regopt)      ((options) |= (regopt))
 #define ONIG_OPTION_OFF(options,regopt)     ((options) &= ~(regopt))
@@ -597,6 +601,7 @@ ONIG_EXTERN const OnigSyntaxType*   OnigDefaultSyntax;
 #define ONIG_SYN_FIXED_INTERVAL_IS_GREEDY_ONLY   (1U<<9)  /* a{n}?=(?:a{n})? */
 #define ONIG_SYN_ALLOW_MULTIPLEX_DEFINITION_NAME_CALL (1U<<10)  /* (?<x>)(?<x>)(?&x) */
 #define ONIG_SYN_USE_LEFT_MOST_NAMED_GROUP       (1U<<11) /* (?<x>)(?<x>)\k<x> */
+#define ONIG_SYN_VARIABLE_LEN_LOOK_BEHIND        (1U<<12) /* (?<=a(?:b|cd)) */
 
 /* syntax (behavior) in char class [...] */
 #define ONIG_SYN_NOT_NEWLINE_IN_NEGATIVE_CC      (1U<<20) /* [^...] */
@@ -634,6 +639,7 @@ ONIG_EXTERN const OnigSyntaxType*   OnigDefaultSyntax;
 #define ONIGERR_UNEXPECTED_BYTECODE                           -14
 #define ONIGERR_MATCH_STACK_LIMIT_OVER                        -15
 #define ONIGERR_PARSE_DEPTH_LIMIT_OVER                        -16
+#define ONIGERR_SUBEXP_CALL_DEPTH_LIMIT_OVER                  -17
 #define ONIGERR_DEFAULT_ENCODING_IS_NOT_SET                   -21
 #define ONIGERR_SPECIFIED_ENCODING_CANT_CONVERT_TO_WIDE_CHAR  -22
 /* general error */
@@ -752,6 +758,14 @@ extern void onig_null_warn(const char* s);
 
 #define ONIG_CHAR_TABLE_SIZE   256
 
+/* a name of groups, resolved once (see onig_get_named_groups()) */
+typedef struct {
+  const unsigned char* name;
+  const unsigned char* name_end;
+  int        back_num;   /* number of groups of the name */
+  const int* back_refs;  /* group numbers, in ascending order */
+} OnigNamedGroup;
+
 typedef struct re_pattern_buffer {
   /* common members of BBuf(bytes-buffer) */
   unsigned char* p;         /* compiled pattern */
@@ -776,7 +790,9 @@ typedef struct re_pattern_buffer {
   OnigEncoding      enc;
   const OnigSyntaxType* syntax;
   void*             name_table;
+  OnigNamedGroup*   named_groups;  /* names ordered by their first group */
   OnigCaseFoldType  case_fold_flag;
+  int               enc_kind;      /* ENC_KIND_XXX: inlined primitives */
 
   /* optimization info (string search, char-map and anchors) */
   int            optimize;          /* optimize flag */
@@ -787,11 +803,11 @@ typedef struct re_pattern_buffer {
   int            sub_anchor;        /* start-anchor for exact or map */
   unsigned char *exact;
   unsigned char *exact_end;
-  unsigned char  map[ONIG_CHAR_TABLE_SIZE]; /* used as BM skip or char-map */
-  int           *reserved1;
-  int           *reserved2;
+  unsigned char *map;  /* BM skips or char-map (ONIG_CHAR_TABLE_SIZE), or NULL */
   OnigDistance   dmin;                      /* min-distance of exact or map */
   OnigDistance   dmax;                      /* max-distance of exact or map */
+  OnigDistance   max_len;                   /* max length of a whole match */
+  OnigDistance   reach_behind;  /* max bytes a match reads before its start */
 
   /* regex_t link chain */
   struct re_pattern_buffer* chain;  /* escape compile-conflict */
@@ -799,6 +815,15 @@ typedef struct re_pattern_buffer {
 
 typedef OnigRegexType*  OnigRegex;
 
+/* per-thread data for searches (see onig_search_with_scratch()) */
+typedef struct OnigMatchScratchStruct  OnigMatchScratch;
+
+/* a part of a subject stored in pieces (see onig_search_segments()) */
+typedef struct {
+  const OnigUChar* p;
+  const OnigUChar* end;
+} OnigSegment;
+
 #ifndef ONIG_ESCAPE_REGEX_T_COLLISION
 typedef OnigRegexType  regex_t;
 #endif
@@ -813,12 +838,58 @@ typedef struct {
   OnigCaseFoldType   case_fold_flag;
 } OnigCompileInfo;
 
+/* search strategy chosen by the optimizer (see onig_get_optimize_info()) */
+#define ONIG_OPTIMIZE_NONE              0
+#define ONIG_OPTIMIZE_EXACT             1   /* Slow Search */
+#define ONIG_OPTIMIZE_EXACT_BM          2   /* Boyer Moore Search */
+#define ONIG_OPTIMIZE_EXACT_BM_NOT_REV  3   /* BM (applied to a multibyte string) */
+#define ONIG_OPTIMIZE_EXACT_IC          4   /* Slow Search (ignore case) */
+#define ONIG_OPTIMIZE_MAP               5   /* char map */
+#define ONIG_OPTIMIZE_EXACT_BM_IC         6 /* BM (ignore case) */
+#define ONIG_OPTIMIZE_EXACT_BM_NOT_REV_IC 7 /* BM (applied to a multibyte string) (ignore case) */
+
+/* anchors reported by onig_get_optimize_info() */
+#define ONIG_ANCHOR_BEGIN_BUF        (1<<0)
+#define ONIG_ANCHOR_BEGIN_LINE       (1<<1)
+#define ONIG_ANCHOR_BEGIN_POSITION   (1<<2)
+#define ONIG_ANCHOR_END_BUF          (1<<3)
+#define ONIG_ANCHOR_SEMI_END_BUF     (1<<4)
+#define ONIG_ANCHOR_END_LINE         (1<<5)
+#define ONIG_ANCHOR_PREC_READ_NOT    (1<<11)
+#define ONIG_ANCHOR_LOOK_BEHIND      (1<<12)
+#define ONIG_ANCHOR_ANYCHAR_STAR     (1<<14)
+#define ONIG_ANCHOR_ANYCHAR_STAR_ML  (1<<15)
+
+typedef struct {
+  int              optimize;       /* ONIG_OPTIMIZE_XXX */
+  int              anchor;         /* ONIG_ANCHOR_XXX */
+  OnigDistance     anchor_dmin;    /* (SEMI_)END_BUF anchor distance */
+  OnigDistance     anchor_dmax;    /* (SEMI_)END_BUF anchor distance */
+  int              sub_anchor;     /* BEGIN_LINE/END_LINE around exact or map */
+  const OnigUChar* exact;          /* exact string (NULL if not EXACT*) */
+  const OnigUChar* exact_end;
+  int              map_count;      /* number of bytes in the char map (MAP) */
+  OnigDistance     dmin;           /* min-distance of exact or map */
+  OnigDistance     dmax;           /* max-distance of exact or map */
+  int              threshold_len;  /* min. search range length to optimize */
+} OnigOptimizeInfo;
+
+/* memory allocator used for all allocations of the library */
+typedef struct {
+  void* (*malloc_func)(size_t size, void* context);
+  void* (*realloc_func)(void* ptr, size_t size, void* context);
+  void  (*free_func)(void* ptr, void* context);
+  void*   context;
+} OnigAllocator;
+
 /* Oniguruma Native API */
 ONIG_EXTERN
 int onig_initialize(OnigEncoding encodings[], int n);
 ONIG_EXTERN
 int onig_init(void);
 ONIG_EXTERN
+int onig_set_allocator(const OnigAllocator* allocator);
+ONIG_EXTERN
 int onig_error_code_to_str(OnigUChar* s, OnigPosition err_code, ...);
 ONIG_EXTERN
 void onig_set_warn_func(OnigWarnFunc f);
@@ -833,18 +904,34 @@ int onig_new_without_alloc(OnigRegex, const OnigUChar* pattern, const OnigUChar*
 ONIG_EXTERN
 int onig_new_deluxe(OnigRegex* reg, const OnigUChar* pattern, const OnigUChar* pattern_end, OnigCompileInfo* ci, OnigErrorInfo* einfo);
 ONIG_EXTERN
+int onig_new_append(OnigRegex* reg, OnigRegex prev, const OnigUChar* pattern, const OnigUChar* pattern_end, const OnigUChar* str, const OnigUChar* end, OnigErrorInfo* einfo);
+ONIG_EXTERN
 void onig_free(OnigRegex);
 ONIG_EXTERN
 void onig_free_body(OnigRegex);
 ONIG_EXTERN
 OnigPosition onig_scan(OnigRegex reg, const OnigUChar* str, const OnigUChar* end, OnigRegion* region, OnigOptionType option, int (*scan_callback)(OnigPosition, OnigPosition, OnigRegion*, void*), void* callback_arg);
 ONIG_EXTERN
+OnigPosition onig_scan_starts(OnigRegex reg, const OnigUChar* str, const OnigUChar* end, const OnigPosition* starts, OnigPosition num_starts, OnigRegion* region, OnigOptionType option, int (*scan_callback)(OnigPosition, OnigPosition, OnigRegion*, void*), void* callback_arg);
+ONIG_EXTERN
 OnigPosition onig_search(OnigRegex, const OnigUChar* str, const OnigUChar* end, const OnigUChar* start, const OnigUChar* range, OnigRegion* region, OnigOptionType option);
 ONIG_EXTERN
 OnigPosition onig_search_gpos(OnigRegex, const OnigUChar* str, const OnigUChar* end, const OnigUChar* global_pos, const OnigUChar* start, const OnigUChar* range, OnigRegion* region, OnigOptionType option);
 ONIG_EXTERN
 OnigPosition onig_match(OnigRegex, const OnigUChar* str, const OnigUChar* end, const OnigUChar* at, OnigRegion* region, OnigOptionType option);
 ONIG_EXTERN
+OnigMatchScratch* onig_match_scratch_new(void);
+ONIG_EXTERN
+void onig_match_scratch_free(OnigMatchScratch* scratch);
+ONIG_EXTERN
+OnigPosition onig_search_with_scratch(OnigRegex, const OnigUChar* str, const OnigUChar* end, const OnigUChar* start, const OnigUChar* range, OnigRegion* region, OnigOptionType option, OnigMatchScratch* scratch);
+ONIG_EXTERN
+OnigPosition onig_match_with_scratch(OnigRegex, const OnigUChar* str, const OnigUChar* end, const OnigUChar* at, OnigRegion* region, OnigOptionType option, OnigMatchScratch* scratch);
+ONIG_EXTERN
+OnigPosition onig_search_segments(OnigRegex, const OnigSegment* segs, int num_segs, OnigPosition start, OnigPosition range, OnigRegion* region, OnigOptionType option);
+ONIG_EXTERN
+int onig_regex_share(OnigRegex);
+ONIG_EXTERN
 OnigRegion* onig_region_new(void);
 ONIG_EXTERN
 void onig_region_init(OnigRegion* region);
@@ -867,6 +954,12 @@ int onig_foreach_name(OnigRegex reg, int (*func)(const OnigUChar*, const OnigUCh
 ONIG_EXTERN
 int onig_number_of_names(const OnigRegexType *reg);
 ONIG_EXTERN
+int onig_get_named_groups(const OnigRegexType *reg, const OnigNamedGroup** groups);
+ONIG_EXTERN
+const OnigNamedGroup* onig_name_to_named_group(OnigRegex reg, const OnigUChar* name, const OnigUChar* name_end);
+ONIG_EXTERN
+int onig_named_group_backref_number(const OnigNamedGroup* group, const OnigRegion *region);
+ONIG_EXTERN
 int onig_number_of_captures(const OnigRegexType *reg);
 ONIG_EXTERN
 int onig_number_of_capture_histories(const OnigRegexType *reg);
@@ -887,6 +980,8 @@ OnigCaseFoldType onig_get_case_fold_flag(const OnigRegexType *reg);
 ONIG_EXTERN
 const OnigSyntaxType* onig_get_syntax(const OnigRegexType *reg);
 ONIG_EXTERN
+int onig_get_optimize_info(const OnigRegexType *reg, OnigOptimizeInfo* info);
+ONIG_EXTERN
 int onig_set_default_syntax(const OnigSyntaxType* syntax);
 ONIG_EXTERN
 void onig_copy_syntax(OnigSyntaxType* to, const OnigSyntaxType* from);
@@ -919,6 +1014,22 @@ unsigned int onig_get_match_stack_limit_size(void);
 ONIG_EXTERN
 int onig_set_match_stack_limit_size(unsigned int size);
 ONIG_EXTERN
+unsigned int onig_get_match_stack_pool_limit_size(void);
+ONIG_EXTERN
+int onig_set_match_stack_pool_limit_size(unsigned int size);
+ONIG_EXTERN
+void onig_trim_match_stack_pool(void);
+ONIG_EXTERN
+unsigned int onig_get_subexp_call_depth_limit(void);
+ONIG_EXTERN
+int onig_set_subexp_call_depth_limit(unsigned int depth);
+ONIG_EXTERN
+size_t onig_memsize(const OnigRegexType* reg);
+ONIG_EXTERN
+int onig_get_bounded_native_stack(void);
+ONIG_EXTERN
+int onig_set_bounded_native_stack(int enable);
+ONIG_EXTERN
 unsigned int onig_get_parse_depth_limit(void);
 ONIG_EXTERN
 int onig_set_parse_depth_limit(unsigned int depth);
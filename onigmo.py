@@ -48,7 +48,7 @@ import sys
 # Onigmo API version
 # (Must be synchronized with LTVERSION in configure.ac.)
 #
-_onig_api_version = 6
+_onig_api_version = 7
 
 #
 # Type Definitions
@@ -84,6 +84,12 @@ class OnigRegion(ctypes.Structure):
     ]
 re_registers = OnigRegion
 
+class OnigSegment(ctypes.Structure):
+    _fields_ = [
+        ("p",           ctypes.c_void_p),
+        ("end",         ctypes.c_void_p),
+    ]
+
 OnigOptionType = ctypes.c_int
 
 class OnigEncodingType(ctypes.Structure):
@@ -136,6 +142,31 @@ class OnigErrorInfo(ctypes.Structure):
         ("par_end", ctypes.c_char_p),
     ]
 
+class OnigNamedGroup(ctypes.Structure):
+    _fields_ = [
+        ("name",      ctypes.c_void_p),
+        ("name_end",  ctypes.c_void_p),
+        ("back_num",  ctypes.c_int),
+        ("back_refs", ctypes.POINTER(ctypes.c_int)),
+    ]
+
+OnigDistance = ctypes.c_size_t
+
+class OnigOptimizeInfo(ctypes.Structure):
+    _fields_ = [
+        ("optimize",        ctypes.c_int),
+        ("anchor",          ctypes.c_int),
+        ("anchor_dmin",     OnigDistance),
+        ("anchor_dmax",     OnigDistance),
+        ("sub_anchor",      ctypes.c_int),
+        ("exact",           ctypes.c_void_p),
+        ("exact_end",       ctypes.c_void_p),
+        ("map_count",       ctypes.c_int),
+        ("dmin",            OnigDistance),
+        ("dmax",            OnigDistance),
+        ("threshold_len",   ctypes.c_int),
+    ]
+
 
 # load the DLL or the shared library
 
@@ -283,6 +314,10 @@ ONIG_OPTION_POSIX_BRACKET_ALL_RANGE = (ONIG_OPTION_ASCII_RANGE << 1)
 ONIG_OPTION_WORD_BOUND_ALL_RANGE    = (ONIG_OPTION_POSIX_BRACKET_ALL_RANGE << 1)
 # options (newline)
 ONIG_OPTION_NEWLINE_CRLF        = (ONIG_OPTION_WORD_BOUND_ALL_RANGE << 1)
+# options (compile time, memory layout)
+ONIG_OPTION_CONTIGUOUS          = (ONIG_OPTION_NEWLINE_CRLF << 1)
+# options (POSIX leftmost-longest rule, implies ONIG_OPTION_FIND_LONGEST)
+ONIG_OPTION_LEFTMOST_LONGEST    = (ONIG_OPTION_CONTIGUOUS << 1)
 
 ONIG_OPTION_DEFAULT             = ONIG_OPTION_NONE
 
@@ -368,6 +403,7 @@ ONIG_SYN_ALLOW_MULTIPLEX_DEFINITION_NAME = (1<<8)
 ONIG_SYN_FIXED_INTERVAL_IS_GREEDY_ONLY   = (1<<9)
 ONIG_SYN_ALLOW_MULTIPLEX_DEFINITION_NAME_CALL = (1<<10)
 ONIG_SYN_USE_LEFT_MOST_NAMED_GROUP       = (1<<11)
+ONIG_SYN_VARIABLE_LEN_LOOK_BEHIND        = (1<<12)
 
 # (behavior) in char class [...]
 ONIG_SYN_NOT_NEWLINE_IN_NEGATIVE_CC     = (1<<20)
@@ -389,6 +425,28 @@ ONIG_META_CHAR_ANYCHAR_ANYTIME      = 5
 
 ONIG_INEFFECTIVE_META_CHAR          = 0
 
+# optimize strategy (onig_get_optimize_info)
+ONIG_OPTIMIZE_NONE                  = 0
+ONIG_OPTIMIZE_EXACT                 = 1
+ONIG_OPTIMIZE_EXACT_BM              = 2
+ONIG_OPTIMIZE_EXACT_BM_NOT_REV      = 3
+ONIG_OPTIMIZE_EXACT_IC              = 4
+ONIG_OPTIMIZE_MAP                   = 5
+ONIG_OPTIMIZE_EXACT_BM_IC           = 6
+ONIG_OPTIMIZE_EXACT_BM_NOT_REV_IC   = 7
+
+# anchors (onig_get_optimize_info)
+ONIG_ANCHOR_BEGIN_BUF               = (1<<0)
+ONIG_ANCHOR_BEGIN_LINE              = (1<<1)
+ONIG_ANCHOR_BEGIN_POSITION          = (1<<2)
+ONIG_ANCHOR_END_BUF                 = (1<<3)
+ONIG_ANCHOR_SEMI_END_BUF            = (1<<4)
+ONIG_ANCHOR_END_LINE                = (1<<5)
+ONIG_ANCHOR_PREC_READ_NOT           = (1<<11)
+ONIG_ANCHOR_LOOK_BEHIND             = (1<<12)
+ONIG_ANCHOR_ANYCHAR_STAR            = (1<<14)
+ONIG_ANCHOR_ANYCHAR_STAR_ML         = (1<<15)
+
 
 # error codes
 def ONIG_IS_PATTERN_ERROR(ecode):
@@ -406,6 +464,7 @@ ONIGERR_UNDEFINED_BYTECODE                              =   -13
 ONIGERR_UNEXPECTED_BYTECODE                             =   -14
 ONIGERR_MATCH_STACK_LIMIT_OVER                          =   -15
 ONIGERR_PARSE_DEPTH_LIMIT_OVER                          =   -16
+ONIGERR_SUBEXP_CALL_DEPTH_LIMIT_OVER                    =   -17
 ONIGERR_DEFAULT_ENCODING_IS_NOT_SET                     =   -21
 ONIGERR_SPECIFIED_ENCODING_CANT_CONVERT_TO_WIDE_CHAR    =   -22
 # general error
@@ -470,6 +529,20 @@ ONIGERR_INVALID_COMBINATION_OF_OPTIONS                  =  -403
 
 OnigWarnFunc = ctypes.CFUNCTYPE(None, ctypes.c_char_p)
 
+OnigMallocFunc = ctypes.CFUNCTYPE(ctypes.c_void_p,
+        ctypes.c_size_t, ctypes.c_void_p)
+OnigReallocFunc = ctypes.CFUNCTYPE(ctypes.c_void_p,
+        ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p)
+OnigFreeFunc = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_void_p)
+
+class OnigAllocator(ctypes.Structure):
+    _fields_ = [
+        ("malloc_func",     OnigMallocFunc),
+        ("realloc_func",    OnigReallocFunc),
+        ("free_func",       OnigFreeFunc),
+        ("context",         ctypes.c_void_p),
+    ]
+
 #
 # Onigmo APIs
 #
@@ -477,6 +550,11 @@ OnigWarnFunc = ctypes.CFUNCTYPE(None, ctypes.c_char_p)
 # onig_init
 onig_init = libonig.onig_init
 
+# onig_set_allocator
+libonig.onig_set_allocator.argtypes = [ctypes.POINTER(OnigAllocator)]
+libonig.onig_set_allocator.restype = ctypes.c_int
+onig_set_allocator = libonig.onig_set_allocator
+
 # onig_error_code_to_str
 libonig.onig_error_code_to_str.argtypes = [ctypes.c_char_p, _c_ssize_t,
         ctypes.POINTER(OnigErrorInfo)]
@@ -508,6 +586,11 @@ onig_free = libonig.onig_free
 
 # onig_free_body
 
+# onig_memsize
+libonig.onig_memsize.argtypes = [OnigRegex]
+libonig.onig_memsize.restype = ctypes.c_size_t
+onig_memsize = libonig.onig_memsize
+
 # onig_search
 libonig.onig_search.argtypes = [OnigRegex,
         ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
@@ -530,6 +613,58 @@ libonig.onig_match.argtypes = [OnigRegex,
 libonig.onig_match.restype = _c_ssize_t
 onig_match = libonig.onig_match
 
+# onig_match_scratch_new
+libonig.onig_match_scratch_new.argtypes = []
+libonig.onig_match_scratch_new.restype = ctypes.c_void_p
+onig_match_scratch_new = libonig.onig_match_scratch_new
+
+# onig_match_scratch_free
+libonig.onig_match_scratch_free.argtypes = [ctypes.c_void_p]
+onig_match_scratch_free = libonig.onig_match_scratch_free
+
+# onig_search_with_scratch
+libonig.onig_search_with_scratch.argtypes = [OnigRegex,
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+        ctypes.POINTER(OnigRegion), OnigOptionType, ctypes.c_void_p]
+libonig.onig_search_with_scratch.restype = _c_ssize_t
+onig_search_with_scratch = libonig.onig_search_with_scratch
+
+# onig_match_with_scratch
+libonig.onig_match_with_scratch.argtypes = [OnigRegex,
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+        ctypes.POINTER(OnigRegion), OnigOptionType, ctypes.c_void_p]
+libonig.onig_match_with_scratch.restype = _c_ssize_t
+onig_match_with_scratch = libonig.onig_match_with_scratch
+
+# onig_new_append
+libonig.onig_new_append.argtypes = [ctypes.POINTER(OnigRegex), OnigRegex,
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+        ctypes.POINTER(OnigErrorInfo)]
+libonig.onig_new_append.restype = ctypes.c_int
+onig_new_append = libonig.onig_new_append
+
+# onig_scan_starts
+OnigScanCallback = ctypes.CFUNCTYPE(ctypes.c_int,
+        _c_ssize_t, _c_ssize_t, ctypes.POINTER(OnigRegion), ctypes.c_void_p)
+libonig.onig_scan_starts.argtypes = [OnigRegex,
+        ctypes.c_void_p, ctypes.c_void_p,
+        ctypes.POINTER(_c_ssize_t), _c_ssize_t,
+        ctypes.POINTER(OnigRegion), OnigOptionType,
+        OnigScanCallback, ctypes.c_void_p]
+libonig.onig_scan_starts.restype = _c_ssize_t
+onig_scan_starts = libonig.onig_scan_starts
+
+# onig_search_segments
+libonig.onig_search_segments.argtypes = [OnigRegex,
+        ctypes.POINTER(OnigSegment), ctypes.c_int, _c_ssize_t, _c_ssize_t,
+        ctypes.POINTER(OnigRegion), OnigOptionType]
+libonig.onig_search_segments.restype = _c_ssize_t
+onig_search_segments = libonig.onig_search_segments
+
+# onig_regex_share
+libonig.onig_regex_share.argtypes = [OnigRegex]
+onig_regex_share = libonig.onig_regex_share
+
 # onig_region_new
 libonig.onig_region_new.argtypes = []
 libonig.onig_region_new.restype = ctypes.POINTER(OnigRegion)
@@ -549,6 +684,22 @@ onig_region_free = libonig.onig_region_free
 # onig_name_to_backref_number
 # onig_foreach_name
 # onig_number_of_names
+
+# onig_get_named_groups
+libonig.onig_get_named_groups.argtypes = [OnigRegex,
+        ctypes.POINTER(ctypes.POINTER(OnigNamedGroup))]
+onig_get_named_groups = libonig.onig_get_named_groups
+
+# onig_name_to_named_group
+libonig.onig_name_to_named_group.argtypes = [OnigRegex,
+        ctypes.c_void_p, ctypes.c_void_p]
+libonig.onig_name_to_named_group.restype = ctypes.POINTER(OnigNamedGroup)
+onig_name_to_named_group = libonig.onig_name_to_named_group
+
+# onig_named_group_backref_number
+libonig.onig_named_group_backref_number.argtypes = [
+        ctypes.POINTER(OnigNamedGroup), ctypes.POINTER(OnigRegion)]
+onig_named_group_backref_number = libonig.onig_named_group_backref_number
 # onig_number_of_captures
 # onig_number_of_capture_histories
 # onig_get_capture_tree
@@ -559,6 +710,11 @@ onig_region_free = libonig.onig_region_free
 # onig_get_case_fold_flag
 # onig_get_syntax
 
+# onig_get_optimize_info
+libonig.onig_get_optimize_info.argtypes = [OnigRegex,
+        ctypes.POINTER(OnigOptimizeInfo)]
+onig_get_optimize_info = libonig.onig_get_optimize_info
+
 # onig_set_default_syntax
 libonig.onig_set_default_syntax.argtypes = [ctypes.POINTER(OnigSyntaxType)]
 libonig.onig_set_default_syntax.restype = ctypes.c_int
@@ -624,6 +780,41 @@ libonig.onig_set_match_stack_limit_size.argtypes = [ctypes.c_int]
 libonig.onig_set_match_stack_limit_size.restype = ctypes.c_int
 onig_set_match_stack_limit_size = libonig.onig_set_match_stack_limit_size
 
+# onig_get_match_stack_pool_limit_size
+libonig.onig_get_match_stack_pool_limit_size.argtypes = []
+libonig.onig_get_match_stack_pool_limit_size.restype = ctypes.c_int
+onig_get_match_stack_pool_limit_size = libonig.onig_get_match_stack_pool_limit_size
+
+# onig_set_match_stack_pool_limit_size
+libonig.onig_set_match_stack_pool_limit_size.argtypes = [ctypes.c_int]
+libonig.onig_set_match_stack_pool_limit_size.restype = ctypes.c_int
+onig_set_match_stack_pool_limit_size = libonig.onig_set_match_stack_pool_limit_size
+
+# onig_trim_match_stack_pool
+libonig.onig_trim_match_stack_pool.argtypes = []
+libonig.onig_trim_match_stack_pool.restype = None
+onig_trim_match_stack_pool = libonig.onig_trim_match_stack_pool
+
+# onig_get_subexp_call_depth_limit
+libonig.onig_get_subexp_call_depth_limit.argtypes = []
+libonig.onig_get_subexp_call_depth_limit.restype = ctypes.c_int
+onig_get_subexp_call_depth_limit = libonig.onig_get_subexp_call_depth_limit
+
+# onig_set_subexp_call_depth_limit
+libonig.onig_set_subexp_call_depth_limit.argtypes = [ctypes.c_int]
+libonig.onig_set_subexp_call_depth_limit.restype = ctypes.c_int
+onig_set_subexp_call_depth_limit = libonig.onig_set_subexp_call_depth_limit
+
+# onig_get_bounded_native_stack
+libonig.onig_get_bounded_native_stack.argtypes = []
+libonig.onig_get_bounded_native_stack.restype = ctypes.c_int
+onig_get_bounded_native_stack = libonig.onig_get_bounded_native_stack
+
+# onig_set_bounded_native_stack
+libonig.onig_set_bounded_native_stack.argtypes = [ctypes.c_int]
+libonig.onig_set_bounded_native_stack.restype = ctypes.c_int
+onig_set_bounded_native_stack = libonig.onig_set_bounded_native_stack
+
 # onig_get_parse_depth_limit
 libonig.onig_get_parse_depth_limit.argtypes = []
 libonig.onig_get_parse_depth_limit.restype = ctypes.c_int
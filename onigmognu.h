@@ -51,6 +51,7 @@ extern "C" {
 #define RE_OPTION_MULTILINE          ONIG_OPTION_MULTILINE
 #define RE_OPTION_SINGLELINE         ONIG_OPTION_SINGLELINE
 #define RE_OPTION_LONGEST            ONIG_OPTION_FIND_LONGEST
+#define RE_OPTION_LEFTMOST_LONGEST   ONIG_OPTION_LEFTMOST_LONGEST
 #define RE_OPTION_POSIXLINE         (RE_OPTION_MULTILINE|RE_OPTION_SINGLELINE)
 #define RE_OPTION_FIND_NOT_EMPTY     ONIG_OPTION_FIND_NOT_EMPTY
 #define RE_OPTION_NEGATE_SINGLELINE  ONIG_OPTION_NEGATE_SINGLELINE
@@ -42,6 +42,8 @@ extern "C" {
 #define REG_NOTEOL         (1<<3)
 #define REG_EXTENDED       (1<<4) /* if not set, Basic Onigular Expression */
 #define REG_NOSUB          (1<<5)
+#define REG_STARTEND       (1<<6) /* search in [pmatch[0].rm_so, rm_eo) */
+#define REG_LONGEST        (1<<7) /* leftmost-longest match (POSIX rule) */
 
 /* POSIX error codes */
 #define REG_NOMATCH          1
@@ -460,6 +460,51 @@ add_compile_string(UChar* s, int mb_len, OnigDistance byte_len,
 }
 
 
+/* OP_EXACTN_FOLD: for each char of a case folded string, the number of
+   chars it matches followed by the length and the bytes of each of them.
+   Returns the size of the table, 0 if a char takes part in a multi-char
+   fold (then the subject has to be folded: OP_EXACTN_IC), or an error.
+   Single byte encodings fold the subject with a table lookup anyway. */
+static int
+fold_string_table(UChar* s, UChar* end, regex_t* reg, int emit)
+{
+  int i, n, r, clen, len, size;
+  UChar *p, buf[1 + (ONIGENC_GET_CASE_FOLD_CODES_MAX_NUM + 1) *
+		   (1 + ONIGENC_CODE_TO_MBC_MAXLEN)];
+  OnigCaseFoldCodeItem items[ONIGENC_GET_CASE_FOLD_CODES_MAX_NUM];
+
+  if (ONIGENC_MBC_MAXLEN(reg->enc) == 1) return 0;
+
+  size = 0;
+  for (p = s; p < end; p += clen) {
+    clen = enclen(reg->enc, p, end);
+    n = ONIGENC_GET_CASE_FOLD_CODES_BY_STR(reg->enc, reg->case_fold_flag,
+					   p, end, items);
+    if (n < 0) return n;
+
+    buf[0] = (UChar )(n + 1);
+    buf[1] = (UChar )clen;
+    xmemcpy(buf + 2, p, clen);
+    len = 2 + clen;
+    for (i = 0; i < n; i++) {
+      if (items[i].code_len != 1 || items[i].byte_len != clen)
+	return 0;
+
+      r = ONIGENC_CODE_TO_MBC(reg->enc, items[i].code[0], buf + len + 1);
+      if (r < 0) return r;
+      buf[len] = (UChar )r;
+      len += 1 + r;
+    }
+
+    if (emit) {
+      r = add_bytes(reg, buf, len);
+      if (r) return r;
+    }
+    size += len;
+  }
+  return size;
+}
+
 static int
 compile_length_string_node(Node* node, regex_t* reg)
 {
@@ -473,6 +518,11 @@ compile_length_string_node(Node* node, regex_t* reg)
     return 0;
 
   ambig = NSTRING_IS_AMBIG(node);
+  if (ambig) {
+    r = fold_string_table(sn->s, sn->end, reg, 0);
+    if (r < 0) return r;
+    if (r > 0) return SIZE_OPCODE + SIZE_LENGTH + r;
+  }
 
   p = prev = sn->s;
   prev_len = enclen(enc, p, sn->end);
@@ -522,6 +572,18 @@ compile_string_node(Node* node, regex_t* reg)
 
   end = sn->end;
   ambig = NSTRING_IS_AMBIG(node);
+  if (ambig) {
+    blen = fold_string_table(sn->s, end, reg, 0);
+    if (blen < 0) return blen;
+    if (blen > 0) {
+      r = add_opcode(reg, OP_EXACTN_FOLD);
+      if (r) return r;
+      r = add_length(reg, blen);
+      if (r) return r;
+      r = fold_string_table(sn->s, end, reg, 1);
+      return (r < 0 ? r : 0);
+    }
+  }
 
   p = prev = sn->s;
   prev_len = enclen(enc, p, end);
@@ -957,6 +1019,29 @@ compile_quantifier_node(QtfrNode* qn, regex_t* reg)
 
 #else /* USE_COMBINATION_EXPLOSION_CHECK */
 
+/* The loop body code of length len is one opcode that matches one
+   character (see OP_PUSH_SPAN). */
+static int
+is_span_loop_body(Node* target, const UChar* code, int len)
+{
+  switch (NTYPE(target)) {
+  case NT_STR:
+    return *code == OP_EXACT1 && len == SIZE_OPCODE + 1;
+
+  case NT_CCLASS:
+  case NT_CTYPE:
+    switch (*code) {
+    case OP_CCLASS:        case OP_CCLASS_MB:     case OP_CCLASS_MIX:
+    case OP_CCLASS_NOT:    case OP_CCLASS_MB_NOT: case OP_CCLASS_MIX_NOT:
+    case OP_WORD:          case OP_NOT_WORD:
+    case OP_ASCII_WORD:    case OP_NOT_ASCII_WORD:
+      return 1;
+    }
+    break;
+  }
+  return 0;
+}
+
 static int
 compile_length_quantifier_node(QtfrNode* qn, regex_t* reg)
 {
@@ -1098,20 +1183,30 @@ compile_quantifier_node(QtfrNode* qn, regex_t* reg)
       else
 #endif
       if (IS_NOT_NULL(qn->next_head_exact)) {
+	int push = reg->used;
+
 	r = add_opcode_rel_addr(reg, OP_PUSH_IF_PEEK_NEXT,
 				mod_tlen + SIZE_OP_JUMP);
 	if (r) return r;
 	add_bytes(reg, NSTR(qn->next_head_exact)->s, 1);
 	r = compile_tree_empty_check(qn->target, reg, empty_info);
 	if (r) return r;
+	if (is_span_loop_body(qn->target,
+			      reg->p + push + SIZE_OP_PUSH_IF_PEEK_NEXT, mod_tlen))
+	  reg->p[push] = OP_PUSH_SPAN_IF_PEEK_NEXT;
 	r = add_opcode_rel_addr(reg, OP_JUMP,
           -(mod_tlen + (int )SIZE_OP_JUMP + (int )SIZE_OP_PUSH_IF_PEEK_NEXT));
       }
       else {
+	int push = reg->used;
+
 	r = add_opcode_rel_addr(reg, OP_PUSH, mod_tlen + SIZE_OP_JUMP);
 	if (r) return r;
 	r = compile_tree_empty_check(qn->target, reg, empty_info);
 	if (r) return r;
+	if (is_span_loop_body(qn->target, reg->p + push + SIZE_OP_PUSH,
+			      mod_tlen))
+	  reg->p[push] = OP_PUSH_SPAN;
 	r = add_opcode_rel_addr(reg, OP_JUMP,
 		     -(mod_tlen + (int )SIZE_OP_JUMP + (int )SIZE_OP_PUSH));
       }
@@ -1205,6 +1300,18 @@ compile_option_node(EncloseNode* node, regex_t* reg)
   return r;
 }
 
+/* (?~string): the absent span ends at the last char of the first
+   occurrence of the string, so it is found by a single search. */
+static int
+is_absent_exact(EncloseNode* node)
+{
+  Node* target = node->target;
+
+  return IS_NOT_NULL(target) && NTYPE(target) == NT_STR &&
+	 NSTRING_LEN(target) > 0 &&
+	 !NSTRING_IS_RAW(target) && !NSTRING_IS_AMBIG(target);
+}
+
 static int
 compile_length_enclose_node(EncloseNode* node, regex_t* reg)
 {
@@ -1253,7 +1360,13 @@ compile_length_enclose_node(EncloseNode* node, regex_t* reg)
     break;
 
   case ENCLOSE_STOP_BACKTRACK:
-    if (IS_ENCLOSE_STOP_BT_SIMPLE_REPEAT(node)) {
+    if (IS_ENCLOSE_LINEBREAK(node)) {
+      len = SIZE_OP_LINEBREAK;
+    }
+    else if (IS_ENCLOSE_GRAPHEME_CLUSTER(node)) {
+      len = SIZE_OP_GRAPHEME_CLUSTER;
+    }
+    else if (IS_ENCLOSE_STOP_BT_SIMPLE_REPEAT(node)) {
       QtfrNode* qn = NQTFR(node->target);
       tlen = compile_length_tree(qn->target, reg);
       if (tlen < 0) return tlen;
@@ -1287,7 +1400,10 @@ compile_length_enclose_node(EncloseNode* node, regex_t* reg)
     break;
 
   case ENCLOSE_ABSENT:
-    len = SIZE_OP_PUSH_ABSENT_POS + SIZE_OP_ABSENT + tlen + SIZE_OP_ABSENT_END;
+    if (is_absent_exact(node))
+      len = SIZE_OP_ABSENT_EXACT + (int )NSTRING_LEN(node->target);
+    else
+      len = SIZE_OP_PUSH_ABSENT_POS + SIZE_OP_ABSENT + tlen + SIZE_OP_ABSENT_END;
     break;
 
   default:
@@ -1375,7 +1491,13 @@ compile_enclose_node(EncloseNode* node, regex_t* reg)
     break;
 
   case ENCLOSE_STOP_BACKTRACK:
-    if (IS_ENCLOSE_STOP_BT_SIMPLE_REPEAT(node)) {
+    if (IS_ENCLOSE_LINEBREAK(node)) {
+      r = add_opcode(reg, OP_LINEBREAK);
+    }
+    else if (IS_ENCLOSE_GRAPHEME_CLUSTER(node)) {
+      r = add_opcode(reg, OP_GRAPHEME_CLUSTER);
+    }
+    else if (IS_ENCLOSE_STOP_BT_SIMPLE_REPEAT(node)) {
       QtfrNode* qn = NQTFR(node->target);
       r = compile_tree_n_times(qn->target, qn->lower, reg);
       if (r) return r;
@@ -1435,6 +1557,17 @@ compile_enclose_node(EncloseNode* node, regex_t* reg)
     break;
 
   case ENCLOSE_ABSENT:
+    if (is_absent_exact(node)) {
+      StrNode* sn = NSTR(node->target);
+
+      r = add_opcode(reg, OP_ABSENT_EXACT);
+      if (r) return r;
+      r = add_length(reg, sn->end - sn->s);
+      if (r) return r;
+      r = add_bytes(reg, sn->s, sn->end - sn->s);
+      break;
+    }
+
     len = compile_length_tree(node->target, reg);
     if (len < 0) return len;
 
@@ -1474,10 +1607,17 @@ compile_length_anchor_node(AnchorNode* node, regex_t* reg)
     len = SIZE_OP_PUSH_POS_NOT + tlen + SIZE_OP_FAIL_POS;
     break;
   case ANCHOR_LOOK_BEHIND:
-    len = SIZE_OP_LOOK_BEHIND + tlen;
+    if (node->char_max_len >= 0)
+      len = SIZE_OP_LOOK_BEHIND_VAR + tlen + SIZE_OP_LOOK_BEHIND_VAR_END;
+    else
+      len = SIZE_OP_LOOK_BEHIND + tlen;
     break;
   case ANCHOR_LOOK_BEHIND_NOT:
-    len = SIZE_OP_PUSH_LOOK_BEHIND_NOT + tlen + SIZE_OP_FAIL_LOOK_BEHIND_NOT;
+    if (node->char_max_len >= 0)
+      len = SIZE_OP_PUSH_LOOK_BEHIND_NOT_VAR + tlen +
+	    SIZE_OP_FAIL_LOOK_BEHIND_NOT_VAR;
+    else
+      len = SIZE_OP_PUSH_LOOK_BEHIND_NOT + tlen + SIZE_OP_FAIL_LOOK_BEHIND_NOT;
     break;
 
   default:
@@ -1540,7 +1680,18 @@ compile_anchor_node(AnchorNode* node, regex_t* reg)
     break;
 
   case ANCHOR_LOOK_BEHIND:
-    {
+    if (node->char_max_len >= 0) {
+      r = add_opcode(reg, OP_LOOK_BEHIND_VAR);
+      if (r) return r;
+      r = add_length(reg, node->char_len);
+      if (r) return r;
+      r = add_length(reg, node->char_max_len);
+      if (r) return r;
+      r = compile_tree(node->target, reg);
+      if (r) return r;
+      r = add_opcode(reg, OP_LOOK_BEHIND_VAR_END);
+    }
+    else {
       int n;
       r = add_opcode(reg, OP_LOOK_BEHIND);
       if (r) return r;
@@ -1557,7 +1708,21 @@ compile_anchor_node(AnchorNode* node, regex_t* reg)
     break;
 
   case ANCHOR_LOOK_BEHIND_NOT:
-    {
+    if (node->char_max_len >= 0) {
+      len = compile_length_tree(node->target, reg);
+      if (len < 0) return len;
+      r = add_opcode_rel_addr(reg, OP_PUSH_LOOK_BEHIND_NOT_VAR,
+			      len + SIZE_OP_FAIL_LOOK_BEHIND_NOT_VAR);
+      if (r) return r;
+      r = add_length(reg, node->char_len);
+      if (r) return r;
+      r = add_length(reg, node->char_max_len);
+      if (r) return r;
+      r = compile_tree(node->target, reg);
+      if (r) return r;
+      r = add_opcode(reg, OP_FAIL_LOOK_BEHIND_NOT_VAR);
+    }
+    else {
       int n;
       len = compile_length_tree(node->target, reg);
       r = add_opcode_rel_addr(reg, OP_PUSH_LOOK_BEHIND_NOT,
@@ -1585,6 +1750,240 @@ compile_anchor_node(AnchorNode* node, regex_t* reg)
   return r;
 }
 
+/* Sets the bytes a match of node can start with in bs.  Returns 0 when
+   they are not known, e.g. when node can match the empty string. */
+static int
+get_head_byte_set(Node* node, BitSetRef bs, regex_t* reg)
+{
+  OnigEncoding enc = reg->enc;
+  int i, r = 0;
+
+  switch (NTYPE(node)) {
+  case NT_LIST:
+    do {
+      Node* x = NCAR(node);
+      r = get_head_byte_set(x, bs, reg);
+      /* anchors and look-arounds don't move, so try the next node */
+      if (r != 0 || NTYPE(x) != NT_ANCHOR) break;
+    } while (IS_NOT_NULL(node = NCDR(node)));
+    break;
+
+  case NT_ALT:
+    do {
+      r = get_head_byte_set(NCAR(node), bs, reg);
+    } while (r != 0 && IS_NOT_NULL(node = NCDR(node)));
+    break;
+
+  case NT_STR:
+    {
+      StrNode* sn = NSTR(node);
+
+      if (sn->end <= sn->s) break;
+      if (NSTRING_IS_RAW(node) || !IS_IGNORECASE(reg->options)) {
+	BITSET_SET_BIT(bs, sn->s[0]);
+	r = 1;
+      }
+      else if (ONIGENC_MBC_MINLEN(enc) == 1) {
+	OnigCaseFoldCodeItem items[ONIGENC_GET_CASE_FOLD_CODES_MAX_NUM];
+	UChar buf[ONIGENC_CODE_TO_MBC_MAXLEN];
+	int n;
+
+	n = ONIGENC_GET_CASE_FOLD_CODES_BY_STR(enc, reg->case_fold_flag,
+					       sn->s, sn->end, items);
+	if (n < 0) break;
+	BITSET_SET_BIT(bs, sn->s[0]);
+	for (i = 0; i < n; i++) {
+	  ONIGENC_CODE_TO_MBC(enc, items[i].code[0], buf);
+	  BITSET_SET_BIT(bs, buf[0]);
+	}
+	/* non-ASCII chars may fold to the first char (or chars) */
+	for (i = 0x80; i < SINGLE_BYTE_SIZE; i++)
+	  BITSET_SET_BIT(bs, i);
+	r = 1;
+      }
+    }
+    break;
+
+  case NT_CCLASS:
+    if (ONIGENC_MBC_MINLEN(enc) == 1) {
+      CClassNode* cc = NCCLASS(node);
+      int not = IS_NCCLASS_NOT(cc) ? 1 : 0;
+      int sb_end = ONIGENC_MBC_MAXLEN(enc) == 1 ? SINGLE_BYTE_SIZE : 0x80;
+
+      for (i = 0; i < sb_end; i++) {
+	if ((BITSET_AT(cc->bs, i) ? 1 : 0) != not)
+	  BITSET_SET_BIT(bs, i);
+      }
+      for (; i < SINGLE_BYTE_SIZE; i++)
+	BITSET_SET_BIT(bs, i);
+      r = 1;
+    }
+    break;
+
+  case NT_CTYPE:
+    if (ONIGENC_MBC_MINLEN(enc) == 1 &&
+	NCTYPE(node)->ctype == ONIGENC_CTYPE_WORD) {
+      int not = NCTYPE(node)->not;
+
+      for (i = 0; i < 0x80; i++) {
+	if ((ONIGENC_IS_CODE_WORD(enc, i) ? 1 : 0) != not)
+	  BITSET_SET_BIT(bs, i);
+      }
+      for (; i < SINGLE_BYTE_SIZE; i++)
+	BITSET_SET_BIT(bs, i);
+      r = 1;
+    }
+    break;
+
+  case NT_QTFR:
+    if (NQTFR(node)->lower > 0)
+      r = get_head_byte_set(NQTFR(node)->target, bs, reg);
+    break;
+
+  case NT_ENCLOSE:
+    {
+      EncloseNode* en = NENCLOSE(node);
+
+      switch (en->type) {
+      case ENCLOSE_OPTION:
+	{
+	  OnigOptionType options = reg->options;
+
+	  reg->options = en->option;
+	  r = get_head_byte_set(en->target, bs, reg);
+	  reg->options = options;
+	}
+	break;
+
+      case ENCLOSE_MEMORY:
+      case ENCLOSE_STOP_BACKTRACK:
+	r = get_head_byte_set(en->target, bs, reg);
+	break;
+
+      default:
+	break;
+      }
+    }
+    break;
+
+  case NT_ANCHOR:
+    if (NANCHOR(node)->type == ANCHOR_PREC_READ)
+      r = get_head_byte_set(NANCHOR(node)->target, bs, reg);
+    break;
+
+  default:
+    break;
+  }
+
+  return r;
+}
+
+/* Returns the number of branches if the alternation is worth compiling
+   with OP_ALT_DISPATCH, 0 otherwise. */
+static int
+alt_dispatch_branches(Node* node, regex_t* reg)
+{
+  int n = 0, known = 0;
+  BitSet bs;
+
+  do {
+    BITSET_CLEAR(bs);
+    if (get_head_byte_set(NCAR(node), bs, reg) != 0) known++;
+    n++;
+  } while (IS_NOT_NULL(node = NCDR(node)));
+
+  return (n >= ALT_DISPATCH_MIN_BRANCHES && known >= 2) ? n : 0;
+}
+
+static int
+compile_length_alt_dispatch(Node* node, int n, regex_t* reg)
+{
+  int len, r;
+
+  len = SIZE_OP_ALT_DISPATCH(n);
+  do {
+    r = compile_length_tree(NCAR(node), reg);
+    if (r < 0) return r;
+    len += r;
+    if (IS_NOT_NULL(NCDR(node)))
+      len += SIZE_OP_ALT_DISPATCH_NEXT + SIZE_OP_JUMP;
+  } while (IS_NOT_NULL(node = NCDR(node)));
+
+  return len;
+}
+
+/* OP_ALT_DISPATCH n addr[n] rows[ALT_DISPATCH_ROWS]
+ * L0:   OP_ALT_DISPATCH_NEXT table 0  branch-0  OP_JUMP end
+ * ...
+ * Ln-1: branch-(n-1)
+ * end:
+ *
+ * addr[i] is the offset of Li from addr[0].  Bit i of row c is set if
+ * branch i can match at a byte c (the last row is for the end of the
+ * string).  OP_ALT_DISPATCH jumps to the first such branch and each
+ * OP_ALT_DISPATCH_NEXT pushes the next one, so the branches that can't
+ * match are neither tried nor pushed. */
+static int
+compile_alt_dispatch(Node* node, int n, regex_t* reg)
+{
+  int i, j, r, len, rowsize, base, addr, end;
+  Node* x;
+  UChar* rows;
+  BitSet bs;
+
+  len = compile_length_alt_dispatch(node, n, reg);
+  if (len < 0) return len;
+  end = reg->used + len;
+
+  r = add_opcode(reg, OP_ALT_DISPATCH);
+  if (r) return r;
+  r = add_length(reg, n);
+  if (r) return r;
+
+  base = reg->used;
+  rowsize = ALT_DISPATCH_ROW_SIZE(n);
+  addr = SIZE_RELADDR * n + ALT_DISPATCH_ROWS * rowsize;
+  for (x = node; IS_NOT_NULL(x); x = NCDR(x)) {
+    r = add_rel_addr(reg, addr);
+    if (r) return r;
+    addr += compile_length_tree(NCAR(x), reg);
+    if (IS_NOT_NULL(NCDR(x)))
+      addr += SIZE_OP_ALT_DISPATCH_NEXT + SIZE_OP_JUMP;
+  }
+
+  rows = (UChar* )xcalloc(ALT_DISPATCH_ROWS, rowsize);
+  CHECK_NULL_RETURN_MEMERR(rows);
+  for (x = node, i = 0; IS_NOT_NULL(x); x = NCDR(x), i++) {
+    BITSET_CLEAR(bs);
+    r = get_head_byte_set(NCAR(x), bs, reg);
+    for (j = 0; j < ALT_DISPATCH_ROWS; j++) {
+      if (r == 0 || (j < SINGLE_BYTE_SIZE && BITSET_AT(bs, j)))
+	rows[j * rowsize + (i >> 3)] |= (UChar )(1 << (i & 7));
+    }
+  }
+  r = add_bytes(reg, rows, ALT_DISPATCH_ROWS * rowsize);
+  xfree(rows);
+  if (r) return r;
+
+  for (x = node, i = 0; IS_NOT_NULL(x); x = NCDR(x), i++) {
+    if (IS_NOT_NULL(NCDR(x))) {
+      r = add_opcode_rel_addr(reg, OP_ALT_DISPATCH_NEXT,
+			      base - (reg->used + SIZE_OPCODE + SIZE_RELADDR));
+      if (r) return r;
+      r = add_length(reg, i);
+      if (r) return r;
+    }
+    r = compile_tree(NCAR(x), reg);
+    if (r) return r;
+    if (IS_NOT_NULL(NCDR(x))) {
+      r = add_opcode_rel_addr(reg, OP_JUMP, end - (reg->used + SIZE_OP_JUMP));
+      if (r) return r;
+    }
+  }
+
+  return 0;
+}
+
 static int
 compile_length_tree(Node* node, regex_t* reg)
 {
@@ -1604,7 +2003,11 @@ compile_length_tree(Node* node, regex_t* reg)
 
   case NT_ALT:
     {
-      int n = 0;
+      int n = alt_dispatch_branches(node, reg);
+      if (n > 0) {
+	r = compile_length_alt_dispatch(node, n, reg);
+	break;
+      }
       len = 0;
       do {
 	r = compile_length_tree(NCAR(node), reg);
@@ -1696,6 +2099,11 @@ compile_tree(Node* node, regex_t* reg)
   case NT_ALT:
     {
       Node* x = node;
+      n = alt_dispatch_branches(node, reg);
+      if (n > 0) {
+	r = compile_alt_dispatch(node, n, reg);
+	break;
+      }
       len = 0;
       do {
 	len += compile_length_tree(NCAR(x), reg);
@@ -2024,17 +2432,18 @@ disable_noname_group_capture(Node** root, regex_t* reg, ScanEnv* env)
   BitStatusType loc;
   GroupNumRemap* map;
 
-  map = (GroupNumRemap* )xalloca(sizeof(GroupNumRemap) * (env->num_mem + 1));
+  /* num_mem can be up to ONIG_MAX_CAPTURE_GROUP_NUM: don't use alloca */
+  map = (GroupNumRemap* )xmalloc(sizeof(GroupNumRemap) * (env->num_mem + 1));
   CHECK_NULL_RETURN_MEMERR(map);
   for (i = 1; i <= env->num_mem; i++) {
     map[i].new_val = 0;
   }
   counter = 0;
   r = noname_disable_map(root, map, &counter);
-  if (r != 0) return r;
+  if (r != 0) goto end;
 
   r = renumber_by_map(*root, map);
-  if (r != 0) return r;
+  if (r != 0) goto end;
 
   for (i = 1, pos = 1; i <= env->num_mem; i++) {
     if (map[i].new_val > 0) {
@@ -2054,7 +2463,11 @@ disable_noname_group_capture(Node** root, regex_t* reg, ScanEnv* env)
   env->num_mem = env->num_named;
   reg->num_mem = env->num_named;
 
-  return onig_renumber_name_table(reg, map);
+  r = onig_renumber_name_table(reg, map);
+
+ end:
+  xfree(map);
+  return r;
 }
 #endif /* USE_NAMED_GROUP */
 
@@ -2307,7 +2720,11 @@ get_max_match_length(Node* node, OnigDistance *max, ScanEnv* env)
   case NT_STR:
     {
       StrNode* sn = NSTR(node);
-      *max = sn->end - sn->s;
+      if (NSTRING_IS_AMBIG(node))  /* a folded char may have another length */
+	*max = (OnigDistance )ONIGENC_MBC_MAXLEN_DIST(env->enc) *
+	       onigenc_strlen(env->enc, sn->s, sn->end);
+      else
+	*max = sn->end - sn->s;
     }
     break;
 
@@ -2394,6 +2811,7 @@ get_max_match_length(Node* node, OnigDistance *max, ScanEnv* env)
 	break;
 
       case ENCLOSE_ABSENT:
+	*max = ONIG_INFINITE_DISTANCE;
 	break;
       }
     }
@@ -2542,6 +2960,157 @@ get_char_length_tree(Node* node, regex_t* reg, int* len)
   return get_char_length_tree1(node, reg, len, 0);
 }
 
+/* how far before its start a match may read, by look-behinds (see
+   onig_search_segments()) */
+static OnigDistance
+get_behind_length(Node* node, regex_t* reg)
+{
+  OnigDistance len = 0, t;
+
+  switch (NTYPE(node)) {
+  case NT_LIST:
+  case NT_ALT:
+    do {
+      t = get_behind_length(NCAR(node), reg);
+      if (len < t) len = t;
+    } while (IS_NOT_NULL(node = NCDR(node)));
+    break;
+
+  case NT_QTFR:
+    len = get_behind_length(NQTFR(node)->target, reg);
+    break;
+
+  case NT_ENCLOSE:
+    len = get_behind_length(NENCLOSE(node)->target, reg);
+    break;
+
+  case NT_ANCHOR:
+    {
+      AnchorNode* an = NANCHOR(node);
+      int n;
+
+      if (IS_NULL(an->target)) break;
+      len = get_behind_length(an->target, reg);
+      if (an->type == ANCHOR_LOOK_BEHIND ||
+	  an->type == ANCHOR_LOOK_BEHIND_NOT) {
+	n = (an->char_max_len >= 0 ? an->char_max_len : an->char_len);
+	if (n < 0 && get_char_length_tree(an->target, reg, &n) != 0)
+	  return ONIG_INFINITE_DISTANCE;
+	t = distance_multiply(ONIGENC_MBC_MAXLEN_DIST(reg->enc), n + 1);
+	len = distance_add(len, t);
+      }
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return len;
+}
+
+/* min and max character length of a bounded pattern node */
+static int
+get_char_length_range(Node* node, regex_t* reg,
+		      OnigDistance* min, OnigDistance* max)
+{
+  OnigDistance tmin, tmax;
+  int r = 0;
+
+  *min = *max = 0;
+  switch (NTYPE(node)) {
+  case NT_LIST:
+    do {
+      r = get_char_length_range(NCAR(node), reg, &tmin, &tmax);
+      if (r == 0) {
+	*min = distance_add(*min, tmin);
+	*max = distance_add(*max, tmax);
+      }
+    } while (r == 0 && IS_NOT_NULL(node = NCDR(node)));
+    break;
+
+  case NT_ALT:
+    r = get_char_length_range(NCAR(node), reg, min, max);
+    while (r == 0 && IS_NOT_NULL(node = NCDR(node))) {
+      r = get_char_length_range(NCAR(node), reg, &tmin, &tmax);
+      if (r == 0) {
+	if (*min > tmin) *min = tmin;
+	if (*max < tmax) *max = tmax;
+      }
+    }
+    break;
+
+  case NT_STR:
+    {
+      StrNode* sn = NSTR(node);
+      UChar *s = sn->s;
+      while (s < sn->end) {
+	s += enclen(reg->enc, s, sn->end);
+	(*min)++;
+      }
+      *max = *min;
+    }
+    break;
+
+  case NT_QTFR:
+    {
+      QtfrNode* qn = NQTFR(node);
+      r = get_char_length_range(qn->target, reg, &tmin, &tmax);
+      if (r == 0) {
+	*min = distance_multiply(tmin, qn->lower);
+	if (IS_REPEAT_INFINITE(qn->upper))
+	  *max = (tmax == 0 ? 0 : ONIG_INFINITE_DISTANCE);
+	else
+	  *max = distance_multiply(tmax, qn->upper);
+      }
+    }
+    break;
+
+#ifdef USE_SUBEXP_CALL
+  case NT_CALL:
+    if (! IS_CALL_RECURSION(NCALL(node)))
+      r = get_char_length_range(NCALL(node)->target, reg, min, max);
+    else
+      r = GET_CHAR_LEN_VARLEN;
+    break;
+#endif
+
+  case NT_CTYPE:
+  case NT_CCLASS:
+  case NT_CANY:
+    *min = *max = 1;
+    break;
+
+  case NT_ENCLOSE:
+    {
+      EncloseNode* en = NENCLOSE(node);
+      switch (en->type) {
+      case ENCLOSE_MEMORY:
+      case ENCLOSE_OPTION:
+      case ENCLOSE_STOP_BACKTRACK:
+      case ENCLOSE_CONDITION:
+	r = get_char_length_range(en->target, reg, min, max);
+	break;
+      default:
+	r = GET_CHAR_LEN_VARLEN;
+	break;
+      }
+    }
+    break;
+
+  case NT_ANCHOR:
+    break;
+
+  default:
+    r = GET_CHAR_LEN_VARLEN;
+    break;
+  }
+
+  if (r == 0 && *max == ONIG_INFINITE_DISTANCE)
+    r = GET_CHAR_LEN_VARLEN;
+  return r;
+}
+
 /* x is not included y ==>  1 : 0 */
 static int
 is_not_included(Node* x, Node* y, regex_t* reg)
@@ -3254,11 +3823,65 @@ setup_subexp_call(Node* node, ScanEnv* env)
     }
     break;
 
-  default:
-    break;
+  default:
+    break;
+  }
+
+  return r;
+}
+
+static int
+tree_depth(Node* node)
+{
+  int d, depth = 0;
+
+  switch (NTYPE(node)) {
+  case NT_LIST:
+  case NT_ALT:
+    do {
+      d = tree_depth(NCAR(node));
+      if (d > depth) depth = d;
+    } while (IS_NOT_NULL(node = NCDR(node)));
+    break;
+
+  case NT_QTFR:
+    depth = tree_depth(NQTFR(node)->target);
+    break;
+
+  case NT_ENCLOSE:
+    depth = tree_depth(NENCLOSE(node)->target);
+    break;
+
+  case NT_ANCHOR:
+    if (IS_NOT_NULL(NANCHOR(node)->target))
+      depth = tree_depth(NANCHOR(node)->target);
+    break;
+
+  default:
+    break;
+  }
+
+  return depth + 1;
+}
+
+/* The passes which follow subexp calls recurse into the called groups.
+   They stop at a group which is already on the path, so the nest is at
+   most the depth of the tree plus the depths of all the called groups. */
+static int
+subexp_call_depth_check(Node* root, ScanEnv* env)
+{
+  int i, depth;
+  Node** nodes = SCANENV_MEM_NODES(env);
+
+  depth = tree_depth(root);
+  for (i = 0; i <= env->num_mem; i++) {
+    if (IS_NOT_NULL(nodes[i]) && IS_ENCLOSE_CALLED(NENCLOSE(nodes[i]))) {
+      depth += tree_depth(nodes[i]);
+      if (depth > BOUNDED_NATIVE_STACK_TREE_DEPTH_LIMIT)
+	return ONIGERR_PARSE_DEPTH_LIMIT_OVER;
+    }
   }
-
-  return r;
+  return 0;
 }
 #endif
 
@@ -3304,6 +3927,28 @@ divide_look_behind_alternatives(Node* node)
   return 0;
 }
 
+/* Variable length look-behind (?<=A(?:b|cd)) is tried from each of the
+   char positions between its min and max length back, and must end at
+   the position it started from. */
+static int
+setup_var_look_behind(Node* node, regex_t* reg, ScanEnv* env)
+{
+  int r;
+  OnigDistance min, max;
+  AnchorNode* an = NANCHOR(node);
+
+  if (! IS_SYNTAX_BV(env->syntax, ONIG_SYN_VARIABLE_LEN_LOOK_BEHIND))
+    return ONIGERR_INVALID_LOOK_BEHIND_PATTERN;
+
+  r = get_char_length_range(an->target, reg, &min, &max);
+  if (r != 0 || max > ONIG_MAX_REPEAT_NUM)
+    return ONIGERR_INVALID_LOOK_BEHIND_PATTERN;
+
+  an->char_len     = (int )min;
+  an->char_max_len = (int )max;
+  return 0;
+}
+
 static int
 setup_look_behind(Node* node, regex_t* reg, ScanEnv* env)
 {
@@ -3314,12 +3959,12 @@ setup_look_behind(Node* node, regex_t* reg, ScanEnv* env)
   if (r == 0)
     an->char_len = len;
   else if (r == GET_CHAR_LEN_VARLEN)
-    r = ONIGERR_INVALID_LOOK_BEHIND_PATTERN;
+    r = setup_var_look_behind(node, reg, env);
   else if (r == GET_CHAR_LEN_TOP_ALT_VARLEN) {
     if (IS_SYNTAX_BV(env->syntax, ONIG_SYN_DIFFERENT_LEN_ALT_LOOK_BEHIND))
       r = divide_look_behind_alternatives(node);
     else
-      r = ONIGERR_INVALID_LOOK_BEHIND_PATTERN;
+      r = setup_var_look_behind(node, reg, env);
   }
 
   return r;
@@ -4247,6 +4892,21 @@ endcheck:
   return (int )len;
 }
 
+/* set skip map for Sunday's quick search run backward: the shift for
+   the byte just before the window is one more than its first position
+   in the target */
+static void
+set_bm_backward_skip(UChar* s, UChar* end, UChar skip[])
+{
+  int i, len;
+
+  len = (int )(end - s);
+  for (i = 0; i < ONIG_CHAR_TABLE_SIZE; i++)
+    skip[i] = (UChar )(len + 1);
+  for (i = len - 1; i >= 0; i--)
+    skip[s[i]] = (UChar )(i + 1);
+}
+
 typedef struct {
   OnigDistance min;  /* min byte length */
   OnigDistance max;  /* max byte length */
@@ -4606,6 +5266,53 @@ alt_merge_opt_exact_info(OptExactInfo* to, OptExactInfo* add, OptEnv* env)
   if (! to->reach_end) to->anc.right_anchor = 0;
 }
 
+/* The longest string of two or more chars found in both a and b, placed
+   at either of their positions.  Only the middle info can take it: it
+   doesn't start at the boundary of the alternatives. */
+static void
+common_opt_exact_info(OptExactInfo* to, OptExactInfo* a, OptExactInfo* b,
+		      OnigEncoding enc)
+{
+  int i, j, k, n, len, best, bi, bj;
+  MinMaxLen bmm;
+
+  clear_opt_exact_info(to);
+  if (a->len == 0 || b->len == 0 ||
+      a->ignore_case != 0 || b->ignore_case != 0)
+    return ;
+
+  best = bi = bj = 0;
+  for (i = 0; i < a->len - best; i += enclen(enc, a->s + i, a->s + a->len)) {
+    for (j = 0; j < b->len - best; j += enclen(enc, b->s + j, b->s + b->len)) {
+      for (k = n = 0; i + k < a->len; k += len, n++) {
+	len = enclen(enc, a->s + i + k, a->s + a->len);
+	if (j + k + len > b->len ||
+	    memcmp(a->s + i + k, b->s + j + k, len) != 0)
+	  break;
+      }
+      if (k > best && n >= 2) {
+	best = k;
+	bi = i;
+	bj = j;
+      }
+    }
+  }
+  if (best == 0) return ;
+
+  xmemcpy(to->s, a->s + bi, best);
+  to->len = best;
+  to->ignore_case = 0;
+  to->reach_end = (bi + best == a->len && bj + best == b->len &&
+		   a->reach_end && b->reach_end);
+  if (to->reach_end)
+    to->anc.right_anchor = a->anc.right_anchor & b->anc.right_anchor;
+
+  set_mml(&to->mmd, distance_add(a->mmd.min, bi),
+	  distance_add(a->mmd.max, bi));
+  set_mml(&bmm, distance_add(b->mmd.min, bj), distance_add(b->mmd.max, bj));
+  alt_merge_mml(&to->mmd, &bmm);
+}
+
 static void
 select_opt_exact_info(OnigEncoding enc, OptExactInfo* now, OptExactInfo* alt)
 {
@@ -4848,11 +5555,23 @@ concat_left_node_opt_info(OnigEncoding enc, NodeOptInfo* to, NodeOptInfo* add)
 static void
 alt_merge_node_opt_info(NodeOptInfo* to, NodeOptInfo* add, OptEnv* env)
 {
+  OptExactInfo com, tmp;
+
+  /* a string required by every alternative, wherever it is in them */
+  common_opt_exact_info(&com, &to->exb, &add->exb, env->enc);
+  common_opt_exact_info(&tmp, &to->exb, &add->exm, env->enc);
+  select_opt_exact_info(env->enc, &com, &tmp);
+  common_opt_exact_info(&tmp, &to->exm, &add->exb, env->enc);
+  select_opt_exact_info(env->enc, &com, &tmp);
+  common_opt_exact_info(&tmp, &to->exm, &add->exm, env->enc);
+  select_opt_exact_info(env->enc, &com, &tmp);
+
   alt_merge_opt_anc_info  (&to->anc,  &add->anc);
   alt_merge_opt_exact_info(&to->exb,  &add->exb, env);
   alt_merge_opt_exact_info(&to->exm,  &add->exm, env);
   alt_merge_opt_exact_info(&to->expr, &add->expr, env);
   alt_merge_opt_map_info(env->enc, &to->map,  &add->map);
+  select_opt_exact_info(env->enc, &to->exm, &com);
 
   alt_merge_mml(&to->len, &add->len);
 }
@@ -4920,12 +5639,12 @@ optimize_node_left(Node* node, NodeOptInfo* opt, OptEnv* env)
       }
       else {
 	OnigDistance max;
+	int n = onigenc_strlen(env->enc, sn->s, sn->end);
 
-	if (NSTRING_IS_DONT_GET_OPT_INFO(node)) {
-	  int n = onigenc_strlen(env->enc, sn->s, sn->end);
-	  max = (OnigDistance )ONIGENC_MBC_MAXLEN_DIST(env->enc) * n;
-	}
-	else {
+	/* a folded char may match a char of another length (k: U+212A) */
+	max = (OnigDistance )ONIGENC_MBC_MAXLEN_DIST(env->enc) * n;
+
+	if (! NSTRING_IS_DONT_GET_OPT_INFO(node)) {
 	  concat_opt_exact_info_str(&opt->exb, sn->s, sn->end,
 				    is_raw, env->enc);
 	  opt->exb.ignore_case = 1;
@@ -4935,8 +5654,6 @@ optimize_node_left(Node* node, NodeOptInfo* opt, OptEnv* env)
 					  env->enc, env->case_fold_flag);
 	    if (r != 0) break;
 	  }
-
-	  max = slen;
 	}
 
 	set_mml(&opt->len, slen, max);
@@ -5213,10 +5930,30 @@ optimize_node_left(Node* node, NodeOptInfo* opt, OptEnv* env)
   return r;
 }
 
+/* The map is allocated only for the BM and MAP optimizations. */
+static int
+alloc_optimize_map(regex_t* reg, size_t size)
+{
+  if (IS_NULL(reg->map)) {
+    reg->map = (UChar* )xmalloc(size);
+    CHECK_NULL_RETURN_MEMERR(reg->map);
+  }
+  return 0;
+}
+
+static void
+free_optimize_map(regex_t* reg)
+{
+  if (IS_NOT_NULL(reg->map)) {
+    xfree(reg->map);
+    reg->map = (UChar* )NULL;
+  }
+}
+
 static int
 set_optimize_exact_info(regex_t* reg, OptExactInfo* e)
 {
-  int allow_reverse;
+  int r, allow_reverse;
 
   if (e->len == 0) return 0;
 
@@ -5228,6 +5965,12 @@ set_optimize_exact_info(regex_t* reg, OptExactInfo* e)
   allow_reverse =
 	ONIGENC_IS_ALLOWED_REVERSE_MATCH(reg->enc, reg->exact, reg->exact_end);
 
+  if (e->len >= 3 || (e->len >= 2 && allow_reverse)) {
+    r = alloc_optimize_map(reg, e->ignore_case > 0 ?
+			   ONIG_CHAR_TABLE_SIZE : ONIG_CHAR_TABLE_SIZE * 2);
+    if (r != 0) return r;
+  }
+
   if (e->ignore_case > 0) {
     if (e->len >= 3 || (e->len >= 2 && allow_reverse)) {
       e->len = set_bm_skip(reg->exact, reg->exact_end, reg,
@@ -5239,9 +5982,12 @@ set_optimize_exact_info(regex_t* reg, OptExactInfo* e)
       }
       else if (e->len > 0) {
 	reg->optimize = ONIG_OPTIMIZE_EXACT_IC;
+	free_optimize_map(reg);
       }
-      else
+      else {
+	free_optimize_map(reg);
 	return 0;
+      }
     }
     else {
       reg->optimize = ONIG_OPTIMIZE_EXACT_IC;
@@ -5251,6 +5997,7 @@ set_optimize_exact_info(regex_t* reg, OptExactInfo* e)
     if (e->len >= 3 || (e->len >= 2 && allow_reverse)) {
       set_bm_skip(reg->exact, reg->exact_end, reg,
 		  reg->map, 0);
+      set_bm_backward_skip(reg->exact, reg->exact_end, BM_BACKWARD_SKIP(reg));
       reg->optimize = (allow_reverse != 0
 		     ? ONIG_OPTIMIZE_EXACT_BM : ONIG_OPTIMIZE_EXACT_BM_NOT_REV);
     }
@@ -5269,10 +6016,13 @@ set_optimize_exact_info(regex_t* reg, OptExactInfo* e)
   return 0;
 }
 
-static void
+static int
 set_optimize_map_info(regex_t* reg, OptMapInfo* m)
 {
-  int i;
+  int i, r;
+
+  r = alloc_optimize_map(reg, ONIG_CHAR_TABLE_SIZE);
+  if (r != 0) return r;
 
   for (i = 0; i < ONIG_CHAR_TABLE_SIZE; i++)
     reg->map[i] = m->map[i];
@@ -5284,6 +6034,7 @@ set_optimize_map_info(regex_t* reg, OptMapInfo* m)
   if (reg->dmin != ONIG_INFINITE_DISTANCE) {
     reg->threshold_len = (int )(reg->dmin + 1);
   }
+  return 0;
 }
 
 static void
@@ -5328,6 +6079,7 @@ set_optimize_info_from_tree(Node* node, regex_t* reg, ScanEnv* scan_env)
     reg->anchor_dmin = opt.len.min;
     reg->anchor_dmax = opt.len.max;
   }
+  reg->max_len = opt.len.max;
 
   if (opt.exb.len > 0 || opt.exm.len > 0) {
     select_opt_exact_info(reg->enc, &opt.exb, &opt.exm);
@@ -5342,7 +6094,7 @@ set_optimize_info_from_tree(Node* node, regex_t* reg, ScanEnv* scan_env)
   }
   else if (opt.map.value > 0) {
   set_map:
-    set_optimize_map_info(reg, &opt.map);
+    r = set_optimize_map_info(reg, &opt.map);
     set_sub_anchor(reg, &opt.map.anc);
   }
   else {
@@ -5367,10 +6119,41 @@ clear_optimize_info(regex_t* reg)
   reg->sub_anchor    = 0;
   reg->exact_end     = (UChar* )NULL;
   reg->threshold_len = 0;
+  reg->dmin          = 0;
+  reg->dmax          = 0;
+  reg->max_len       = ONIG_INFINITE_DISTANCE;
   if (IS_NOT_NULL(reg->exact)) {
     xfree(reg->exact);
     reg->exact = (UChar* )NULL;
   }
+  free_optimize_map(reg);
+}
+
+extern int
+onig_get_optimize_info(const regex_t* reg, OnigOptimizeInfo* info)
+{
+  int i;
+
+  if (IS_NULL(reg) || IS_NULL(info)) return ONIGERR_INVALID_ARGUMENT;
+
+  info->optimize      = reg->optimize;
+  info->anchor        = reg->anchor;
+  info->anchor_dmin   = reg->anchor_dmin;
+  info->anchor_dmax   = reg->anchor_dmax;
+  info->sub_anchor    = reg->sub_anchor;
+  info->exact         = reg->exact;
+  info->exact_end     = reg->exact_end;
+  info->dmin          = reg->dmin;
+  info->dmax          = reg->dmax;
+  info->threshold_len = reg->threshold_len;
+
+  info->map_count = 0;
+  if (reg->optimize == ONIG_OPTIMIZE_MAP) {
+    for (i = 0; i < ONIG_CHAR_TABLE_SIZE; i++)
+      if (reg->map[i]) info->map_count++;
+  }
+
+  return ONIG_NORMAL;
 }
 
 #ifdef ONIG_DEBUG
@@ -5533,9 +6316,14 @@ extern void
 onig_free_body(regex_t* reg)
 {
   if (IS_NOT_NULL(reg)) {
+    if (IS_NOT_NULL(reg->exact) && !IS_IN_REGEX_BLOCK(reg, reg->exact))
+      xfree(reg->exact);
+    if (IS_NOT_NULL(reg->map) && !IS_IN_REGEX_BLOCK(reg, reg->map))
+      xfree(reg->map);
+    if (IS_NOT_NULL(reg->repeat_range) &&
+	!IS_IN_REGEX_BLOCK(reg, reg->repeat_range))
+      xfree(reg->repeat_range);
     if (IS_NOT_NULL(reg->p))                xfree(reg->p);
-    if (IS_NOT_NULL(reg->exact))            xfree(reg->exact);
-    if (IS_NOT_NULL(reg->repeat_range))     xfree(reg->repeat_range);
     if (IS_NOT_NULL(reg->chain))            onig_free(reg->chain);
 
 #ifdef USE_NAMED_GROUP
@@ -5553,20 +6341,25 @@ onig_free(regex_t* reg)
   }
 }
 
-#ifdef RUBY
-size_t
+extern size_t
 onig_memsize(const regex_t *reg)
 {
     size_t size = sizeof(regex_t);
     if (IS_NULL(reg)) return 0;
     if (IS_NOT_NULL(reg->p))                size += reg->alloc;
-    if (IS_NOT_NULL(reg->exact))            size += reg->exact_end - reg->exact;
-    if (IS_NOT_NULL(reg->repeat_range))     size += reg->repeat_range_alloc * sizeof(OnigRepeatRange);
+    if (IS_NOT_NULL(reg->exact) && !IS_IN_REGEX_BLOCK(reg, reg->exact))
+      size += reg->exact_end - reg->exact;
+    if (IS_NOT_NULL(reg->map) && !IS_IN_REGEX_BLOCK(reg, reg->map))
+      size += OPTIMIZE_MAP_SIZE(reg);
+    if (IS_NOT_NULL(reg->repeat_range) &&
+	!IS_IN_REGEX_BLOCK(reg, reg->repeat_range))
+      size += reg->repeat_range_alloc * sizeof(OnigRepeatRange);
     if (IS_NOT_NULL(reg->chain))            size += onig_memsize(reg->chain);
 
     return size;
 }
 
+#ifdef RUBY
 size_t
 onig_region_memsize(const OnigRegion *regs)
 {
@@ -5598,24 +6391,124 @@ static void print_compiled_byte_code_list(FILE* f, regex_t* reg);
 static void print_tree(FILE* f, Node* node);
 #endif
 
-#ifdef RUBY
-extern int
-onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
-	     OnigErrorInfo* einfo)
+/* Give back the unused tail of the code buffer, which grows by doubling. */
+static void
+trim_regex_code(regex_t* reg)
 {
-  return onig_compile_ruby(reg, pattern, pattern_end, einfo, NULL, 0);
+  UChar* p;
+
+  if (reg->used > 0 && reg->used < reg->alloc) {
+    p = (UChar* )xrealloc(reg->p, reg->used);
+    if (IS_NOT_NULL(p)) {
+      reg->p     = p;
+      reg->alloc = reg->used;
+    }
+  }
 }
-#endif
 
-#ifdef RUBY
-extern int
-onig_compile_ruby(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
-	      OnigErrorInfo* einfo, const char *sourcefile, int sourceline)
-#else
+#define PACK_ALIGN(n) \
+  (((n) + sizeof(OnigDistance) - 1) / sizeof(OnigDistance) * sizeof(OnigDistance))
+
+/* Move the bytecode, the exact string, the map and the repeat ranges into
+   one block, so that a compiled regex owns a single allocation (besides
+   the name table).  onig_free_body() recognizes pointers into the block.
+   The size of the block is rounded up to a multiple of unit. */
+static int
+pack_regex_block(regex_t* reg, size_t unit)
+{
+  size_t exact_pos, map_pos, range_pos, size;
+  OnigDistance exact_len;
+  UChar* block;
+
+  exact_len = IS_NOT_NULL(reg->exact) ? reg->exact_end - reg->exact : 0;
+  exact_pos = PACK_ALIGN(reg->used);
+  map_pos   = exact_pos + exact_len;
+  range_pos = PACK_ALIGN(map_pos +
+			 (IS_NOT_NULL(reg->map) ? OPTIMIZE_MAP_SIZE(reg) : 0));
+  size = range_pos + reg->num_repeat * sizeof(OnigRepeatRange);
+  size = (size + unit - 1) / unit * unit;
+
+  block = (UChar* )xmalloc(size);
+  CHECK_NULL_RETURN_MEMERR(block);
+  xmemcpy(block, reg->p, reg->used);
+
+  /* the old pieces may already be in a block (onig_regex_share()) */
+  if (IS_NOT_NULL(reg->exact)) {
+    xmemcpy(block + exact_pos, reg->exact, exact_len);
+    if (! IS_IN_REGEX_BLOCK(reg, reg->exact)) xfree(reg->exact);
+    reg->exact     = block + exact_pos;
+    reg->exact_end = reg->exact + exact_len;
+  }
+  if (IS_NOT_NULL(reg->map)) {
+    xmemcpy(block + map_pos, reg->map, OPTIMIZE_MAP_SIZE(reg));
+    if (! IS_IN_REGEX_BLOCK(reg, reg->map)) xfree(reg->map);
+    reg->map = block + map_pos;
+  }
+  if (IS_NOT_NULL(reg->repeat_range)) {
+    xmemcpy(block + range_pos, reg->repeat_range,
+	    reg->num_repeat * sizeof(OnigRepeatRange));
+    if (! IS_IN_REGEX_BLOCK(reg, reg->repeat_range)) xfree(reg->repeat_range);
+    reg->repeat_range = (OnigRepeatRange* )(block + range_pos);
+    reg->repeat_range_alloc = reg->num_repeat;
+  }
+
+  xfree(reg->p);
+  reg->p     = block;
+  reg->alloc = (unsigned int )size;
+  return 0;
+}
+
+/* Searches never write to a compiled regex, so it can be shared by threads
+   as is.  This only moves everything read by a search into one block,
+   rounded up to whole cache lines, so that it stays compact. */
 extern int
-onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
-	     OnigErrorInfo* einfo)
-#endif
+onig_regex_share(regex_t* reg)
+{
+  if (IS_NULL(reg) || IS_NULL(reg->p)) return ONIGERR_INVALID_ARGUMENT;
+
+  return pack_regex_block(reg, CACHE_LINE_SIZE);
+}
+
+/* root followed by the characters of [s, end) taken literally, under
+   the option in effect at the end of the pattern (e.g. after "(?i)") */
+static int
+append_literal(Node** root, const UChar* s, const UChar* end,
+	       OnigOptionType option, regex_t* reg)
+{
+  Node *node, *list;
+  const UChar* p;
+
+  for (p = s; p < end; p += enclen(reg->enc, p, end)) ;
+  if (p != end) return ONIGERR_TOO_SHORT_MULTI_BYTE_STRING;
+  if (s == end) return 0;
+
+  node = onig_node_new_str(s, end);
+  CHECK_NULL_RETURN_MEMERR(node);
+  if (option != reg->options) {
+    Node* en = onig_node_new_enclose(ENCLOSE_OPTION);
+    if (IS_NULL(en)) goto err;
+    NENCLOSE(en)->option = option;
+    NENCLOSE(en)->target = node;
+    node = en;
+  }
+  if (NTYPE(*root) != NT_LIST) {
+    list = onig_node_new_list(*root, NULL_NODE);
+    if (IS_NULL(list)) goto err;
+    *root = list;
+  }
+  if (IS_NULL(onig_node_list_add(*root, node))) goto err;
+  return 0;
+
+ err:
+  onig_node_free(node);
+  return ONIGERR_MEMORY;
+}
+
+static int
+compile_regex(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
+	      const UChar* literal, const UChar* literal_end,
+	      OnigErrorInfo* einfo, const char *sourcefile ARG_UNUSED,
+	      int sourceline ARG_UNUSED)
 {
 #define COMPILE_INIT_SIZE  20
 
@@ -5659,6 +6552,12 @@ onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
   r = onig_parse_make_tree(&root, pattern, pattern_end, reg, &scan_env);
   if (r != 0) goto err;
 
+  if (IS_NOT_NULL(literal)) {
+    r = append_literal(&root, literal, literal_end,
+		       scan_env.end_option, reg);
+    if (r != 0) goto err;
+  }
+
 #ifdef ONIG_DEBUG_PARSE_TREE
 # if 0
   fprintf(stderr, "ORIGINAL PARSE TREE:\n");
@@ -5687,6 +6586,10 @@ onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
     scan_env.unset_addr_list = &uslist;
     r = setup_subexp_call(root, &scan_env);
     if (r != 0) goto err_unset;
+    if (OnigBoundedNativeStack) {
+      r = subexp_call_depth_check(root, &scan_env);
+      if (r != 0) goto err_unset;
+    }
     r = subexp_recursive_check_trav(root, &scan_env);
     if (r  < 0) goto err_unset;
     r = subexp_inf_recursive_check_trav(root, &scan_env);
@@ -5747,6 +6650,7 @@ onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
   r = set_optimize_info_from_tree(root, reg, &scan_env);
   if (r != 0) goto err_unset;
 #endif
+  reg->reach_behind = get_behind_length(root, reg);
 
   if (IS_NOT_NULL(scan_env.mem_nodes_dynamic)) {
     xfree(scan_env.mem_nodes_dynamic);
@@ -5764,7 +6668,11 @@ onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
     }
 #endif
 
-    if ((reg->num_repeat != 0) || (reg->bt_mem_end != 0))
+    if ((reg->num_repeat != 0) || (reg->bt_mem_end != 0)
+#ifdef USE_SUBEXP_CALL
+	|| (scan_env.num_call > 0)
+#endif
+	)
       reg->stack_pop_level = STACK_POP_LEVEL_ALL;
     else {
       if (reg->bt_mem_start != 0)
@@ -5780,6 +6688,18 @@ onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
 #endif
   onig_node_free(root);
 
+#ifdef USE_NAMED_GROUP
+  if (r == 0)
+    r = onig_names_make_list(reg);
+#endif
+
+  if (r == 0) {
+    if (IS_CONTIGUOUS(reg->options))
+      r = pack_regex_block(reg, 1);
+    else
+      trim_regex_code(reg);
+  }
+
 #ifdef ONIG_DEBUG_COMPILE
 # ifdef USE_NAMED_GROUP
   onig_print_names(stderr, reg);
@@ -5811,8 +6731,148 @@ onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
   return r;
 }
 
+#ifdef RUBY
+extern int
+onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
+	     OnigErrorInfo* einfo)
+{
+  return onig_compile_ruby(reg, pattern, pattern_end, einfo, NULL, 0);
+}
+
+extern int
+onig_compile_ruby(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
+	      OnigErrorInfo* einfo, const char *sourcefile, int sourceline)
+{
+  return compile_regex(reg, pattern, pattern_end, NULL, NULL, einfo,
+		       sourcefile, sourceline);
+}
+#else
+extern int
+onig_compile(regex_t* reg, const UChar* pattern, const UChar* pattern_end,
+	     OnigErrorInfo* einfo)
+{
+  return compile_regex(reg, pattern, pattern_end, NULL, NULL, einfo, NULL, 0);
+}
+#endif
+
 static int onig_inited = 0;
 
+/* Fixed while the library is initialized, so it is never written while
+   other threads compile or search. */
+int OnigBoundedNativeStack = DEFAULT_BOUNDED_NATIVE_STACK;
+
+extern int
+onig_get_bounded_native_stack(void)
+{
+  return OnigBoundedNativeStack;
+}
+
+extern int
+onig_set_bounded_native_stack(int enable)
+{
+  if (onig_inited)
+    return ONIGERR_INVALID_ARGUMENT;
+
+  OnigBoundedNativeStack = (enable != 0);
+  return ONIG_NORMAL;
+}
+
+#ifdef USE_ALLOCATOR_HOOK
+static void*
+default_malloc(size_t size, void* context ARG_UNUSED)
+{
+  return malloc(size);
+}
+
+static void*
+default_realloc(void* ptr, size_t size, void* context ARG_UNUSED)
+{
+  return realloc(ptr, size);
+}
+
+static void
+default_free(void* ptr, void* context ARG_UNUSED)
+{
+  free(ptr);
+}
+
+static OnigAllocator Allocator = {
+  default_malloc, default_realloc, default_free, (void* )NULL
+};
+
+extern void*
+onig_xmalloc(size_t size)
+{
+  return (*Allocator.malloc_func)(size, Allocator.context);
+}
+
+extern void*
+onig_xrealloc(void* ptr, size_t size)
+{
+  return (*Allocator.realloc_func)(ptr, size, Allocator.context);
+}
+
+extern void*
+onig_xcalloc(size_t n, size_t size)
+{
+  void* ptr;
+
+  if (size != 0 && n > ((size_t )-1) / size) return NULL;
+  ptr = (*Allocator.malloc_func)(n * size, Allocator.context);
+  if (IS_NOT_NULL(ptr)) xmemset(ptr, 0, n * size);
+  return ptr;
+}
+
+extern void
+onig_xfree(void* ptr)
+{
+  if (IS_NOT_NULL(ptr))
+    (*Allocator.free_func)(ptr, Allocator.context);
+}
+#endif /* USE_ALLOCATOR_HOOK */
+
+extern int
+onig_set_allocator(const OnigAllocator* allocator)
+{
+#ifdef USE_ALLOCATOR_HOOK
+  /* memory must be freed by the allocator which allocated it */
+  if (onig_inited)
+    return ONIGERR_INVALID_ARGUMENT;
+
+  if (IS_NULL(allocator)) {
+    Allocator.malloc_func  = default_malloc;
+    Allocator.realloc_func = default_realloc;
+    Allocator.free_func    = default_free;
+    Allocator.context      = (void* )NULL;
+    return ONIG_NORMAL;
+  }
+  if (IS_NULL(allocator->malloc_func) || IS_NULL(allocator->realloc_func) ||
+      IS_NULL(allocator->free_func))
+    return ONIGERR_INVALID_ARGUMENT;
+
+  Allocator = *allocator;
+  return ONIG_NORMAL;
+#else
+  return ONIG_NO_SUPPORT_CONFIG;
+#endif
+}
+
+static int
+enc_kind(OnigEncoding enc)
+{
+  if (ONIGENC_MBC_MAXLEN(enc) == 1 &&
+      enc->is_mbc_newline == onigenc_is_mbc_newline_0x0a &&
+      enc->mbc_to_code == onigenc_single_byte_mbc_to_code)
+    return ENC_KIND_SINGLE_BYTE;
+#ifndef RUBY
+  if (enc == ONIG_ENCODING_UTF8)
+    return ENC_KIND_UTF8;
+  if (enc == ONIG_ENCODING_UTF16_LE)
+    return ENC_KIND_UTF16LE;
+#endif
+  return ENC_KIND_GENERIC;
+}
+
 extern int
 onig_reg_init(regex_t* reg, OnigOptionType option,
 	      OnigCaseFoldType case_fold_flag,
@@ -5825,9 +6885,11 @@ onig_reg_init(regex_t* reg, OnigOptionType option,
     return ONIGERR_INVALID_ARGUMENT;
 
   (reg)->exact            = (UChar* )NULL;
+  (reg)->map              = (UChar* )NULL;
   (reg)->chain            = (regex_t* )NULL;
   (reg)->p                = (UChar* )NULL;
   (reg)->name_table       = (void* )NULL;
+  (reg)->named_groups     = (OnigNamedGroup* )NULL;
   (reg)->repeat_range     = (OnigRepeatRange* )NULL;
 
   if (ONIGENC_IS_UNDEF(enc))
@@ -5845,6 +6907,9 @@ onig_reg_init(regex_t* reg, OnigOptionType option,
   else
     option |= syntax->options;
 
+  if ((option & ONIG_OPTION_LEFTMOST_LONGEST) != 0)
+    option |= ONIG_OPTION_FIND_LONGEST;
+
   (reg)->enc              = enc;
   (reg)->options          = option;
   (reg)->syntax           = syntax;
@@ -5854,6 +6919,7 @@ onig_reg_init(regex_t* reg, OnigOptionType option,
   (reg)->used             = 0;
 
   (reg)->case_fold_flag   = case_fold_flag;
+  (reg)->enc_kind         = enc_kind(enc);
   return 0;
 }
 
@@ -5893,6 +6959,33 @@ onig_new(regex_t** reg, const UChar* pattern, const UChar* pattern_end,
   return r;
 }
 
+extern int
+onig_new_append(regex_t** reg, regex_t* prev,
+		const UChar* pattern, const UChar* pattern_end,
+		const UChar* str, const UChar* end, OnigErrorInfo* einfo)
+{
+  int r;
+
+  if (IS_NOT_NULL(einfo)) einfo->par = (UChar* )NULL;
+  if (IS_NULL(prev) || IS_NULL(str) || end < str)
+    return ONIGERR_INVALID_ARGUMENT;
+
+  *reg = (regex_t* )xmalloc(sizeof(regex_t));
+  if (IS_NULL(*reg)) return ONIGERR_MEMORY;
+
+  r = onig_reg_init(*reg, prev->options, prev->case_fold_flag, prev->enc,
+		    prev->syntax);
+  if (r) goto err;
+
+  r = compile_regex(*reg, pattern, pattern_end, str, end, einfo, NULL, 0);
+  if (r) {
+  err:
+    onig_free(*reg);
+    *reg = NULL;
+  }
+  return r;
+}
+
 extern int
 onig_initialize(OnigEncoding encodings[] ARG_UNUSED, int n ARG_UNUSED)
 {
@@ -5957,6 +7050,7 @@ extern int
 onig_end(void)
 {
   exec_end_call_list();
+  onig_trim_match_stack_pool();
 
 #ifdef ONIG_DEBUG_STATISTICS
   onig_print_statistics(stderr);
@@ -6059,6 +7153,7 @@ OnigOpInfoType OnigOpInfo[] = {
   { OP_EXACTMBN,          "exactmbn",        ARG_SPECIAL },
   { OP_EXACT1_IC,         "exact1-ic",       ARG_SPECIAL },
   { OP_EXACTN_IC,         "exactn-ic",       ARG_SPECIAL },
+  { OP_EXACTN_FOLD,       "exactn-fold",     ARG_SPECIAL },
   { OP_CCLASS,            "cclass",          ARG_SPECIAL },
   { OP_CCLASS_MB,         "cclass-mb",       ARG_SPECIAL },
   { OP_CCLASS_MIX,        "cclass-mix",      ARG_SPECIAL },
@@ -6071,6 +7166,8 @@ OnigOpInfoType OnigOpInfo[] = {
   { OP_ANYCHAR_ML_STAR,   "anychar-ml*",     ARG_NON },
   { OP_ANYCHAR_STAR_PEEK_NEXT, "anychar*-peek-next", ARG_SPECIAL },
   { OP_ANYCHAR_ML_STAR_PEEK_NEXT, "anychar-ml*-peek-next", ARG_SPECIAL },
+  { OP_LINEBREAK,         "linebreak",       ARG_NON },
+  { OP_GRAPHEME_CLUSTER,  "grapheme-cluster", ARG_NON },
   { OP_WORD,                "word",            ARG_NON },
   { OP_NOT_WORD,            "not-word",        ARG_NON },
   { OP_WORD_BOUND,          "word-bound",      ARG_NON },
@@ -6111,6 +7208,10 @@ OnigOpInfoType OnigOpInfo[] = {
   { OP_POP,                 "pop",                  ARG_NON },
   { OP_PUSH_OR_JUMP_EXACT1, "push-or-jump-e1",      ARG_SPECIAL },
   { OP_PUSH_IF_PEEK_NEXT,   "push-if-peek-next",    ARG_SPECIAL },
+  { OP_PUSH_SPAN,           "push-span",            ARG_RELADDR },
+  { OP_PUSH_SPAN_IF_PEEK_NEXT, "push-span-if-peek-next", ARG_SPECIAL },
+  { OP_ALT_DISPATCH,        "alt-dispatch",         ARG_SPECIAL },
+  { OP_ALT_DISPATCH_NEXT,   "alt-dispatch-next",    ARG_SPECIAL },
   { OP_REPEAT,              "repeat",               ARG_SPECIAL },
   { OP_REPEAT_NG,           "repeat-ng",            ARG_SPECIAL },
   { OP_REPEAT_INC,          "repeat-inc",           ARG_MEMNUM  },
@@ -6130,9 +7231,14 @@ OnigOpInfoType OnigOpInfo[] = {
   { OP_LOOK_BEHIND,          "look-behind",          ARG_SPECIAL },
   { OP_PUSH_LOOK_BEHIND_NOT, "push-look-behind-not", ARG_SPECIAL },
   { OP_FAIL_LOOK_BEHIND_NOT, "fail-look-behind-not", ARG_NON },
+  { OP_LOOK_BEHIND_VAR,      "look-behind-var",      ARG_SPECIAL },
+  { OP_LOOK_BEHIND_VAR_END,  "look-behind-var-end",  ARG_NON },
+  { OP_PUSH_LOOK_BEHIND_NOT_VAR, "push-look-behind-not-var", ARG_SPECIAL },
+  { OP_FAIL_LOOK_BEHIND_NOT_VAR, "fail-look-behind-not-var", ARG_NON },
   { OP_PUSH_ABSENT_POS,      "push-absent-pos",      ARG_NON },
   { OP_ABSENT,               "absent",               ARG_RELADDR },
   { OP_ABSENT_END,           "absent-end",           ARG_NON },
+  { OP_ABSENT_EXACT,         "absent-exact",         ARG_SPECIAL },
   { OP_CALL,                 "call",                 ARG_ABSADDR },
   { OP_RETURN,               "return",               ARG_NON },
   { OP_CONDITION,            "condition",            ARG_SPECIAL },
@@ -6260,6 +7366,7 @@ onig_print_compiled_byte_code(FILE* f, UChar* bp, UChar* bpend, UChar** nextp,
     case OP_EXACT5:
       p_string(f, 5, bp); bp += 5; break;
     case OP_EXACTN:
+    case OP_ABSENT_EXACT:
       GET_LENGTH_INC(len, bp);
       p_len_string(f, len, 1, bp);
       bp += len;
@@ -6303,6 +7410,25 @@ onig_print_compiled_byte_code(FILE* f, UChar* bp, UChar* bpend, UChar** nextp,
       p_len_string(f, len, 1, bp);
       bp += len;
       break;
+    case OP_EXACTN_FOLD:
+      {
+	UChar *tend;
+
+	GET_LENGTH_INC(len, bp);
+	tend = bp + len;
+	fputc(':', f);
+	while (bp < tend) {
+	  n = *bp++;
+	  fputc('[', f);
+	  while (n-- > 0) {
+	    len = *bp++;
+	    while (len-- > 0) { fputc(*bp++, f); }
+	    if (n > 0) fputc('|', f);
+	  }
+	  fputc(']', f);
+	}
+      }
+      break;
 
     case OP_CCLASS:
       n = bitset_on_num((BitSetRef )bp);
@@ -6392,6 +7518,7 @@ onig_print_compiled_byte_code(FILE* f, UChar* bp, UChar* bpend, UChar** nextp,
 
     case OP_PUSH_OR_JUMP_EXACT1:
     case OP_PUSH_IF_PEEK_NEXT:
+    case OP_PUSH_SPAN_IF_PEEK_NEXT:
       addr = *((RelAddrType* )bp);
       bp += SIZE_RELADDR;
       fprintf(f, ":(%s%d)", (addr >= 0) ? "+" : "", addr);
@@ -6399,6 +7526,18 @@ onig_print_compiled_byte_code(FILE* f, UChar* bp, UChar* bpend, UChar** nextp,
       bp += 1;
       break;
 
+    case OP_ALT_DISPATCH:
+      GET_LENGTH_INC(len, bp);
+      fprintf(f, ":%d", len);
+      bp += SIZE_RELADDR * len + ALT_DISPATCH_ROWS * ALT_DISPATCH_ROW_SIZE(len);
+      break;
+
+    case OP_ALT_DISPATCH_NEXT:
+      GET_RELADDR_INC(addr, bp);
+      GET_LENGTH_INC(len, bp);
+      fprintf(f, ":%d:(%s%d)", len, (addr >= 0) ? "+" : "", addr);
+      break;
+
     case OP_LOOK_BEHIND:
       GET_LENGTH_INC(len, bp);
       fprintf(f, ":%d", len);
@@ -6410,6 +7549,19 @@ onig_print_compiled_byte_code(FILE* f, UChar* bp, UChar* bpend, UChar** nextp,
       fprintf(f, ":%d:(%s%d)", len, (addr >= 0) ? "+" : "", addr);
       break;
 
+    case OP_LOOK_BEHIND_VAR:
+      GET_LENGTH_INC(len, bp);
+      GET_LENGTH_INC(n, bp);
+      fprintf(f, ":%d-%d", len, n);
+      break;
+
+    case OP_PUSH_LOOK_BEHIND_NOT_VAR:
+      GET_RELADDR_INC(addr, bp);
+      GET_LENGTH_INC(len, bp);
+      GET_LENGTH_INC(n, bp);
+      fprintf(f, ":%d-%d:(%s%d)", len, n, (addr >= 0) ? "+" : "", addr);
+      break;
+
     case OP_STATE_CHECK_PUSH:
     case OP_STATE_CHECK_PUSH_OR_JUMP:
       scn = *((StateCheckNumType* )bp);
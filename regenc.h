@@ -183,6 +183,26 @@ ONIG_EXTERN int onigenc_unicode_ctype_code_range(int ctype, const OnigCodePoint*
 ONIG_EXTERN int onigenc_unicode_get_case_fold_codes_by_str(OnigEncoding enc, OnigCaseFoldType flag, const OnigUChar* p, const OnigUChar* end, OnigCaseFoldCodeItem items[]);
 ONIG_EXTERN int onigenc_unicode_mbc_case_fold(OnigEncoding enc, OnigCaseFoldType flag, const UChar** pp, const UChar* end, UChar* fold);
 ONIG_EXTERN int onigenc_unicode_apply_all_case_fold(OnigCaseFoldType flag, OnigApplyAllCaseFoldFunc f, void* arg, OnigEncoding enc);
+ONIG_EXTERN int onigenc_unicode_grapheme_cluster_break(OnigCodePoint code);
+
+/* Grapheme_Cluster_Break values (UAX #29) for \X */
+#define ONIGENC_GCB_OTHER                   0
+#define ONIGENC_GCB_CR                      1
+#define ONIGENC_GCB_LF                      2
+#define ONIGENC_GCB_CONTROL                 3
+#define ONIGENC_GCB_EXTEND                  4
+#define ONIGENC_GCB_ZWJ                     5
+#define ONIGENC_GCB_REGIONAL_INDICATOR      6
+#define ONIGENC_GCB_PREPEND                 7
+#define ONIGENC_GCB_SPACINGMARK             8
+#define ONIGENC_GCB_L                       9
+#define ONIGENC_GCB_V                      10
+#define ONIGENC_GCB_T                      11
+#define ONIGENC_GCB_LV                     12
+#define ONIGENC_GCB_LVT                    13
+#define ONIGENC_GCB_MASK                   0x0f
+/* not a Grapheme_Cluster_Break value, but used by the same rules */
+#define ONIGENC_GCB_EXTENDED_PICTOGRAPHIC  0x10
 
 
 #define UTF16_IS_SURROGATE_FIRST(c)    (((c) & 0xfc) == 0xd8)
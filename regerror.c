@@ -61,6 +61,8 @@ onig_error_code_to_format(OnigPosition code)
     p = "match-stack limit over"; break;
   case ONIGERR_PARSE_DEPTH_LIMIT_OVER:
     p = "parse depth limit over"; break;
+  case ONIGERR_SUBEXP_CALL_DEPTH_LIMIT_OVER:
+    p = "subexp call depth limit over"; break;
   case ONIGERR_DEFAULT_ENCODING_IS_NOT_SET:
     p = "default multibyte-encoding is not set"; break;
 #if 0
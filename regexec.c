@@ -28,7 +28,17 @@
  * SUCH DAMAGE.
  */
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE  /* for memrchr() */
+#endif
 #include "regint.h"
+#ifdef USE_MATCH_STACK_POOL
+# ifdef _WIN32
+#  include <windows.h>
+# else
+#  include <pthread.h>
+# endif
+#endif
 
 #ifdef RUBY
 # undef USE_MATCH_RANGE_MUST_BE_INSIDE_OF_SPECIFIED_RANGE
@@ -100,6 +110,90 @@ is_mbc_newline_ex(OnigEncoding enc, const UChar *p, const UChar *start,
   ONIGENC_IS_MBC_NEWLINE((enc), (p), (end))
 #endif /* USE_CRNL_AS_LINE_TERMINATOR */
 
+/* Newlines can be found by memchr() when LF is the only newline and
+   never a byte of a multibyte char, as in ASCII compatible encodings. */
+#ifdef USE_UNICODE_ALL_LINE_TERMINATORS
+# define IS_NEWLINE_LF_BYTE(reg)  0
+#else
+# define IS_NEWLINE_LF_BYTE(reg) \
+  (ONIGENC_MBC_MINLEN((reg)->enc) == 1 && !IS_NEWLINE_CRLF((reg)->options))
+#endif
+
+/* Encoding primitives with the common cases of the encoding kind chosen
+   at compile time (reg->enc_kind) done inline; anything else goes through
+   the encoding's function table. */
+static inline int
+enc_kind_len(int kind, OnigEncoding enc, const UChar* p, const UChar* end)
+{
+  switch (kind) {
+  case ENC_KIND_SINGLE_BYTE:
+    return 1;
+  case ENC_KIND_UTF8:
+    if (*p < 0x80) return 1;
+    break;
+  case ENC_KIND_UTF16LE:
+    if (end - p >= 2 && ! UTF16_IS_SURROGATE(p[1])) return 2;
+    break;
+  }
+  return enclen(enc, p, end);
+}
+
+static inline OnigCodePoint
+enc_kind_mbc_to_code(int kind, OnigEncoding enc, const UChar* p,
+		     const UChar* end)
+{
+  switch (kind) {
+  case ENC_KIND_SINGLE_BYTE:
+    return (OnigCodePoint )*p;
+  case ENC_KIND_UTF8:
+    if (*p < 0x80) return (OnigCodePoint )*p;
+    break;
+  case ENC_KIND_UTF16LE:
+    if (! UTF16_IS_SURROGATE_FIRST(p[1]))
+      return (OnigCodePoint )(p[1] * 256 + p[0]);
+    break;
+  }
+  return ONIGENC_MBC_TO_CODE(enc, p, end);
+}
+
+static inline int
+enc_kind_is_newline(int kind, OnigEncoding enc, const UChar* p,
+		    const UChar* end)
+{
+  switch (kind) {
+  case ENC_KIND_SINGLE_BYTE:
+    return p < end && *p == 0x0a;
+#ifndef USE_UNICODE_ALL_LINE_TERMINATORS
+  case ENC_KIND_UTF8:
+    return p < end && *p == 0x0a;
+  case ENC_KIND_UTF16LE:
+    return p + 1 < end && p[0] == 0x0a && p[1] == 0x00;
+#endif
+  }
+  return ONIGENC_IS_MBC_NEWLINE(enc, p, end);
+}
+
+#ifdef USE_CRNL_AS_LINE_TERMINATOR
+# define ENC_KIND_IS_NEWLINE_EX(kind,enc,p,start,end,option,check_prev) \
+  (IS_NEWLINE_CRLF(option) ? \
+   is_mbc_newline_ex((enc),(p),(start),(end),(option),(check_prev)) : \
+   enc_kind_is_newline((kind),(enc),(p),(end)))
+#else
+# define ENC_KIND_IS_NEWLINE_EX(kind,enc,p,start,end,option,check_prev) \
+  enc_kind_is_newline((kind),(enc),(p),(end))
+#endif
+
+/* the same inside match_at() */
+#define EXEC_ENCLEN(p,e)          enc_kind_len(enc_kind, encode, p, e)
+#define EXEC_MBC_TO_CODE(p,e)     enc_kind_mbc_to_code(enc_kind, encode, p, e)
+#define EXEC_IS_NEWLINE(p,check_prev) \
+  ((void )EXEC_CR_AT_EDGE(p), \
+   ENC_KIND_IS_NEWLINE_EX(enc_kind, encode, (p), str, end, option, (check_prev)))
+/* a CR at the end of a part may be the start of a CRLF */
+#define EXEC_CR_AT_EDGE(p) \
+  (IS_NEWLINE_CRLF(option) && (p) + EXEC_ENCLEN(p, end) == end && \
+   EXEC_MBC_TO_CODE(p, end) == 0x0d && MARK_EDGE(end))
+
 #ifdef USE_CAPTURE_HISTORY
 static void history_tree_free(OnigCaptureTreeNode* node);
 
@@ -390,6 +484,9 @@ onig_region_copy(OnigRegion* to, const OnigRegion* from)
 #define STK_ALT                    0x0001
 #define STK_LOOK_BEHIND_NOT        0x0002
 #define STK_POS_NOT                0x0003
+#define STK_SPAN                   0x0004  /* run of loop exit points */
+#define STK_SPAN_PEEK              0x0005  /* same, filtered by next byte */
+#define STK_SPAN_PEEK_LOOP         0x0006  /* same, of OP_PUSH_SPAN_IF_PEEK_NEXT */
 /* handled by normal-POP */
 #define STK_MEM_START              0x0100
 #define STK_MEM_END                0x8200
@@ -414,21 +511,27 @@ onig_region_copy(OnigRegion* to, const OnigRegion* from)
 #define STK_MASK_MEM_END_OR_MARK   0x8000  /* MEM_END or MEM_END_MARK */
 
 #ifdef USE_FIND_LONGEST_SEARCH_ALL_OF_RANGE
-# define MATCH_ARG_INIT(msa, arg_option, arg_region, arg_start, arg_gpos) do {\
+# define MATCH_ARG_INIT(msa, arg_option, arg_region, arg_start, arg_gpos, arg_scratch) do {\
   (msa).stack_p  = (void* )0;\
+  (msa).scratch  = (arg_scratch);\
   (msa).options  = (arg_option);\
   (msa).region   = (arg_region);\
   (msa).start    = (arg_start);\
   (msa).gpos     = (arg_gpos);\
+  (msa).edge_end = NULL;\
+  (msa).edge     = 0;\
   (msa).best_len = ONIG_MISMATCH;\
 } while(0)
 #else
-# define MATCH_ARG_INIT(msa, arg_option, arg_region, arg_start, arg_gpos) do {\
+# define MATCH_ARG_INIT(msa, arg_option, arg_region, arg_start, arg_gpos, arg_scratch) do {\
   (msa).stack_p  = (void* )0;\
+  (msa).scratch  = (arg_scratch);\
   (msa).options  = (arg_option);\
   (msa).region   = (arg_region);\
   (msa).start    = (arg_start);\
   (msa).gpos     = (arg_gpos);\
+  (msa).edge_end = NULL;\
+  (msa).edge     = 0;\
 } while(0)
 #endif
 
@@ -463,21 +566,229 @@ onig_region_copy(OnigRegion* to, const OnigRegion* from)
   } while(0)
 
 # define MATCH_ARG_FREE(msa) do {\
-  if ((msa).stack_p) xfree((msa).stack_p);\
+  if ((msa).stack_p) match_stack_put(&(msa));\
   if ((msa).state_check_buff_size >= STATE_CHECK_BUFF_MALLOC_THRESHOLD_SIZE) { \
     if ((msa).state_check_buff) xfree((msa).state_check_buff);\
   }\
 } while(0)
 #else /* USE_COMBINATION_EXPLOSION_CHECK */
-# define MATCH_ARG_FREE(msa)  if ((msa).stack_p) xfree((msa).stack_p)
+# define MATCH_ARG_FREE(msa) do {\
+  if ((msa).stack_p) match_stack_put(&(msa));\
+} while(0)
 #endif /* USE_COMBINATION_EXPLOSION_CHECK */
 
+static unsigned int MatchStackLimitSize = DEFAULT_MATCH_STACK_LIMIT_SIZE;
+static unsigned int SubexpCallDepthLimit = DEFAULT_SUBEXP_CALL_DEPTH_LIMIT;
+
+/* The heap allocated match stack is kept per thread after a search and
+   reused by the next one, so that deep patterns don't grow it again from
+   INIT_MATCH_STACK_SIZE on every call. */
+#ifdef USE_MATCH_STACK_POOL
+static unsigned int MatchStackPoolLimitSize = DEFAULT_MATCH_STACK_POOL_LIMIT_SIZE;
+static ONIG_THREAD_LOCAL OnigStackType* MatchStackPool;
+static ONIG_THREAD_LOCAL size_t MatchStackPoolN;
+static ONIG_THREAD_LOCAL int MatchStackPoolHasDtor;
+
+/* The pool of a thread is freed by a destructor when the thread exits. */
+# ifdef _WIN32
+static INIT_ONCE MatchStackPoolOnce = INIT_ONCE_STATIC_INIT;
+static DWORD MatchStackPoolKey = FLS_OUT_OF_INDEXES;
+
+static void WINAPI
+stack_pool_free_at_exit(void* arg ARG_UNUSED)
+{
+  onig_trim_match_stack_pool();
+}
+
+static BOOL CALLBACK
+stack_pool_key_create(PINIT_ONCE once ARG_UNUSED, void* arg ARG_UNUSED,
+		      void** ctx ARG_UNUSED)
+{
+  MatchStackPoolKey = FlsAlloc(stack_pool_free_at_exit);
+  return TRUE;
+}
+
+static int
+stack_pool_set_dtor(void)
+{
+  InitOnceExecuteOnce(&MatchStackPoolOnce, stack_pool_key_create, NULL, NULL);
+  if (MatchStackPoolKey == FLS_OUT_OF_INDEXES) return -1;
+  return FlsSetValue(MatchStackPoolKey, &MatchStackPoolN) ? 0 : -1;
+}
+# else
+static pthread_once_t MatchStackPoolOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t MatchStackPoolKey;
+static int MatchStackPoolKeyError;
+
+static void
+stack_pool_free_at_exit(void* arg ARG_UNUSED)
+{
+  onig_trim_match_stack_pool();
+}
+
+static void
+stack_pool_key_create(void)
+{
+  MatchStackPoolKeyError =
+    pthread_key_create(&MatchStackPoolKey, stack_pool_free_at_exit);
+}
+
+static int
+stack_pool_set_dtor(void)
+{
+  pthread_once(&MatchStackPoolOnce, stack_pool_key_create);
+  if (MatchStackPoolKeyError != 0) return -1;
+  return pthread_setspecific(MatchStackPoolKey, &MatchStackPoolN);
+}
+# endif
+
+# define STACK_POOL_GET(msa) do {\
+  if (IS_NULL((msa)->stack_p) && IS_NOT_NULL(MatchStackPool) &&\
+      (MatchStackLimitSize == 0 || MatchStackPoolN <= MatchStackLimitSize)) {\
+    (msa)->stack_p = MatchStackPool;\
+    (msa)->stack_n = MatchStackPoolN;\
+    MatchStackPool = (OnigStackType* )NULL;\
+  }\
+} while(0)
+
+# define STACK_POOL_PUT(stack_p, stack_n)  stack_pool_put(stack_p, stack_n)
+
+static void
+stack_pool_put(void* stack_p, size_t stack_n)
+{
+  if (stack_n <= MatchStackPoolLimitSize) {
+    if (IS_NULL(MatchStackPool)) {
+      if (MatchStackPoolHasDtor == 0) {
+	if (stack_pool_set_dtor() != 0) goto end;
+	MatchStackPoolHasDtor = 1;
+      }
+      MatchStackPool  = (OnigStackType* )stack_p;
+      MatchStackPoolN = stack_n;
+      return ;
+    }
+    else if (MatchStackPoolN < stack_n) {  /* keep the larger one */
+      xfree(MatchStackPool);
+      MatchStackPool  = (OnigStackType* )stack_p;
+      MatchStackPoolN = stack_n;
+      return ;
+    }
+  }
+ end:
+  xfree(stack_p);
+}
+#else
+# define STACK_POOL_GET(msa)
+# define STACK_POOL_PUT(stack_p, stack_n)  xfree(stack_p)
+#endif /* USE_MATCH_STACK_POOL */
+
+/* A search given an OnigMatchScratch takes the stack kept in it, and puts
+   the stack back there instead of into the pool. */
+#define STACK_SCRATCH_GET(msa) do {\
+  OnigMatchScratch* scratch_ = (msa)->scratch;\
+  if (IS_NOT_NULL(scratch_) && IS_NOT_NULL(scratch_->stack_p) &&\
+      (MatchStackLimitSize == 0 || scratch_->stack_n <= MatchStackLimitSize)) {\
+    (msa)->stack_p = scratch_->stack_p;\
+    (msa)->stack_n = scratch_->stack_n;\
+    scratch_->stack_p = NULL;\
+  }\
+} while(0)
+
+static void
+match_stack_put(OnigMatchArg* msa)
+{
+  OnigMatchScratch* scratch = msa->scratch;
+
+  if (IS_NULL(scratch)) {
+    STACK_POOL_PUT(msa->stack_p, msa->stack_n);
+  }
+  else if (IS_NULL(scratch->stack_p) || scratch->stack_n < msa->stack_n) {
+    if (IS_NOT_NULL(scratch->stack_p)) xfree(scratch->stack_p);
+    scratch->stack_p = msa->stack_p;
+    scratch->stack_n = msa->stack_n;
+  }
+  else
+    xfree(msa->stack_p);
+}
+
+extern OnigMatchScratch*
+onig_match_scratch_new(void)
+{
+  UChar* base;
+  OnigMatchScratch* scratch;
+  size_t size;
+
+  /* Nothing else may be in the cache lines of the scratch, which is
+     written by every search. */
+  size = (sizeof(OnigMatchScratch) + CACHE_LINE_SIZE - 1)
+	   / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  base = (UChar* )xmalloc(size + CACHE_LINE_SIZE - 1);
+  if (IS_NULL(base)) return NULL;
+
+  scratch = (OnigMatchScratch* )(base + (CACHE_LINE_SIZE -
+	      (uintptr_t )base % CACHE_LINE_SIZE) % CACHE_LINE_SIZE);
+  scratch->base    = base;
+  scratch->stack_p = NULL;
+  scratch->stack_n = 0;
+  return scratch;
+}
+
+extern void
+onig_match_scratch_free(OnigMatchScratch* scratch)
+{
+  if (IS_NULL(scratch)) return ;
+
+  if (IS_NOT_NULL(scratch->stack_p)) xfree(scratch->stack_p);
+  xfree(scratch->base);
+}
+
+extern unsigned int
+onig_get_match_stack_pool_limit_size(void)
+{
+#ifdef USE_MATCH_STACK_POOL
+  return MatchStackPoolLimitSize;
+#else
+  return 0;
+#endif
+}
+
+extern int
+onig_set_match_stack_pool_limit_size(unsigned int size)
+{
+#ifdef USE_MATCH_STACK_POOL
+  MatchStackPoolLimitSize = size;
+  if (IS_NOT_NULL(MatchStackPool) && MatchStackPoolN > size)
+    onig_trim_match_stack_pool();
+  return 0;
+#else
+  return ONIG_NO_SUPPORT_CONFIG;
+#endif
+}
+
+extern void
+onig_trim_match_stack_pool(void)
+{
+#ifdef USE_MATCH_STACK_POOL
+  if (IS_NOT_NULL(MatchStackPool)) {
+    xfree(MatchStackPool);
+    MatchStackPool  = (OnigStackType* )NULL;
+    MatchStackPoolN = 0;
+  }
+#endif
+}
+
 
 
 #define MAX_PTR_NUM 100
 
 #define STACK_INIT(alloc_addr, heap_addr, ptr_num, stack_num)  do {\
-  if (ptr_num > MAX_PTR_NUM) {\
+  STACK_SCRATCH_GET(msa);\
+  STACK_POOL_GET(msa);\
+  if (OnigBoundedNativeStack && IS_NULL(msa->stack_p)) {\
+    msa->stack_p = xmalloc(sizeof(OnigStackType) * (stack_num));\
+    CHECK_NULL_RETURN_MEMERR(msa->stack_p);\
+    msa->stack_n = (stack_num);\
+  }\
+  if (ptr_num > MAX_PTR_NUM || OnigBoundedNativeStack) {\
     alloc_addr = (char* )xmalloc(sizeof(OnigStackIndex) * (ptr_num));\
     heap_addr  = alloc_addr;\
     if (msa->stack_p) {\
@@ -517,8 +828,6 @@ onig_region_copy(OnigRegion* to, const OnigRegion* from)
   };\
 } while(0)
 
-static unsigned int MatchStackLimitSize = DEFAULT_MATCH_STACK_LIMIT_SIZE;
-
 extern unsigned int
 onig_get_match_stack_limit_size(void)
 {
@@ -532,6 +841,19 @@ onig_set_match_stack_limit_size(unsigned int size)
   return 0;
 }
 
+extern unsigned int
+onig_get_subexp_call_depth_limit(void)
+{
+  return SubexpCallDepthLimit;
+}
+
+extern int
+onig_set_subexp_call_depth_limit(unsigned int depth)
+{
+  SubexpCallDepthLimit = depth;
+  return 0;
+}
+
 static int
 stack_double(OnigStackType** arg_stk_base, OnigStackType** arg_stk_end,
 	     OnigStackType** arg_stk, OnigStackType* stk_alloc, OnigMatchArg* msa)
@@ -677,6 +999,10 @@ stack_double(OnigStackType** arg_stk_base, OnigStackType** arg_stk_end,
 #define STACK_PUSH_ALT(pat,s,sprev,keep)     STACK_PUSH(STK_ALT,pat,s,sprev,keep)
 #define STACK_PUSH_POS(s,sprev,keep)         STACK_PUSH(STK_POS,NULL_UCHARP,s,sprev,keep)
 #define STACK_PUSH_POS_NOT(pat,s,sprev,keep) STACK_PUSH(STK_POS_NOT,pat,s,sprev,keep)
+#define STACK_PUSH_SPAN(pat,s,low,keep)      STACK_PUSH(STK_SPAN,pat,s,low,keep)
+#define STACK_PUSH_SPAN_PEEK(pat,s,low,keep) STACK_PUSH(STK_SPAN_PEEK,pat,s,low,keep)
+#define STACK_PUSH_SPAN_PEEK_LOOP(pat,s,low,keep) \
+  STACK_PUSH(STK_SPAN_PEEK_LOOP,pat,s,low,keep)
 #define STACK_PUSH_ABSENT                    STACK_PUSH_TYPE(STK_ABSENT)
 #define STACK_PUSH_STOP_BT                   STACK_PUSH_TYPE(STK_STOP_BT)
 #define STACK_PUSH_LOOK_BEHIND_NOT(pat,s,sprev,keep) \
@@ -744,6 +1070,15 @@ stack_double(OnigStackType** arg_stk_base, OnigStackType** arg_stk_end,
   }\
 } while(0)
 
+/* A called group pushes its MEM_START right after the call frame. */
+#define STACK_GET_REC_MEM_START(mnum, k) do {\
+  if (call_top != INVALID_STACK_INDEX &&\
+      (k = STACK_AT(call_top) + 1)->type == STK_MEM_START &&\
+      k->u.mem.num == (mnum)) ;\
+  else\
+    STACK_GET_MEM_START(mnum, k);\
+} while(0)
+
 #define STACK_GET_MEM_RANGE(k, mnum, start, end) do {\
   int level = 0;\
   while (k < stk) {\
@@ -777,19 +1112,39 @@ stack_double(OnigStackType** arg_stk_base, OnigStackType** arg_stk_end,
   STACK_INC;\
 } while(0)
 
-#define STACK_PUSH_CALL_FRAME(pat) do {\
+/* call_top is the innermost open call frame.  Each frame links to the
+   caller's one, and a STK_RETURN entry keeps the frame it closed, so that
+   popping either of them restores call_top. */
+#define CALL_LEVEL  (call_top == INVALID_STACK_INDEX ? 0 :\
+		     STACK_AT(call_top)->u.call_frame.level)
+
+#define STACK_PUSH_CALL_FRAME(pat,lv) do {\
   STACK_ENSURE(1);\
   stk->type = STK_CALL_FRAME;\
   stk->u.call_frame.ret_addr = (pat);\
+  stk->u.call_frame.level    = (lv);\
+  stk->u.call_frame.prev     = call_top;\
+  call_top = GET_STACK_INDEX(stk);\
   STACK_INC;\
 } while(0)
 
 #define STACK_PUSH_RETURN do {\
   STACK_ENSURE(1);\
   stk->type = STK_RETURN;\
+  stk->u.call_frame.prev = call_top;\
+  call_top = STACK_AT(call_top)->u.call_frame.prev;\
   STACK_INC;\
 } while(0)
 
+#ifdef USE_SUBEXP_CALL
+# define ELSE_IF_CALL_FRAME(stk) \
+  else if ((stk)->type == STK_CALL_FRAME || (stk)->type == STK_RETURN) {\
+    call_top = (stk)->u.call_frame.prev;\
+  }
+#else
+# define ELSE_IF_CALL_FRAME(stk)
+#endif
+
 #define STACK_PUSH_ABSENT_POS(start, end) do {\
   STACK_ENSURE(1);\
   stk->type = STK_ABSENT_POS;\
@@ -852,6 +1207,7 @@ stack_double(OnigStackType** arg_stk_base, OnigStackType** arg_stk_end,
         mem_start_stk[stk->u.mem.num] = stk->u.mem.start;\
         mem_end_stk[stk->u.mem.num]   = stk->u.mem.end;\
       }\
+      ELSE_IF_CALL_FRAME(stk)\
       ELSE_IF_STATE_CHECK_MARK(stk);\
     }\
     break;\
@@ -874,6 +1230,7 @@ stack_double(OnigStackType** arg_stk_base, OnigStackType** arg_stk_end,
       mem_start_stk[stk->u.mem.num] = stk->u.mem.start;\
       mem_end_stk[stk->u.mem.num]   = stk->u.mem.end;\
     }\
+    ELSE_IF_CALL_FRAME(stk)\
     ELSE_IF_STATE_CHECK_MARK(stk);\
   }\
 } while(0)
@@ -894,6 +1251,7 @@ stack_double(OnigStackType** arg_stk_base, OnigStackType** arg_stk_end,
       mem_start_stk[stk->u.mem.num] = stk->u.mem.start;\
       mem_end_stk[stk->u.mem.num]   = stk->u.mem.end;\
     }\
+    ELSE_IF_CALL_FRAME(stk)\
     ELSE_IF_STATE_CHECK_MARK(stk);\
   }\
 } while(0)
@@ -914,6 +1272,7 @@ stack_double(OnigStackType** arg_stk_base, OnigStackType** arg_stk_end,
       mem_start_stk[stk->u.mem.num] = stk->u.mem.start;\
       mem_end_stk[stk->u.mem.num]   = stk->u.mem.end;\
     }\
+    ELSE_IF_CALL_FRAME(stk)\
     ELSE_IF_STATE_CHECK_MARK(stk);\
   }\
 } while(0)
@@ -1095,36 +1454,46 @@ stack_double(OnigStackType** arg_stk_base, OnigStackType** arg_stk_end,
   }\
 } while(0)
 
-#define STACK_RETURN(addr)  do {\
-  int level = 0;\
-  OnigStackType* k = stk;\
-  while (1) {\
-    k--;\
-    STACK_BASE_CHECK(k, "STACK_RETURN"); \
-    if (k->type == STK_CALL_FRAME) {\
-      if (level == 0) {\
-        (addr) = k->u.call_frame.ret_addr;\
-        break;\
-      }\
-      else level--;\
-    }\
-    else if (k->type == STK_RETURN)\
-      level++;\
-  }\
+#define STACK_RETURN(addr) do {\
+  STACK_BASE_CHECK(STACK_AT(call_top), "STACK_RETURN"); \
+  (addr) = STACK_AT(call_top)->u.call_frame.ret_addr;\
 } while(0)
 
 
 #define STRING_CMP(s1,s2,len) do {\
-  while (len-- > 0) {\
-    if (*s1++ != *s2++) goto fail;\
-  }\
+  if (memcmp(s1, s2, len) != 0) goto fail;\
+  s1 += len;\
+  s2 += len;\
 } while(0)
 
 #define STRING_CMP_IC(case_fold_flag,s1,ps2,len,text_end) do {\
-  if (string_cmp_ic(encode, case_fold_flag, s1, ps2, len, text_end) == 0) \
+  if (string_cmp_ic(encode, case_fold_flag, s1, ps2, len, text_end) == 0) {\
+    STRING_CMP_IC_EDGE(*(ps2), len, text_end);\
     goto fail; \
+  }\
+} while(0)
+
+/* A failed case folding comparison of len bytes may have run into
+   text_end: the text it matches can be longer. */
+#define STRING_CMP_IC_EDGE(s,len,text_end) do {\
+  if ((OnigDistance )((text_end) - (s)) <\
+      (OnigDistance )(len) * ONIGENC_MBC_MAXLEN(encode))\
+    (void )MARK_EDGE(text_end);\
 } while(0)
 
+/* Bytes of a word, all ASCII, with 'A'-'Z' turned to lower case. */
+#define WORD_ONES    (~(size_t )0 / 0xff)
+#define WORD_HIGHS   (WORD_ONES * 0x80)
+
+static size_t
+word_ascii_to_lower(size_t w)
+{
+  size_t ge_a = w + WORD_ONES * (0x80 - 'A');
+  size_t gt_z = w + WORD_ONES * (0x80 - 'Z' - 1);
+
+  return w | (((ge_a ^ gt_z) & WORD_HIGHS) >> 2);
+}
+
 static int string_cmp_ic(OnigEncoding enc, int case_fold_flag,
 			 UChar* s1, UChar** ps2, OnigDistance mblen, const UChar* text_end)
 {
@@ -1132,10 +1501,39 @@ static int string_cmp_ic(OnigEncoding enc, int case_fold_flag,
   UChar buf2[ONIGENC_MBC_CASE_FOLD_MAXLEN];
   UChar *p1, *p2, *end1, *s2;
   int len1, len2;
+  int ascii_fold;
+
+  /* In ASCII compatible encodings an ASCII char folds to its ASCII lower
+     case (except I in Turkic folding), so runs of ASCII chars are compared
+     a word at a time without calling the encoding. */
+  ascii_fold = (ONIGENC_MBC_MINLEN(enc) == 1 &&
+		(case_fold_flag & ONIGENC_CASE_FOLD_TURKISH_AZERI) == 0);
 
   s2   = *ps2;
   end1 = s1 + mblen;
   while (s1 < end1) {
+    if (ascii_fold && s2 < text_end && *s1 < 0x80 && *s2 < 0x80) {
+      while (s1 + sizeof(size_t) <= end1 && s2 + sizeof(size_t) <= text_end) {
+	size_t w1, w2;
+
+	xmemcpy(&w1, s1, sizeof(w1));
+	xmemcpy(&w2, s2, sizeof(w2));
+	if (((w1 | w2) & WORD_HIGHS) != 0) break;
+	if (w1 != w2 && word_ascii_to_lower(w1) != word_ascii_to_lower(w2))
+	  return 0;
+	s1 += sizeof(size_t);
+	s2 += sizeof(size_t);
+      }
+      while (s1 < end1 && s2 < text_end && *s1 < 0x80 && *s2 < 0x80) {
+	if (ONIGENC_ASCII_CODE_TO_LOWER_CASE(*s1) !=
+	    ONIGENC_ASCII_CODE_TO_LOWER_CASE(*s2))
+	  return 0;
+	s1++;
+	s2++;
+      }
+      continue;
+    }
+
     len1 = ONIGENC_MBC_CASE_FOLD(enc, case_fold_flag, &s1, text_end, buf1);
     len2 = ONIGENC_MBC_CASE_FOLD(enc, case_fold_flag, &s2, text_end, buf2);
     if (len1 != len2) return 0;
@@ -1153,36 +1551,54 @@ static int string_cmp_ic(OnigEncoding enc, int case_fold_flag,
 }
 
 #define STRING_CMP_VALUE(s1,s2,len,is_fail) do {\
-  is_fail = 0;\
-  while (len-- > 0) {\
-    if (*s1++ != *s2++) {\
-      is_fail = 1; break;\
-    }\
+  if (memcmp(s1, s2, len) != 0)\
+    is_fail = 1;\
+  else {\
+    s1 += len;\
+    s2 += len;\
+    is_fail = 0;\
   }\
 } while(0)
 
+/* The last char head of the backref text [sprev, s), found from its end
+ * instead of walking every char. */
+#define BACKREF_SET_PREV do {\
+  if (s > sprev)\
+    sprev = (UChar* )onigenc_get_prev_char_head(encode, sprev, s, end);\
+} while(0)
+
 #define STRING_CMP_VALUE_IC(case_fold_flag,s1,ps2,len,text_end,is_fail) do {\
-  if (string_cmp_ic(encode, case_fold_flag, s1, ps2, len, text_end) == 0) \
+  if (string_cmp_ic(encode, case_fold_flag, s1, ps2, len, text_end) == 0) {\
+    STRING_CMP_IC_EDGE(*(ps2), len, text_end);\
     is_fail = 1; \
+  }\
   else \
     is_fail = 0; \
 } while(0)
 
 
+/* A match of a part of a longer subject notes when it looks at the end
+   of the part: its result may change with the text after it (see
+   SearchPart). */
+#define MARK_EDGE(e)           ((e) == msa->edge_end && (msa->edge = 1))
+
 #define IS_EMPTY_STR           (str == end)
 #define ON_STR_BEGIN(s)        ((s) == str)
-#define ON_STR_END(s)          ((s) == end)
+#define ON_STR_END(s)          ((s) == end && ((void )MARK_EDGE(end), 1))
 #ifdef USE_MATCH_RANGE_MUST_BE_INSIDE_OF_SPECIFIED_RANGE
-# define DATA_ENSURE_CHECK1    (s < right_range)
-# define DATA_ENSURE_CHECK(n)  (s + (n) <= right_range)
-# define DATA_ENSURE(n)        if (s + (n) > right_range) goto fail
+# define DATA_ENSURE_CHECK1    (s < right_range ||\
+				((void )MARK_EDGE(right_range), 0))
+# define DATA_ENSURE_CHECK(n)  (s + (n) <= right_range ||\
+				((void )MARK_EDGE(right_range), 0))
+# define DATA_END              right_range
 # define ABSENT_END_POS        right_range
 #else
-# define DATA_ENSURE_CHECK1    (s < end)
-# define DATA_ENSURE_CHECK(n)  (s + (n) <= end)
-# define DATA_ENSURE(n)        if (s + (n) > end) goto fail
+# define DATA_ENSURE_CHECK1    (s < end || ((void )MARK_EDGE(end), 0))
+# define DATA_ENSURE_CHECK(n)  (s + (n) <= end || ((void )MARK_EDGE(end), 0))
+# define DATA_END              end
 # define ABSENT_END_POS        end
 #endif /* USE_MATCH_RANGE_MUST_BE_INSIDE_OF_SPECIFIED_RANGE */
+#define DATA_ENSURE(n)         if (! DATA_ENSURE_CHECK(n)) goto fail
 
 
 #ifdef USE_CAPTURE_HISTORY
@@ -1243,6 +1659,10 @@ static int mem_is_in_memp(int mem, int num, UChar* memp)
   return 0;
 }
 
+static UChar* slow_search(OnigEncoding enc, UChar* target, UChar* target_end,
+			  const UChar* text, const UChar* text_end,
+			  UChar* text_range);
+
 static int backref_match_at_nested_level(regex_t* reg,
 	 OnigStackType* top, OnigStackType* stk_base,
 	 int ignore_case, int case_fold_flag,
@@ -1267,19 +1687,22 @@ static int backref_match_at_nested_level(regex_t* reg,
 	if (mem_is_in_memp(k->u.mem.num, mem_num, memp)) {
 	  pstart = k->u.mem.pstr;
 	  if (pend != NULL_UCHARP) {
-	    if (pend - pstart > send - *s) return 0; /* or goto next_mem; */
+	    if (pend - pstart > send - *s) return -1; /* or goto next_mem; */
 	    p  = pstart;
 	    ss = *s;
 
 	    if (ignore_case != 0) {
 	      if (string_cmp_ic(reg->enc, case_fold_flag,
-				pstart, &ss, pend - pstart, send) == 0)
+				pstart, &ss, pend - pstart, send) == 0) {
+		if (send - *s <
+		    (pend - pstart) * ONIGENC_MBC_MAXLEN(reg->enc))
+		  return -1;
 		return 0; /* or goto next_mem; */
+	      }
 	    }
 	    else {
-	      while (p < pend) {
-		if (*p++ != *ss++) return 0; /* or goto next_mem; */
-	      }
+	      if (memcmp(p, ss, pend - p) != 0) return 0; /* or goto next_mem; */
+	      ss += pend - p;
 	    }
 
 	    *s = ss;
@@ -1393,97 +1816,513 @@ onig_print_statistics(FILE* f)
 #endif /* ONIG_DEBUG_STATISTICS */
 
 
-#ifdef ONIG_DEBUG_MATCH
-static char *
-stack_type_str(int stack_type)
+/* \R: (?>\x0D\x0A|[\x0A-\x0D\x{85}\x{2028}\x{2029}]), the last three
+   for Unicode encodings only.  Return the end of the linebreak at s,
+   or NULL. */
+static const UChar*
+linebreak_end(OnigEncoding enc, const UChar* s, const UChar* end,
+	      const UChar* limit)
 {
-  switch (stack_type) {
-    case STK_ALT:		return "Alt   ";
-    case STK_LOOK_BEHIND_NOT:	return "LBNot ";
-    case STK_POS_NOT:		return "PosNot";
-    case STK_MEM_START:		return "MemS  ";
-    case STK_MEM_END:		return "MemE  ";
-    case STK_REPEAT_INC:	return "RepInc";
-    case STK_STATE_CHECK_MARK:	return "StChMk";
-    case STK_NULL_CHECK_START:	return "NulChS";
-    case STK_NULL_CHECK_END:	return "NulChE";
-    case STK_MEM_END_MARK:	return "MemEMk";
-    case STK_POS:		return "Pos   ";
-    case STK_STOP_BT:		return "StopBt";
-    case STK_REPEAT:		return "Rep   ";
-    case STK_CALL_FRAME:	return "Call  ";
-    case STK_RETURN:		return "Ret   ";
-    case STK_VOID:		return "Void  ";
-    case STK_ABSENT_POS:	return "AbsPos";
-    case STK_ABSENT:		return "Absent";
-    default:			return "      ";
+  OnigCodePoint code;
+  const UChar* next;
+
+  if (ONIGENC_MBC_MINLEN(enc) == 1 && *s > 0x0d && *s < 0x80)
+    return NULL;  /* most chars of ASCII compatible encodings */
+
+  next = s + enclen(enc, s, end);
+  if (next > limit) return NULL;
+  code = ONIGENC_MBC_TO_CODE(enc, s, end);
+  if (code == 0x0d) {
+    if (next < limit) {
+      const UChar* q = next + enclen(enc, next, end);
+      if (q <= limit && ONIGENC_MBC_TO_CODE(enc, next, end) == 0x0a)
+	return q;
+    }
+    return next;
   }
+  if (code >= 0x0a && code <= 0x0c)
+    return next;
+  if (ONIGENC_IS_UNICODE(enc) &&
+      (code == 0x85 || code == 0x2028 || code == 0x2029))
+    return next;
+  return NULL;
 }
-#endif
 
-/* match data(str - end) from position (sstart). */
-/* if sstart == str then set sprev to NULL. */
-static OnigPosition
-match_at(regex_t* reg, const UChar* str, const UChar* end,
-#ifdef USE_MATCH_RANGE_MUST_BE_INSIDE_OF_SPECIFIED_RANGE
-	 const UChar* right_range,
-#endif
-	 const UChar* sstart, UChar* sprev, OnigMatchArg* msa)
+/* Step back from s by up to n chars, not past start.  Set the position
+   to *ps and return the number of chars stepped. */
+static int
+step_back_upto(OnigEncoding enc, const UChar* start, const UChar* s,
+	       const UChar* end, int n, UChar** ps)
 {
-  static const UChar FinishCode[] = { OP_FINISH };
+  int k = 0;
 
-  int i, num_mem, pop_level;
-  ptrdiff_t n, best_len;
-  LengthType tlen, tlen2;
-  MemNumType mem;
-  RelAddrType addr;
-  OnigOptionType option = reg->options;
-  OnigEncoding encode = reg->enc;
-  OnigCaseFoldType case_fold_flag = reg->case_fold_flag;
-  UChar *s, *q, *sbegin;
-  UChar *p = reg->p;
-  UChar *pkeep;
-  char *alloca_base;
-  char *xmalloc_base = NULL;
-  OnigStackType *stk_alloc, *stk_base, *stk, *stk_end;
-  OnigStackType *stkp; /* used as any purpose. */
-  OnigStackIndex si;
-  OnigStackIndex *repeat_stk;
-  OnigStackIndex *mem_start_stk, *mem_end_stk;
-#ifdef USE_COMBINATION_EXPLOSION_CHECK
-  int scv;
-  unsigned char* state_check_buff = msa->state_check_buff;
-  int num_comb_exp_check = reg->num_comb_exp_check;
-#endif
+  while (k < n && s > start) {
+    s = onigenc_get_prev_char_head(enc, start, s, end);
+    k++;
+  }
+  *ps = (UChar* )s;
+  return k;
+}
 
-#if USE_TOKEN_THREADED_VM
-# define OP_OFFSET  1
-# define VM_LOOP JUMP;
-# define VM_LOOP_END
-# define CASE(x) L_##x: sbegin = s; OPCODE_EXEC_HOOK;
-# define DEFAULT L_DEFAULT:
-# define NEXT sprev = sbegin; JUMP
-# define JUMP RB_GNUC_EXTENSION_BLOCK(goto *oplabels[*p++])
+#ifdef USE_UNICODE_PROPERTIES
+/* \X for Unicode encodings: the rules of node_extended_grapheme_cluster()
+ * in regparse.c, taken in the same order as the alternatives there, with
+ * one table lookup per char instead of the char classes. */
+
+typedef struct {
+  OnigEncoding enc;
+  const UChar* end;    /* end of string */
+  const UChar* limit;  /* chars must end before this */
+  /* the last char looked up, which the rules often look at again */
+  const UChar* at;
+  const UChar* next;
+  int gcb;
+  int limited;         /* a char was cut off by limit */
+} GraphemeScan;
+
+/* Return the Grapheme_Cluster_Break value of the char at s and set *next
+   to the next char, or return -1 if there is no whole char at s. */
+static int
+gcb_at(GraphemeScan* g, const UChar* s, const UChar** next)
+{
+  int len;
 
-  RB_GNUC_EXTENSION static const void *oplabels[] = {
-    &&L_OP_FINISH,               /* matching process terminator (no more alternative) */
-    &&L_OP_END,                  /* pattern code terminator (success end) */
+  if (s != g->at) {
+    if (s >= g->limit || s + (len = enclen(g->enc, s, g->end)) > g->limit) {
+      g->limited = 1;
+      return -1;
+    }
+    g->at   = s;
+    g->next = s + len;
+    g->gcb  = onigenc_unicode_grapheme_cluster_break(
+				ONIGENC_MBC_TO_CODE(g->enc, s, g->end));
+  }
+  *next = g->next;
+  return g->gcb;
+}
 
-    &&L_OP_EXACT1,               /* single byte, N = 1 */
-    &&L_OP_EXACT2,               /* single byte, N = 2 */
-    &&L_OP_EXACT3,               /* single byte, N = 3 */
-    &&L_OP_EXACT4,               /* single byte, N = 4 */
-    &&L_OP_EXACT5,               /* single byte, N = 5 */
-    &&L_OP_EXACTN,               /* single byte */
-    &&L_OP_EXACTMB2N1,           /* mb-length = 2 N = 1 */
-    &&L_OP_EXACTMB2N2,           /* mb-length = 2 N = 2 */
-    &&L_OP_EXACTMB2N3,           /* mb-length = 2 N = 3 */
-    &&L_OP_EXACTMB2N,            /* mb-length = 2 */
-    &&L_OP_EXACTMB3N,            /* mb-length = 3 */
+#define GCB_IS(c, v)  ((c) >= 0 && ((c) & ONIGENC_GCB_MASK) == (v))
+
+static const UChar*
+gcb_skip(GraphemeScan* g, const UChar* s, int gcb)
+{
+  const UChar* next;
+  int c;
+
+  while (c = gcb_at(g, s, &next), GCB_IS(c, gcb))
+    s = next;
+  return s;
+}
+
+/* core := hangul-syllable | ri-sequence | xpicto-sequence
+ *       | [^Control CR LF] */
+static const UChar*
+grapheme_core_end(GraphemeScan* g, const UChar* s)
+{
+  const UChar *next, *p, *q;
+  int c, c2;
+
+  c = gcb_at(g, s, &next);
+  if (c < 0) return NULL;
+
+  /* L* (V+ | LV V* | LVT) T* | L+ | T+ */
+  p = gcb_skip(g, s, ONIGENC_GCB_L);
+  c2 = gcb_at(g, p, &q);
+  if (GCB_IS(c2, ONIGENC_GCB_V) || GCB_IS(c2, ONIGENC_GCB_LV))
+    return gcb_skip(g, gcb_skip(g, q, ONIGENC_GCB_V), ONIGENC_GCB_T);
+  if (GCB_IS(c2, ONIGENC_GCB_LVT))
+    return gcb_skip(g, q, ONIGENC_GCB_T);
+  if (p != s) return p;
+  if (GCB_IS(c, ONIGENC_GCB_T))
+    return gcb_skip(g, next, ONIGENC_GCB_T);
+
+  /* RI RI */
+  if (GCB_IS(c, ONIGENC_GCB_REGIONAL_INDICATOR)) {
+    c2 = gcb_at(g, next, &q);
+    if (GCB_IS(c2, ONIGENC_GCB_REGIONAL_INDICATOR)) return q;
+  }
+
+  /* \p{Extended_Pictographic} (Extend* ZWJ \p{Extended_Pictographic})* */
+  if ((c & ONIGENC_GCB_EXTENDED_PICTOGRAPHIC) != 0) {
+    p = next;
+    while (1) {
+      c2 = gcb_at(g, gcb_skip(g, p, ONIGENC_GCB_EXTEND), &q);
+      if (! GCB_IS(c2, ONIGENC_GCB_ZWJ)) break;
+      c2 = gcb_at(g, q, &q);
+      if (c2 < 0 || (c2 & ONIGENC_GCB_EXTENDED_PICTOGRAPHIC) == 0) break;
+      p = q;
+    }
+    return p;
+  }
+
+  if (GCB_IS(c, ONIGENC_GCB_CR) || GCB_IS(c, ONIGENC_GCB_LF) ||
+      GCB_IS(c, ONIGENC_GCB_CONTROL))
+    return NULL;
+  return next;
+}
+
+/* Return the end of the grapheme cluster at s, or NULL. */
+static const UChar*
+grapheme_scan_end(GraphemeScan* g, const UChar* s)
+{
+  const UChar *next, *p, *q, *prepend;
+  int c, c2;
+
+  c = gcb_at(g, s, &next);
+  if (c < 0) return NULL;
+
+  /* CRLF | [Control CR LF] */
+  if (GCB_IS(c, ONIGENC_GCB_CR)) {
+    c2 = gcb_at(g, next, &q);
+    if (GCB_IS(c2, ONIGENC_GCB_LF)) return q;
+    return next;
+  }
+  if (GCB_IS(c, ONIGENC_GCB_LF) || GCB_IS(c, ONIGENC_GCB_CONTROL))
+    return next;
+
+  /* Prepend* core postcore* */
+  p = s;
+  prepend = NULL;
+  while (c2 = gcb_at(g, p, &q), GCB_IS(c2, ONIGENC_GCB_PREPEND)) {
+    prepend = p;
+    p = q;
+  }
+  q = grapheme_core_end(g, p);
+  if (IS_NULL(q)) {
+    /* backtrack: the last Prepend is the core */
+    if (IS_NULL(prepend)) return next;
+    q = p;
+  }
+
+  /* postcore := [Extend ZWJ SpacingMark] */
+  while (c2 = gcb_at(g, q, &p),
+	 GCB_IS(c2, ONIGENC_GCB_EXTEND) || GCB_IS(c2, ONIGENC_GCB_ZWJ) ||
+	 GCB_IS(c2, ONIGENC_GCB_SPACINGMARK))
+    q = p;
+  return q;
+}
+
+/* Return the end of the grapheme cluster at s, or NULL.  Set *limited
+   if the rules looked at limit. */
+static const UChar*
+grapheme_cluster_end(OnigEncoding enc, const UChar* s, const UChar* end,
+		     const UChar* limit, int* limited)
+{
+  GraphemeScan g;
+  const UChar *q;
+
+  g.enc     = enc;
+  g.end     = end;
+  g.limit   = limit;
+  g.at      = NULL;
+  g.limited = 0;
+
+  q = grapheme_scan_end(&g, s);
+  *limited = g.limited;
+  return q;
+}
+#endif /* USE_UNICODE_PROPERTIES */
+
+/* ".*" loops and greedy loops of one single character (OP_PUSH_SPAN) keep
+ * their exit points in one STK_SPAN entry instead of one STK_ALT per
+ * character: pstr is the next point to try and pstr_prev the loop's start
+ * (kept as an ordinary STK_ALT below the span).  This needs
+ * the subject to be walkable backward without decoding from the start, so
+ * it is used for single byte encodings and for runs of well-formed UTF-8. */
+#define SPAN_NONE   0
+#define SPAN_SB     1
+#define SPAN_UTF8   2
+
+#define SPAN_IS_TRAIL(c)  (((c) & 0xc0) == 0x80)
+
+static int
+span_char_is_regular(const UChar* s, int n)
+{
+  int i;
+
+  if (SPAN_IS_TRAIL(*s)) return 0;
+  for (i = 1; i < n; i++) {
+    if (! SPAN_IS_TRAIL(s[i])) return 0;
+  }
+  return 1;
+}
+
+/* s must be above the start of the span */
+static UChar*
+span_prev_char_head(int span_mode, const UChar* s)
+{
+  s--;
+  if (span_mode == SPAN_UTF8) {
+    while (SPAN_IS_TRAIL(*s)) s--;
+  }
+  return (UChar* )s;
+}
+
+/* last position in (low, s] holding byte c */
+static UChar*
+span_search_byte_backward(const UChar* low, const UChar* s, UChar c)
+{
+  for (; s > low; s--) {
+    if (*s == c) return (UChar* )s;
+  }
+  return NULL_UCHARP;
+}
+
+/* Consume the part of a ".*" loop that can be covered by a span and push
+ * its exit points; the per-character loop of the opcode handles the rest. */
+#define ANYCHAR_STAR_SPAN(ml) do {\
+  if (span_mode != SPAN_NONE) {\
+    UChar *s0 = s, *sprev0 = sprev;\
+    while (DATA_ENSURE_CHECK1) {\
+      n = EXEC_ENCLEN(s, end);\
+      if (! DATA_ENSURE_CHECK(n)) break;\
+      if (!(ml) && EXEC_IS_NEWLINE(s, 0))\
+	break;\
+      if (span_mode == SPAN_UTF8 && ! span_char_is_regular(s, (int )n)) break;\
+      sprev = s;\
+      s += n;\
+    }\
+    if (s > s0) {\
+      STACK_PUSH_ALT(p, s0, sprev0, pkeep);\
+      if (sprev > s0) STACK_PUSH_SPAN(p, sprev, s0, pkeep);\
+    }\
+  }\
+} while(0)
+
+/* Same for the PEEK_NEXT variants: only the points where the next byte
+ * is *p are tried. */
+#define ANYCHAR_STAR_PEEK_SPAN(ml) do {\
+  if (span_mode != SPAN_NONE &&\
+      (span_mode == SPAN_SB || ! SPAN_IS_TRAIL(*p))) {\
+    UChar *s0 = s, *last = NULL_UCHARP;\
+    while (DATA_ENSURE_CHECK1) {\
+      n = EXEC_ENCLEN(s, end);\
+      if (! DATA_ENSURE_CHECK(n)) break;\
+      if (!(ml) && EXEC_IS_NEWLINE(s, 0))\
+	break;\
+      if (span_mode == SPAN_UTF8 && ! span_char_is_regular(s, (int )n)) break;\
+      if (*p == *s) {\
+	if (s == s0) STACK_PUSH_ALT(p + 1, s, sprev, pkeep);\
+	else last = s;\
+      }\
+      sprev = s;\
+      s += n;\
+    }\
+    if (IS_NOT_NULL(last)) STACK_PUSH_SPAN_PEEK(p + 1, last, s0, pkeep);\
+  }\
+} while(0)
+
+static int
+span_code_in_range(OnigEncoding encode, const UChar* p, const UChar* s,
+		   int n)
+{
+  p += SIZE_LENGTH;
+#ifndef PLATFORM_UNALIGNED_WORD_ACCESS
+  ALIGNMENT_RIGHT(p);
+#endif
+  return onig_is_in_code_range(p, ONIGENC_MBC_TO_CODE(encode, s, s + n));
+}
+
+/* Whether the n byte character at s is matched by the single character
+ * opcode at p, the body of an OP_PUSH_SPAN loop. */
+static int
+span_char_match(OnigEncoding encode, const UChar* p, const UChar* s,
+		int n, const UChar* end)
+{
+  switch (*p++) {
+  case OP_EXACT1:
+    return *p == *s;
+  case OP_CCLASS:
+    return BITSET_AT(((BitSetRef )p), *s) != 0;
+  case OP_CCLASS_NOT:
+    return BITSET_AT(((BitSetRef )p), *s) == 0;
+  case OP_CCLASS_MB:
+    return n > 1 && span_code_in_range(encode, p, s, n);
+  case OP_CCLASS_MB_NOT:
+    return n == 1 || ! span_code_in_range(encode, p, s, n);
+  case OP_CCLASS_MIX:
+    if (n > 1) return span_code_in_range(encode, p + SIZE_BITSET, s, n);
+    return BITSET_AT(((BitSetRef )p), *s) != 0;
+  case OP_CCLASS_MIX_NOT:
+    if (n > 1) return ! span_code_in_range(encode, p + SIZE_BITSET, s, n);
+    return BITSET_AT(((BitSetRef )p), *s) == 0;
+  case OP_WORD:
+    return ONIGENC_IS_MBC_WORD(encode, s, end);
+  case OP_NOT_WORD:
+    return ! ONIGENC_IS_MBC_WORD(encode, s, end);
+  case OP_ASCII_WORD:
+    return ONIGENC_IS_MBC_ASCII_WORD(encode, s, end);
+  case OP_NOT_ASCII_WORD:
+    return ! ONIGENC_IS_MBC_ASCII_WORD(encode, s, end);
+  default:
+    return 0;
+  }
+}
+
+/* Run a greedy loop of OP_PUSH_SPAN, whose body at p matches one character
+ * per iteration, and keep the exit points but the last one in one STK_SPAN
+ * entry; the ordinary loop goes on from where the run stops.  With peek,
+ * only the exit points where the next byte is *peek are kept: the entry is
+ * an STK_SPAN_PEEK_LOOP holding the body, which follows the peek byte. */
+#define PUSH_SPAN_RUN(exit, peek) do {\
+  if (span_mode != SPAN_NONE && (IS_NULL(peek) ||\
+      span_mode == SPAN_SB || ! SPAN_IS_TRAIL(*(peek)))) {\
+    UChar *s0 = s, *sprev0 = sprev, *last = NULL_UCHARP;\
+    while (DATA_ENSURE_CHECK1) {\
+      n = EXEC_ENCLEN(s, end);\
+      if (! DATA_ENSURE_CHECK(n)) break;\
+      if (span_mode == SPAN_UTF8 && ! span_char_is_regular(s, (int )n)) break;\
+      if (! span_char_match(encode, p, s, (int )n, end)) break;\
+      if (s > s0 && (IS_NULL(peek) || *s == *(peek))) last = s;\
+      sprev = s;\
+      s += n;\
+    }\
+    if (s > s0) {\
+      if (IS_NULL(peek) || *s0 == *(peek))\
+	STACK_PUSH_ALT(exit, s0, sprev0, pkeep);\
+      if (IS_NOT_NULL(last)) {\
+	if (IS_NULL(peek)) STACK_PUSH_SPAN(exit, last, s0, pkeep);\
+	else STACK_PUSH_SPAN_PEEK_LOOP((peek) + 1, last, s0, pkeep);\
+      }\
+    }\
+  }\
+} while(0)
+
+/* OP_ALT_DISPATCH: the first branch from i on that can match at s, or n
+   if there is none */
+static int
+alt_dispatch_find(const UChar* addrs, int n, const UChar* s, const UChar* end,
+		  int i)
+{
+  const UChar* row = addrs + SIZE_RELADDR * n +
+    ALT_DISPATCH_ROW_SIZE(n) * (s < end ? *s : SINGLE_BYTE_SIZE);
+
+  while (i < n) {
+    unsigned int bits = row[i >> 3] >> (i & 7);
+
+    if (bits == 0) {
+      i = (i | 7) + 1;
+      continue;
+    }
+    while ((bits & 1) == 0) {
+      bits >>= 1;
+      i++;
+    }
+    return i;
+  }
+  return n;
+}
+
+static RelAddrType
+alt_dispatch_addr(const UChar* addrs, int i)
+{
+  RelAddrType addr;
+  const UChar* p = addrs + SIZE_RELADDR * i;
+
+  GET_RELADDR_INC(addr, p);
+  return addr;
+}
+
+#ifdef ONIG_DEBUG_MATCH
+static char *
+stack_type_str(int stack_type)
+{
+  switch (stack_type) {
+    case STK_ALT:		return "Alt   ";
+    case STK_LOOK_BEHIND_NOT:	return "LBNot ";
+    case STK_POS_NOT:		return "PosNot";
+    case STK_SPAN:		return "Span  ";
+    case STK_SPAN_PEEK:		return "SpanPk";
+    case STK_SPAN_PEEK_LOOP:	return "SpanPL";
+    case STK_MEM_START:		return "MemS  ";
+    case STK_MEM_END:		return "MemE  ";
+    case STK_REPEAT_INC:	return "RepInc";
+    case STK_STATE_CHECK_MARK:	return "StChMk";
+    case STK_NULL_CHECK_START:	return "NulChS";
+    case STK_NULL_CHECK_END:	return "NulChE";
+    case STK_MEM_END_MARK:	return "MemEMk";
+    case STK_POS:		return "Pos   ";
+    case STK_STOP_BT:		return "StopBt";
+    case STK_REPEAT:		return "Rep   ";
+    case STK_CALL_FRAME:	return "Call  ";
+    case STK_RETURN:		return "Ret   ";
+    case STK_VOID:		return "Void  ";
+    case STK_ABSENT_POS:	return "AbsPos";
+    case STK_ABSENT:		return "Absent";
+    default:			return "      ";
+  }
+}
+#endif
+
+/* match data(str - end) from position (sstart). */
+/* if sstart == str then set sprev to NULL. */
+static OnigPosition
+match_at(regex_t* reg, const UChar* str, const UChar* end,
+#ifdef USE_MATCH_RANGE_MUST_BE_INSIDE_OF_SPECIFIED_RANGE
+	 const UChar* right_range,
+#endif
+	 const UChar* sstart, UChar* sprev, OnigMatchArg* msa)
+{
+  static const UChar FinishCode[] = { OP_FINISH };
+
+  int i, num_mem, pop_level;
+  ptrdiff_t n, best_len;
+  LengthType tlen, tlen2;
+  MemNumType mem;
+  RelAddrType addr;
+  OnigOptionType option = reg->options;
+  OnigEncoding encode = reg->enc;
+  OnigCaseFoldType case_fold_flag = reg->case_fold_flag;
+  int enc_kind = reg->enc_kind;
+  int span_mode;
+  UChar *s, *q, *sbegin;
+  UChar *p = reg->p;
+  UChar *pkeep;
+  char *alloca_base;
+  char *xmalloc_base = NULL;
+  OnigStackType *stk_alloc, *stk_base, *stk, *stk_end;
+  OnigStackType *stkp; /* used as any purpose. */
+  OnigStackIndex si;
+  OnigStackIndex *repeat_stk;
+  OnigStackIndex *mem_start_stk, *mem_end_stk;
+#ifdef USE_SUBEXP_CALL
+  OnigStackIndex call_top = INVALID_STACK_INDEX;
+#endif
+#ifdef USE_COMBINATION_EXPLOSION_CHECK
+  int scv;
+  unsigned char* state_check_buff = msa->state_check_buff;
+  int num_comb_exp_check = reg->num_comb_exp_check;
+#endif
+
+#if USE_TOKEN_THREADED_VM
+# define OP_OFFSET  1
+# define VM_LOOP JUMP;
+# define VM_LOOP_END
+# define CASE(x) L_##x: sbegin = s; OPCODE_EXEC_HOOK;
+# define DEFAULT L_DEFAULT:
+# define NEXT sprev = sbegin; JUMP
+# define JUMP RB_GNUC_EXTENSION_BLOCK(goto *oplabels[*p++])
+
+  RB_GNUC_EXTENSION static const void *oplabels[] = {
+    &&L_OP_FINISH,               /* matching process terminator (no more alternative) */
+    &&L_OP_END,                  /* pattern code terminator (success end) */
+
+    &&L_OP_EXACT1,               /* single byte, N = 1 */
+    &&L_OP_EXACT2,               /* single byte, N = 2 */
+    &&L_OP_EXACT3,               /* single byte, N = 3 */
+    &&L_OP_EXACT4,               /* single byte, N = 4 */
+    &&L_OP_EXACT5,               /* single byte, N = 5 */
+    &&L_OP_EXACTN,               /* single byte */
+    &&L_OP_EXACTMB2N1,           /* mb-length = 2 N = 1 */
+    &&L_OP_EXACTMB2N2,           /* mb-length = 2 N = 2 */
+    &&L_OP_EXACTMB2N3,           /* mb-length = 2 N = 3 */
+    &&L_OP_EXACTMB2N,            /* mb-length = 2 */
+    &&L_OP_EXACTMB3N,            /* mb-length = 3 */
     &&L_OP_EXACTMBN,             /* other length */
 
     &&L_OP_EXACT1_IC,            /* single byte, N = 1, ignore case */
     &&L_OP_EXACTN_IC,            /* single byte,        ignore case */
+    &&L_OP_EXACTN_FOLD,          /* ignore case, the chars matched by each char */
 
     &&L_OP_CCLASS,
     &&L_OP_CCLASS_MB,
@@ -1498,6 +2337,8 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
     &&L_OP_ANYCHAR_ML_STAR,         /* ".*" multi-line */
     &&L_OP_ANYCHAR_STAR_PEEK_NEXT,
     &&L_OP_ANYCHAR_ML_STAR_PEEK_NEXT,
+    &&L_OP_LINEBREAK,            /* "\R" */
+    &&L_OP_GRAPHEME_CLUSTER,     /* "\X" (Unicode) */
 
     &&L_OP_WORD,
     &&L_OP_NOT_WORD,
@@ -1567,6 +2408,10 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
     &&L_DEFAULT,
 # endif
     &&L_OP_PUSH_IF_PEEK_NEXT,    /* if match exact then push, else none. */
+    &&L_OP_PUSH_SPAN,            /* OP_PUSH of a loop of one single char opcode */
+    &&L_OP_PUSH_SPAN_IF_PEEK_NEXT, /* same for OP_PUSH_IF_PEEK_NEXT */
+    &&L_OP_ALT_DISPATCH,         /* jump to the first branch for the next byte */
+    &&L_OP_ALT_DISPATCH_NEXT,    /* push the next branch for the next byte */
     &&L_OP_REPEAT,               /* {n,m} */
     &&L_OP_REPEAT_NG,            /* {n,m}? (non greedy) */
     &&L_OP_REPEAT_INC,
@@ -1595,9 +2440,14 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
     &&L_OP_LOOK_BEHIND,          /* (?<=...) start (no needs end opcode) */
     &&L_OP_PUSH_LOOK_BEHIND_NOT, /* (?<!...) start */
     &&L_OP_FAIL_LOOK_BEHIND_NOT, /* (?<!...) end   */
+    &&L_OP_LOOK_BEHIND_VAR,      /* (?<=...) start, variable length */
+    &&L_OP_LOOK_BEHIND_VAR_END,  /* (?<=...) end,   variable length */
+    &&L_OP_PUSH_LOOK_BEHIND_NOT_VAR, /* (?<!...) start, variable length */
+    &&L_OP_FAIL_LOOK_BEHIND_NOT_VAR, /* (?<!...) end,   variable length */
     &&L_OP_PUSH_ABSENT_POS,      /* (?~...)  start */
     &&L_OP_ABSENT,               /* (?~...)  start of inner loop */
     &&L_OP_ABSENT_END,           /* (?~...)  end   */
+    &&L_OP_ABSENT_EXACT,         /* (?~string) */
 
 # ifdef USE_SUBEXP_CALL
     &&L_OP_CALL,                 /* \g<name> */
@@ -1662,6 +2512,12 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 
   STACK_INIT(alloca_base, xmalloc_base, n, INIT_MATCH_STACK_SIZE);
   pop_level = reg->stack_pop_level;
+  if (ONIGENC_MBC_MAXLEN(encode) == 1)
+    span_mode = SPAN_SB;
+  else if (ONIGENC_IS_UNICODE(encode) && ONIGENC_MBC_MINLEN(encode) == 1)
+    span_mode = SPAN_UTF8;
+  else
+    span_mode = SPAN_NONE;
   num_mem = reg->num_mem;
   repeat_stk = (OnigStackIndex* )alloca_base;
 
@@ -1803,7 +2659,8 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	  best_len = ONIG_MISMATCH;
 	  goto fail; /* for retry */
 	}
-	if (IS_FIND_LONGEST(option) && DATA_ENSURE_CHECK1) {
+	if (IS_FIND_LONGEST(option) && DATA_ENSURE_CHECK1 &&
+	    (best_len < 0 || (OnigDistance )best_len < reg->max_len)) {
 	  goto fail; /* for retry */
 	}
       }
@@ -1929,6 +2786,35 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       MOP_OUT;
       JUMP;
 
+    CASE(OP_EXACTN_FOLD)  MOP_IN(OP_EXACTN_FOLD);
+      {
+	int n, len;
+	UChar *endp;
+
+	GET_LENGTH_INC(tlen, p);
+	endp = p + tlen;
+
+	/* the chars a pattern char matches are distinct, so at most one
+	 * of them is at s: no need to fold the subject */
+	while (p < endp) {
+	  sprev = s;
+	  n = *p++;
+	  while (1) {
+	    len = *p++;
+	    if (DATA_ENSURE_CHECK(len) && *p == *s &&
+		(len == 1 || memcmp(p + 1, s + 1, len - 1) == 0))
+	      break;
+	    p += len;
+	    if (--n == 0) goto fail;
+	  }
+	  s += len;
+	  p += len;
+	  while (--n > 0) p += 1 + *p;
+	}
+      }
+      MOP_OUT;
+      JUMP;
+
     CASE(OP_EXACTMB2N1)  MOP_IN(OP_EXACTMB2N1);
       DATA_ENSURE(2);
       if (*p != *s) goto fail;
@@ -2015,11 +2901,12 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       DATA_ENSURE(1);
       if (BITSET_AT(((BitSetRef )p), *s) == 0) goto fail;
       p += SIZE_BITSET;
-      s += enclen(encode, s, end);   /* OP_CCLASS can match mb-code. \D, \S */
+      s += EXEC_ENCLEN(s, end);   /* OP_CCLASS can match mb-code. \D, \S */
       MOP_OUT;
       NEXT;
 
     CASE(OP_CCLASS_MB)  MOP_IN(OP_CCLASS_MB);
+      DATA_ENSURE(1);
       if (! ONIGENC_IS_MBC_HEAD(encode, s, end)) goto fail;
 
     cclass_mb:
@@ -2030,11 +2917,11 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	int mb_len;
 
 	DATA_ENSURE(1);
-	mb_len = enclen(encode, s, end);
+	mb_len = EXEC_ENCLEN(s, end);
 	DATA_ENSURE(mb_len);
 	ss = s;
 	s += mb_len;
-	code = ONIGENC_MBC_TO_CODE(encode, ss, s);
+	code = EXEC_MBC_TO_CODE(ss, s);
 
 #ifdef PLATFORM_UNALIGNED_WORD_ACCESS
 	if (! onig_is_in_code_range(p, code)) goto fail;
@@ -2070,7 +2957,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       DATA_ENSURE(1);
       if (BITSET_AT(((BitSetRef )p), *s) != 0) goto fail;
       p += SIZE_BITSET;
-      s += enclen(encode, s, end);
+      s += EXEC_ENCLEN(s, end);
       MOP_OUT;
       NEXT;
 
@@ -2088,7 +2975,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       {
 	OnigCodePoint code;
 	UChar *ss;
-	int mb_len = enclen(encode, s, end);
+	int mb_len = EXEC_ENCLEN(s, end);
 
 	if (! DATA_ENSURE_CHECK(mb_len)) {
 	  DATA_ENSURE(1);
@@ -2099,7 +2986,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 
 	ss = s;
 	s += mb_len;
-	code = ONIGENC_MBC_TO_CODE(encode, ss, s);
+	code = EXEC_MBC_TO_CODE(ss, s);
 
 #ifdef PLATFORM_UNALIGNED_WORD_ACCESS
 	if (onig_is_in_code_range(p, code)) goto fail;
@@ -2135,27 +3022,59 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 
     CASE(OP_ANYCHAR)  MOP_IN(OP_ANYCHAR);
       DATA_ENSURE(1);
-      n = enclen(encode, s, end);
+      n = EXEC_ENCLEN(s, end);
       DATA_ENSURE(n);
-      if (ONIGENC_IS_MBC_NEWLINE_EX(encode, s, str, end, option, 0)) goto fail;
+      if (EXEC_IS_NEWLINE(s, 0)) goto fail;
       s += n;
       MOP_OUT;
       NEXT;
 
     CASE(OP_ANYCHAR_ML)  MOP_IN(OP_ANYCHAR_ML);
       DATA_ENSURE(1);
-      n = enclen(encode, s, end);
+      n = EXEC_ENCLEN(s, end);
       DATA_ENSURE(n);
       s += n;
       MOP_OUT;
       NEXT;
 
+    CASE(OP_LINEBREAK)  MOP_IN(OP_LINEBREAK);
+      DATA_ENSURE(1);
+      q = (UChar* )linebreak_end(encode, s, end, DATA_END);
+      if (IS_NULL(q)) {
+	DATA_ENSURE(EXEC_ENCLEN(s, end));
+	goto fail;
+      }
+      if (q == DATA_END) (void )MARK_EDGE(DATA_END);  /* may be CR of CRLF */
+      sprev = (UChar* )onigenc_get_prev_char_head(encode, s, q, end);
+      s = q;
+      MOP_OUT;
+      JUMP;
+
+    CASE(OP_GRAPHEME_CLUSTER)  MOP_IN(OP_GRAPHEME_CLUSTER);
+#ifdef USE_UNICODE_PROPERTIES
+      DATA_ENSURE(1);
+      {
+	int limited;
+
+	q = (UChar* )grapheme_cluster_end(encode, s, end, DATA_END, &limited);
+	if (limited) (void )MARK_EDGE(DATA_END);
+      }
+      if (IS_NULL(q)) goto fail;
+      sprev = (UChar* )onigenc_get_prev_char_head(encode, s, q, end);
+      s = q;
+      MOP_OUT;
+      JUMP;
+#else
+      goto bytecode_error;
+#endif
+
     CASE(OP_ANYCHAR_STAR)  MOP_IN(OP_ANYCHAR_STAR);
+      ANYCHAR_STAR_SPAN(0);
       while (DATA_ENSURE_CHECK1) {
 	STACK_PUSH_ALT(p, s, sprev, pkeep);
-	n = enclen(encode, s, end);
+	n = EXEC_ENCLEN(s, end);
 	DATA_ENSURE(n);
-	if (ONIGENC_IS_MBC_NEWLINE_EX(encode, s, str, end, option, 0))  goto fail;
+	if (EXEC_IS_NEWLINE(s, 0))  goto fail;
 	sprev = s;
 	s += n;
       }
@@ -2163,9 +3082,10 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       JUMP;
 
     CASE(OP_ANYCHAR_ML_STAR)  MOP_IN(OP_ANYCHAR_ML_STAR);
+      ANYCHAR_STAR_SPAN(1);
       while (DATA_ENSURE_CHECK1) {
 	STACK_PUSH_ALT(p, s, sprev, pkeep);
-	n = enclen(encode, s, end);
+	n = EXEC_ENCLEN(s, end);
 	if (n > 1) {
 	  DATA_ENSURE(n);
 	  sprev = s;
@@ -2180,13 +3100,14 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       JUMP;
 
     CASE(OP_ANYCHAR_STAR_PEEK_NEXT)  MOP_IN(OP_ANYCHAR_STAR_PEEK_NEXT);
+      ANYCHAR_STAR_PEEK_SPAN(0);
       while (DATA_ENSURE_CHECK1) {
 	if (*p == *s) {
 	  STACK_PUSH_ALT(p + 1, s, sprev, pkeep);
 	}
-	n = enclen(encode, s, end);
+	n = EXEC_ENCLEN(s, end);
 	DATA_ENSURE(n);
-	if (ONIGENC_IS_MBC_NEWLINE_EX(encode, s, str, end, option, 0))  goto fail;
+	if (EXEC_IS_NEWLINE(s, 0))  goto fail;
 	sprev = s;
 	s += n;
       }
@@ -2195,11 +3116,12 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       NEXT;
 
     CASE(OP_ANYCHAR_ML_STAR_PEEK_NEXT)MOP_IN(OP_ANYCHAR_ML_STAR_PEEK_NEXT);
+      ANYCHAR_STAR_PEEK_SPAN(1);
       while (DATA_ENSURE_CHECK1) {
 	if (*p == *s) {
 	  STACK_PUSH_ALT(p + 1, s, sprev, pkeep);
 	}
-	n = enclen(encode, s, end);
+	n = EXEC_ENCLEN(s, end);
 	if (n > 1) {
 	  DATA_ENSURE(n);
 	  sprev = s;
@@ -2222,9 +3144,9 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	if (scv) goto fail;
 
 	STACK_PUSH_ALT_WITH_STATE_CHECK(p, s, sprev, mem, pkeep);
-	n = enclen(encode, s, end);
+	n = EXEC_ENCLEN(s, end);
 	DATA_ENSURE(n);
-	if (ONIGENC_IS_MBC_NEWLINE_EX(encode, s, str, end, option, 0))  goto fail;
+	if (EXEC_IS_NEWLINE(s, 0))  goto fail;
 	sprev = s;
 	s += n;
       }
@@ -2240,7 +3162,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	if (scv) goto fail;
 
 	STACK_PUSH_ALT_WITH_STATE_CHECK(p, s, sprev, mem, pkeep);
-	n = enclen(encode, s, end);
+	n = EXEC_ENCLEN(s, end);
 	if (n > 1) {
 	  DATA_ENSURE(n);
 	  sprev = s;
@@ -2260,7 +3182,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       if (! ONIGENC_IS_MBC_WORD(encode, s, end))
 	goto fail;
 
-      s += enclen(encode, s, end);
+      s += EXEC_ENCLEN(s, end);
       MOP_OUT;
       NEXT;
 
@@ -2269,7 +3191,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       if (! ONIGENC_IS_MBC_ASCII_WORD(encode, s, end))
 	goto fail;
 
-      s += enclen(encode, s, end);
+      s += EXEC_ENCLEN(s, end);
       MOP_OUT;
       NEXT;
 
@@ -2278,7 +3200,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       if (ONIGENC_IS_MBC_WORD(encode, s, end))
 	goto fail;
 
-      s += enclen(encode, s, end);
+      s += EXEC_ENCLEN(s, end);
       MOP_OUT;
       NEXT;
 
@@ -2287,7 +3209,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       if (ONIGENC_IS_MBC_ASCII_WORD(encode, s, end))
 	goto fail;
 
-      s += enclen(encode, s, end);
+      s += EXEC_ENCLEN(s, end);
       MOP_OUT;
       NEXT;
 
@@ -2433,7 +3355,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
     CASE(OP_END_LINE)  MOP_IN(OP_END_LINE);
       if (ON_STR_END(s)) {
 #ifndef USE_NEWLINE_AT_END_OF_STRING_HAS_EMPTY_LINE
-	if (IS_EMPTY_STR || !ONIGENC_IS_MBC_NEWLINE_EX(encode, sprev, str, end, option, 1)) {
+	if (IS_EMPTY_STR || !EXEC_IS_NEWLINE(sprev, 1)) {
 #endif
 	  if (IS_NOTEOL(msa->options)) goto fail;
 	  MOP_OUT;
@@ -2442,7 +3364,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	}
 #endif
       }
-      else if (ONIGENC_IS_MBC_NEWLINE_EX(encode, s, str, end, option, 1)) {
+      else if (EXEC_IS_NEWLINE(s, 1)) {
 	MOP_OUT;
 	JUMP;
       }
@@ -2451,7 +3373,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
     CASE(OP_SEMI_END_BUF)  MOP_IN(OP_SEMI_END_BUF);
       if (ON_STR_END(s)) {
 #ifndef USE_NEWLINE_AT_END_OF_STRING_HAS_EMPTY_LINE
-	if (IS_EMPTY_STR || !ONIGENC_IS_MBC_NEWLINE_EX(encode, sprev, str, end, option, 1)) {
+	if (IS_EMPTY_STR || !EXEC_IS_NEWLINE(sprev, 1)) {
 #endif
 	  if (IS_NOTEOL(msa->options)) goto fail;
 	  MOP_OUT;
@@ -2460,8 +3382,8 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	}
 #endif
       }
-      else if (ONIGENC_IS_MBC_NEWLINE_EX(encode, s, str, end, option, 1)) {
-	UChar* ss = s + enclen(encode, s, end);
+      else if (EXEC_IS_NEWLINE(s, 1)) {
+	UChar* ss = s + EXEC_ENCLEN(s, end);
 	if (ON_STR_END(ss)) {
 	  MOP_OUT;
 	  JUMP;
@@ -2469,7 +3391,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 #ifdef USE_CRNL_AS_LINE_TERMINATOR
 	else if (IS_NEWLINE_CRLF(option)
 	    && ONIGENC_IS_MBC_CRNL(encode, s, end)) {
-	  ss += enclen(encode, ss, end);
+	  ss += EXEC_ENCLEN(ss, end);
 	  if (ON_STR_END(ss)) {
 	    MOP_OUT;
 	    JUMP;
@@ -2519,7 +3441,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 #ifdef USE_SUBEXP_CALL
     CASE(OP_MEMORY_END_PUSH_REC)  MOP_IN(OP_MEMORY_END_PUSH_REC);
       GET_MEMNUM_INC(mem, p);
-      STACK_GET_MEM_START(mem, stkp); /* should be before push mem-end. */
+      STACK_GET_REC_MEM_START(mem, stkp); /* should be before push mem-end. */
       STACK_PUSH_MEM_END(mem, s);
       mem_start_stk[mem] = GET_STACK_INDEX(stkp);
       MOP_OUT;
@@ -2528,7 +3450,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
     CASE(OP_MEMORY_END_REC)  MOP_IN(OP_MEMORY_END_REC);
       GET_MEMNUM_INC(mem, p);
       mem_end_stk[mem] = (OnigStackIndex )((void* )s);
-      STACK_GET_MEM_START(mem, stkp);
+      STACK_GET_REC_MEM_START(mem, stkp);
 
       if (BIT_STATUS_AT(reg->bt_mem_start, mem))
 	mem_start_stk[mem] = GET_STACK_INDEX(stkp);
@@ -2552,7 +3474,6 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       GET_MEMNUM_INC(mem, p);
     backref:
       {
-	int len;
 	UChar *pstart, *pend;
 
 	/* if you want to remove following line,
@@ -2573,8 +3494,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	DATA_ENSURE(n);
 	sprev = s;
 	STRING_CMP(pstart, s, n);
-	while (sprev + (len = enclen(encode, sprev, end)) < s)
-	  sprev += len;
+	BACKREF_SET_PREV;
 
 	MOP_OUT;
 	JUMP;
@@ -2583,7 +3503,6 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
     CASE(OP_BACKREFN_IC)  MOP_IN(OP_BACKREFN_IC);
       GET_MEMNUM_INC(mem, p);
       {
-	int len;
 	UChar *pstart, *pend;
 
 	/* if you want to remove following line,
@@ -2604,8 +3523,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	DATA_ENSURE(n);
 	sprev = s;
 	STRING_CMP_IC(case_fold_flag, pstart, &s, (int)n, end);
-	while (sprev + (len = enclen(encode, sprev, end)) < s)
-	  sprev += len;
+	BACKREF_SET_PREV;
 
 	MOP_OUT;
 	JUMP;
@@ -2614,7 +3532,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 
     CASE(OP_BACKREF_MULTI)  MOP_IN(OP_BACKREF_MULTI);
       {
-	int len, is_fail;
+	int is_fail;
 	UChar *pstart, *pend, *swork;
 
 	GET_LENGTH_INC(tlen, p);
@@ -2639,8 +3557,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	  STRING_CMP_VALUE(pstart, swork, n, is_fail);
 	  if (is_fail) continue;
 	  s = swork;
-	  while (sprev + (len = enclen(encode, sprev, end)) < s)
-	    sprev += len;
+	  BACKREF_SET_PREV;
 
 	  p += (SIZE_MEMNUM * (tlen - i - 1));
 	  break; /* success */
@@ -2653,7 +3570,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 
     CASE(OP_BACKREF_MULTI_IC)  MOP_IN(OP_BACKREF_MULTI_IC);
       {
-	int len, is_fail;
+	int is_fail;
 	UChar *pstart, *pend, *swork;
 
 	GET_LENGTH_INC(tlen, p);
@@ -2678,8 +3595,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	  STRING_CMP_VALUE_IC(case_fold_flag, pstart, &swork, n, end, is_fail);
 	  if (is_fail) continue;
 	  s = swork;
-	  while (sprev + (len = enclen(encode, sprev, end)) < s)
-	    sprev += len;
+	  BACKREF_SET_PREV;
 
 	  p += (SIZE_MEMNUM * (tlen - i - 1));
 	  break; /* success */
@@ -2692,7 +3608,6 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 #ifdef USE_BACKREF_WITH_LEVEL
     CASE(OP_BACKREF_WITH_LEVEL)
       {
-	int len;
 	OnigOptionType ic;
 	LengthType level;
 
@@ -2701,15 +3616,17 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	GET_LENGTH_INC(tlen,  p);
 
 	sprev = s;
-	if (backref_match_at_nested_level(reg, stk, stk_base, ic,
-		  case_fold_flag, (int )level, (int )tlen, p, &s, end)) {
-	  while (sprev + (len = enclen(encode, sprev, end)) < s)
-	    sprev += len;
+	n = backref_match_at_nested_level(reg, stk, stk_base, ic,
+		  case_fold_flag, (int )level, (int )tlen, p, &s, end);
+	if (n > 0) {
+	  BACKREF_SET_PREV;
 
 	  p += (SIZE_MEMNUM * tlen);
 	}
-	else
+	else {
+	  if (n < 0) (void )MARK_EDGE(end);
 	  goto fail;
+	}
 
 	MOP_OUT;
 	JUMP;
@@ -2873,7 +3790,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 #ifdef USE_OP_PUSH_OR_JUMP_EXACT
     CASE(OP_PUSH_OR_JUMP_EXACT1)  MOP_IN(OP_PUSH_OR_JUMP_EXACT1);
       GET_RELADDR_INC(addr, p);
-      if (*p == *s && DATA_ENSURE_CHECK1) {
+      if (DATA_ENSURE_CHECK1 && *p == *s) {
 	p++;
 	STACK_PUSH_ALT(p + addr, s, sprev, pkeep);
 	MOP_OUT;
@@ -2886,7 +3803,7 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 
     CASE(OP_PUSH_IF_PEEK_NEXT)  MOP_IN(OP_PUSH_IF_PEEK_NEXT);
       GET_RELADDR_INC(addr, p);
-      if (*p == *s) {
+      if (DATA_ENSURE_CHECK1 && *p == *s) {
 	p++;
 	STACK_PUSH_ALT(p + addr, s, sprev, pkeep);
 	MOP_OUT;
@@ -2896,6 +3813,48 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       MOP_OUT;
       JUMP;
 
+    CASE(OP_PUSH_SPAN)  MOP_IN(OP_PUSH_SPAN);
+      GET_RELADDR_INC(addr, p);
+      PUSH_SPAN_RUN(p + addr, NULL_UCHARP);
+      STACK_PUSH_ALT(p + addr, s, sprev, pkeep);
+      MOP_OUT;
+      JUMP;
+
+    CASE(OP_PUSH_SPAN_IF_PEEK_NEXT)  MOP_IN(OP_PUSH_SPAN_IF_PEEK_NEXT);
+      GET_RELADDR_INC(addr, p);
+      p++;
+      PUSH_SPAN_RUN(p + addr, p - 1);
+      if (DATA_ENSURE_CHECK1 && *(p - 1) == *s) {
+	STACK_PUSH_ALT(p + addr, s, sprev, pkeep);
+      }
+      MOP_OUT;
+      JUMP;
+
+    CASE(OP_ALT_DISPATCH)  MOP_IN(OP_ALT_DISPATCH);
+      GET_LENGTH_INC(tlen, p);
+      (void )MARK_EDGE(s);
+      i = alt_dispatch_find(p, tlen, s, end, 0);
+      if (i >= tlen) goto fail;
+      p += alt_dispatch_addr(p, i);
+      MOP_OUT;
+      JUMP;
+
+    CASE(OP_ALT_DISPATCH_NEXT)  MOP_IN(OP_ALT_DISPATCH_NEXT);
+      GET_RELADDR_INC(addr, p);
+      q = p + addr;  /* the branch addresses of OP_ALT_DISPATCH */
+      GET_LENGTH_INC(tlen2, p);
+      {
+	UChar* np = q - SIZE_LENGTH;
+	GET_LENGTH_INC(tlen, np);
+      }
+      (void )MARK_EDGE(s);
+      i = alt_dispatch_find(q, tlen, s, end, tlen2 + 1);
+      if (i < tlen) {
+	STACK_PUSH_ALT(q + alt_dispatch_addr(q, i), s, sprev, pkeep);
+      }
+      MOP_OUT;
+      JUMP;
+
     CASE(OP_REPEAT)  MOP_IN(OP_REPEAT);
       {
 	GET_MEMNUM_INC(mem, p);    /* mem: OP_REPEAT ID */
@@ -3053,18 +4012,77 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       STACK_POP_TIL_LOOK_BEHIND_NOT;
       goto fail;
 
-    CASE(OP_PUSH_ABSENT_POS)  MOP_IN(OP_PUSH_ABSENT_POS);
-      /* Save the absent-start-pos and the original end-pos. */
-      STACK_PUSH_ABSENT_POS(s, ABSENT_END_POS);
+    CASE(OP_LOOK_BEHIND_VAR)  MOP_IN(OP_LOOK_BEHIND_VAR);
+      GET_LENGTH_INC(tlen,  p);  /* min char length */
+      GET_LENGTH_INC(tlen2, p);  /* max char length */
+      n = step_back_upto(encode, str, s, end, (int )tlen2, &q);
+      if (n < tlen) goto fail;
+      STACK_PUSH_POS(s, sprev, pkeep);
+      goto look_behind_var_start;
+
+    CASE(OP_PUSH_LOOK_BEHIND_NOT_VAR)  MOP_IN(OP_PUSH_LOOK_BEHIND_NOT_VAR);
+      GET_RELADDR_INC(addr, p);
+      GET_LENGTH_INC(tlen,  p);  /* min char length */
+      GET_LENGTH_INC(tlen2, p);  /* max char length */
+      n = step_back_upto(encode, str, s, end, (int )tlen2, &q);
+      if (n < tlen) {
+	/* too short case -> success, as OP_PUSH_LOOK_BEHIND_NOT. */
+	p += addr;
+	MOP_OUT;
+	JUMP;
+      }
+      STACK_PUSH_LOOK_BEHIND_NOT(p + addr, s, sprev, pkeep);
+
+    look_behind_var_start:
+      /* Try the shortest first: push the longer starts as alternatives,
+       * the farthest one first. */
+      sprev = (UChar* )onigenc_get_prev_char_head(encode, str, q, end);
+      for (; n > tlen; n--) {
+	STACK_PUSH_ALT(p, q, sprev, pkeep);
+	sprev = q;
+	q += EXEC_ENCLEN(q, end);
+      }
+      s = q;
       MOP_OUT;
       JUMP;
 
-    CASE(OP_ABSENT)  MOP_IN(OP_ABSENT);
-      {
-	const UChar* aend = ABSENT_END_POS;
-	UChar* absent;
-	UChar* selfp = p - 1;
-
+    CASE(OP_LOOK_BEHIND_VAR_END)  MOP_IN(OP_LOOK_BEHIND_VAR_END);
+      /* The body must end where the look-behind started. */
+      stkp = stk;
+      do {
+	stkp--;
+	STACK_BASE_CHECK(stkp, "OP_LOOK_BEHIND_VAR_END");
+      } while (stkp->type != STK_POS);
+      if (stkp->u.state.pstr != s) goto fail;
+
+      STACK_POS_END(stkp);
+      sprev = stkp->u.state.pstr_prev;
+      MOP_OUT;
+      JUMP;
+
+    CASE(OP_FAIL_LOOK_BEHIND_NOT_VAR)  MOP_IN(OP_FAIL_LOOK_BEHIND_NOT_VAR);
+      stkp = stk;
+      do {
+	stkp--;
+	STACK_BASE_CHECK(stkp, "OP_FAIL_LOOK_BEHIND_NOT_VAR");
+      } while (stkp->type != STK_LOOK_BEHIND_NOT);
+      if (stkp->u.state.pstr != s) goto fail;
+
+      STACK_POP_TIL_LOOK_BEHIND_NOT;
+      goto fail;
+
+    CASE(OP_PUSH_ABSENT_POS)  MOP_IN(OP_PUSH_ABSENT_POS);
+      /* Save the absent-start-pos and the original end-pos. */
+      STACK_PUSH_ABSENT_POS(s, ABSENT_END_POS);
+      MOP_OUT;
+      JUMP;
+
+    CASE(OP_ABSENT)  MOP_IN(OP_ABSENT);
+      {
+	const UChar* aend = ABSENT_END_POS;
+	UChar* absent;
+	UChar* selfp = p - 1;
+
 	STACK_POP_ABSENT_POS(absent, ABSENT_END_POS);  /* Restore end-pos. */
 	GET_RELADDR_INC(addr, p);
 #ifdef ONIG_DEBUG_MATCH
@@ -3084,11 +4102,15 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
 	  }
 	  /* All possible points were found. Try matching after (?~...). */
 	  DATA_ENSURE(0);
+	  (void )MARK_EDGE(aend);
 	  p += addr;
 	}
 	else {
 	  STACK_PUSH_ALT(p + addr, s, sprev, pkeep); /* Push possible point. */
-	  n = enclen(encode, s, end);
+	  if (DATA_ENSURE_CHECK1)
+	    n = EXEC_ENCLEN(s, end);
+	  else
+	    n = 1;  /* no char at the end: the next iteration fails */
 	  STACK_PUSH_ABSENT_POS(absent, ABSENT_END_POS); /* Save the original pos. */
 	  STACK_PUSH_ALT(selfp, s + n, s, pkeep); /* Next iteration. */
 	  STACK_PUSH_ABSENT;
@@ -3109,10 +4131,64 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       STACK_POP_TIL_ABSENT;
       goto fail;
 
+    CASE(OP_ABSENT_EXACT)  MOP_IN(OP_ABSENT_EXACT);
+      {
+	/* Same result as OP_ABSENT with the string as the inner pattern:
+	 * the longest span ends at the last char of the first occurrence
+	 * of the string, and each shorter one is a possible point. */
+	const UChar* aend;
+	const UChar* peek;
+
+	GET_LENGTH_INC(tlen, p);
+	q = slow_search(encode, p, p + tlen, s,
+			ABSENT_END_POS, (UChar* )ABSENT_END_POS);
+	if (IS_NULL(q)) {
+	  aend = ABSENT_END_POS;
+	  (void )MARK_EDGE(aend);
+	}
+	else
+	  aend = onigenc_get_prev_char_head(encode, q, q + tlen, end);
+	p += tlen;
+
+	/* Like OP_ANYCHAR_STAR_PEEK_NEXT, don't push the points where
+	 * a following exact string can't match. */
+	switch (*p) {
+	case OP_EXACT1: case OP_EXACT2: case OP_EXACT3:
+	case OP_EXACT4: case OP_EXACT5:
+	case OP_EXACTMB2N1: case OP_EXACTMB2N2: case OP_EXACTMB2N3:
+	  peek = p + SIZE_OPCODE;
+	  break;
+	case OP_EXACTN: case OP_EXACTMB2N: case OP_EXACTMB3N:
+	  peek = p + SIZE_OPCODE + SIZE_LENGTH;
+	  break;
+	default:
+	  peek = NULL;
+	  break;
+	}
+
+	while (s < aend) {
+	  if (IS_NULL(peek) || *peek == *s)
+	    STACK_PUSH_ALT(p, s, sprev, pkeep);
+	  sprev = s;
+	  s += EXEC_ENCLEN(s, end);
+	}
+	if (s > aend) goto fail;
+      }
+      MOP_OUT;
+      JUMP;
+
 #ifdef USE_SUBEXP_CALL
     CASE(OP_CALL)  MOP_IN(OP_CALL);
       GET_ABSADDR_INC(addr, p);
-      STACK_PUSH_CALL_FRAME(p);
+      if (reg->p + addr == p + SIZE_OP_JUMP) {
+	/* the group entered in place, not a \g<name> */
+	STACK_PUSH_CALL_FRAME(p, CALL_LEVEL);
+      }
+      else {
+	if (SubexpCallDepthLimit != 0 && CALL_LEVEL >= SubexpCallDepthLimit)
+	  goto call_depth_error;
+	STACK_PUSH_CALL_FRAME(p, CALL_LEVEL + 1);
+      }
       p = reg->p + addr;
       MOP_OUT;
       JUMP;
@@ -3151,6 +4227,30 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
       sprev = stk->u.state.pstr_prev;
       pkeep = stk->u.state.pkeep;
 
+      if (stk->type == STK_SPAN) {
+	sprev = span_prev_char_head(span_mode, s);
+	if (sprev > stk->u.state.pstr_prev) {
+	  stk->u.state.pstr = sprev;
+	  STACK_INC;
+	}
+      }
+      else if (stk->type == STK_SPAN_PEEK ||
+	       stk->type == STK_SPAN_PEEK_LOOP) {
+	sprev = span_prev_char_head(span_mode, s);
+	q = span_search_byte_backward(stk->u.state.pstr_prev, sprev, *(p - 1));
+	if (stk->type == STK_SPAN_PEEK_LOOP) {
+	  /* p is the body of the loop, go on at its exit */
+	  UChar* pa = p - 1 - SIZE_RELADDR;
+
+	  GET_RELADDR_INC(addr, pa);
+	  p += addr;
+	}
+	if (IS_NOT_NULL(q)) {
+	  stk->u.state.pstr = q;
+	  STACK_INC;
+	}
+      }
+
 #ifdef USE_COMBINATION_EXPLOSION_CHECK
       if (stk->u.state.state_check != 0) {
 	stk->type = STK_STATE_CHECK_MARK;
@@ -3186,6 +4286,13 @@ match_at(regex_t* reg, const UChar* str, const UChar* end,
   STACK_SAVE;
   if (xmalloc_base) xfree(xmalloc_base);
   return ONIGERR_UNEXPECTED_BYTECODE;
+
+#ifdef USE_SUBEXP_CALL
+ call_depth_error:
+  STACK_SAVE;
+  if (xmalloc_base) xfree(xmalloc_base);
+  return ONIGERR_SUBEXP_CALL_DEPTH_LIMIT_OVER;
+#endif
 }
 
 
@@ -3274,33 +4381,79 @@ slow_search_ic(OnigEncoding enc, int case_fold_flag,
   return (UChar* )NULL;
 }
 
+#ifdef HAVE_MEMRCHR
+# define MEMRCHR(s,c,n)  memrchr((s), (c), (n))
+#else
+static void*
+onig_memrchr(const void* s, int c, size_t n)
+{
+  const UChar* p = (const UChar* )s + n;
+
+  while (p > (const UChar* )s) {
+    if (*--p == (UChar )c) return (void* )p;
+  }
+  return NULL;
+}
+# define MEMRCHR(s,c,n)  onig_memrchr((s), (c), (n))
+#endif
+
+/* The backward searches step bytes, not characters: a hit counts only
+   if it is the head of a character. */
+#define IS_BACKWARD_HIT(enc,adjust_text,s,text_end) \
+  (ONIGENC_MBC_MAXLEN(enc) == 1 ||\
+   ONIGENC_LEFT_ADJUST_CHAR_HEAD(enc, adjust_text, s, text_end) == (s))
+
 static UChar*
 slow_search_backward(OnigEncoding enc, UChar* target, UChar* target_end,
 		     const UChar* text, const UChar* adjust_text,
 		     const UChar* text_end, const UChar* text_start)
 {
-  UChar *t, *p, *s;
+  UChar *s;
+  size_t tlen1;
 
-  s = (UChar* )text_end;
-  s -= (target_end - target);
+  tlen1 = target_end - target - 1;
+  s = (UChar* )text_end - (tlen1 + 1);
   if (s > text_start)
     s = (UChar* )text_start;
-  else
-    s = ONIGENC_LEFT_ADJUST_CHAR_HEAD(enc, adjust_text, s, text_end);
 
   while (s >= text) {
-    if (*s == *target) {
-      p = s + 1;
-      t = target + 1;
-      while (t < target_end) {
-	if (*t != *p++)
-	  break;
-	t++;
-      }
-      if (t == target_end)
-	return s;
-    }
-    s = (UChar* )onigenc_get_prev_char_head(enc, adjust_text, s, text_end);
+    s = (UChar* )MEMRCHR(text, *target, s - text + 1);
+    if (IS_NULL(s)) break;
+
+    if ((tlen1 == 0 || memcmp(s + 1, target + 1, tlen1) == 0) &&
+	IS_BACKWARD_HIT(enc, adjust_text, s, text_end))
+      return s;
+
+    if (s == text) break;
+    s--;
+  }
+
+  return (UChar* )NULL;
+}
+
+/* Sunday's quick search run backward, with the skip stored with the regex */
+static UChar*
+bm_search_backward(regex_t* reg, const UChar* target, const UChar* target_end,
+		   const UChar* text, const UChar* adjust_text,
+		   const UChar* text_end, const UChar* text_start)
+{
+  const UChar *s, *skip;
+  size_t tlen;
+
+  tlen = target_end - target;
+  skip = BM_BACKWARD_SKIP(reg);
+  s = text_end - tlen;
+  if (s > text_start)
+    s = text_start;
+
+  while (s >= text) {
+    if (*s == *target && memcmp(s, target, tlen) == 0 &&
+	IS_BACKWARD_HIT(reg->enc, adjust_text, s, text_end))
+      return (UChar* )s;
+
+    if (s == text) break;
+    if ((size_t )(s - text) < skip[s[-1]]) break;
+    s -= skip[s[-1]];
   }
 
   return (UChar* )NULL;
@@ -3367,7 +4520,7 @@ bm_search_notrev(regex_t* reg, const UChar* target, const UChar* target_end,
     skip = reg->map[se[1]];
     t = s;
     do {
-      s += enclen(enc, s, end);
+      s += enc_kind_len(reg->enc_kind, enc, s, end);
     } while ((s - t) < skip && s < end);
   }
 
@@ -3443,7 +4596,7 @@ bm_search_notrev_ic(regex_t* reg, const UChar* target, const UChar* target_end,
     skip = reg->map[se[1]];
     t = s;
     do {
-      s += enclen(enc, s, end);
+      s += enc_kind_len(reg->enc_kind, enc, s, end);
     } while ((s - t) < skip && s < end);
   }
 
@@ -3486,15 +4639,16 @@ bm_search_ic(regex_t* reg, const UChar* target, const UChar* target_end,
 }
 
 static UChar*
-map_search(OnigEncoding enc, UChar map[],
-	   const UChar* text, const UChar* text_range, const UChar* text_end)
+map_search(regex_t* reg, const UChar* text, const UChar* text_range,
+	   const UChar* text_end)
 {
   const UChar *s = text;
+  UChar *map = reg->map;
 
   while (s < text_range) {
     if (map[*s]) return (UChar* )s;
 
-    s += enclen(enc, s, text_end);
+    s += enc_kind_len(reg->enc_kind, reg->enc, s, text_end);
   }
   return (UChar* )NULL;
 }
@@ -3505,24 +4659,65 @@ map_search_backward(OnigEncoding enc, UChar map[],
 		    const UChar* text_start, const UChar* text_end)
 {
   const UChar *s = text_start;
+  int n;
 
-  while (s >= text) {
-    if (map[*s]) return (UChar* )s;
+  /* no character starts at the end */
+  if (s >= text_end) {
+    if (text_end <= text) return (UChar* )NULL;
+    s = text_end - 1;
+  }
 
-    s = onigenc_get_prev_char_head(enc, adjust_text, s, text_end);
+  if (ONIGENC_MBC_MAXLEN(enc) == ONIGENC_MBC_MINLEN(enc)) {
+    n = ONIGENC_MBC_MINLEN(enc);
+    if (n > 1)
+      s = ONIGENC_LEFT_ADJUST_CHAR_HEAD(enc, adjust_text, s, text_end);
+    while (s >= text) {
+      if (map[*s]) return (UChar* )s;
+      if (s - text < n) break;
+      s -= n;
+    }
+    return (UChar* )NULL;
+  }
+
+  while (s >= text) {
+    if (map[*s] && IS_BACKWARD_HIT(enc, adjust_text, s, text_end))
+      return (UChar* )s;
+    if (s == text) break;
+    s--;
   }
   return (UChar* )NULL;
 }
 
+static OnigPosition
+match_in_place(regex_t* reg, const UChar* str, const UChar* end,
+	    const UChar* global_pos, const UChar* at, OnigRegion* region,
+	    OnigOptionType option, OnigMatchScratch* scratch);
+
 extern OnigPosition
 onig_match(regex_t* reg, const UChar* str, const UChar* end, const UChar* at, OnigRegion* region,
 	    OnigOptionType option)
+{
+  return onig_match_with_scratch(reg, str, end, at, region, option, NULL);
+}
+
+extern OnigPosition
+onig_match_with_scratch(regex_t* reg, const UChar* str, const UChar* end,
+	    const UChar* at, OnigRegion* region, OnigOptionType option,
+	    OnigMatchScratch* scratch)
+{
+  return match_in_place(reg, str, end, at, at, region, option, scratch);
+}
+
+static OnigPosition
+match_in_place(regex_t* reg, const UChar* str, const UChar* end,
+	    const UChar* global_pos, const UChar* at, OnigRegion* region,
+	    OnigOptionType option, OnigMatchScratch* scratch)
 {
   ptrdiff_t r;
   UChar *prev;
   OnigMatchArg msa;
 
-  MATCH_ARG_INIT(msa, option, region, at, at);
+  MATCH_ARG_INIT(msa, option, region, at, global_pos, scratch);
 #ifdef USE_COMBINATION_EXPLOSION_CHECK
   {
     int offset = at - str;
@@ -3569,7 +4764,7 @@ forward_search_range(regex_t* reg, const UChar* str, const UChar* end, UChar* s,
       UChar *q = p + reg->dmin;
 
       if (q >= end) return 0; /* fail */
-      while (p < q) p += enclen(reg->enc, p, end);
+      while (p < q) p += enc_kind_len(reg->enc_kind, reg->enc, p, end);
     }
   }
 
@@ -3600,7 +4795,7 @@ forward_search_range(regex_t* reg, const UChar* str, const UChar* end, UChar* s,
     break;
 
   case ONIG_OPTIMIZE_MAP:
-    p = map_search(reg->enc, reg->map, p, range, end);
+    p = map_search(reg, p, range, end);
     break;
   }
 
@@ -3608,7 +4803,7 @@ forward_search_range(regex_t* reg, const UChar* str, const UChar* end, UChar* s,
     if (p - reg->dmin < s) {
     retry_gate:
       pprev = p;
-      p += enclen(reg->enc, p, end);
+      p += enc_kind_len(reg->enc_kind, reg->enc, p, end);
       goto retry;
     }
 
@@ -3620,13 +4815,21 @@ forward_search_range(regex_t* reg, const UChar* str, const UChar* end, UChar* s,
 	if (!ON_STR_BEGIN(p)) {
 	  prev = onigenc_get_prev_char_head(reg->enc,
 					    (pprev ? pprev : str), p, end);
-	  if (!ONIGENC_IS_MBC_NEWLINE_EX(reg->enc, prev, str, end, reg->options, 0))
+	  if (!ONIGENC_IS_MBC_NEWLINE_EX(reg->enc, prev, str, end, reg->options, 0)) {
+	    if (IS_NEWLINE_LF_BYTE(reg)) {
+	      /* skip to the next line */
+	      pprev = (UChar* )memchr(p, 0x0a, range - p);
+	      if (IS_NULL(pprev)) return 0; /* fail */
+	      p = pprev + 1;
+	      goto retry;
+	    }
 	    goto retry_gate;
+	  }
 	}
 	break;
 
       case ANCHOR_END_LINE:
-	if (ON_STR_END(p)) {
+	if (p == end) {
 #ifndef USE_NEWLINE_AT_END_OF_STRING_HAS_EMPTY_LINE
 	  prev = (UChar* )onigenc_get_prev_char_head(reg->enc,
 					    (pprev ? pprev : str), p);
@@ -3696,6 +4899,7 @@ backward_search_range(regex_t* reg, const UChar* str, const UChar* end,
 		      UChar** low, UChar** high)
 {
   UChar *p;
+  const UChar* first = range;
 
   range += reg->dmin;
   p = s;
@@ -3718,7 +4922,11 @@ backward_search_range(regex_t* reg, const UChar* str, const UChar* end,
 
   case ONIG_OPTIMIZE_EXACT_BM:
   case ONIG_OPTIMIZE_EXACT_BM_NOT_REV:
-    goto exact_method;
+    if (p - range < BM_BACKWARD_SEARCH_LENGTH_THRESHOLD)
+      goto exact_method;
+
+    p = bm_search_backward(reg, reg->exact, reg->exact_end,
+			   range, adjrange, end, p);
     break;
 
   case ONIG_OPTIMIZE_MAP:
@@ -3742,7 +4950,7 @@ backward_search_range(regex_t* reg, const UChar* str, const UChar* end,
 	break;
 
       case ANCHOR_END_LINE:
-	if (ON_STR_END(p)) {
+	if (p == end) {
 #ifndef USE_NEWLINE_AT_END_OF_STRING_HAS_EMPTY_LINE
 	  prev = onigenc_get_prev_char_head(reg->enc, adjrange, p);
 	  if (IS_NULL(prev)) goto fail;
@@ -3763,7 +4971,11 @@ backward_search_range(regex_t* reg, const UChar* str, const UChar* end,
 
     /* no needs to adjust *high, *high is used as range check only */
     if (reg->dmax != ONIG_INFINITE_DISTANCE) {
-      *low  = p - reg->dmax;
+      /* no start before the range */
+      if ((OnigDistance )(p - first) > reg->dmax)
+	*low = p - reg->dmax;
+      else
+	*low = (UChar* )first;
       *high = p - reg->dmin;
       *high = onigenc_get_right_adjust_char_head(reg->enc, adjrange, *high, end);
     }
@@ -3783,26 +4995,88 @@ backward_search_range(regex_t* reg, const UChar* str, const UChar* end,
 }
 
 
+/* A search of a part [str, end) of a longer subject.  data_range, if not
+   NULL, bounds the text a match may take instead of start (backward
+   search) or range (forward search).  With partial, end is not the end
+   of the subject: the search stops at the first start whose match looked
+   at end, since the text after it may change the result, and sets edge
+   to it; range is then the last start to try. */
+typedef struct {
+  const UChar* data_range;
+  int partial;
+  const UChar* edge;
+} SearchPart;
+
+static OnigPosition
+search_in_range(regex_t* reg, const UChar* str, const UChar* end,
+	    const UChar* global_pos,
+	    const UChar* start, const UChar* range, SearchPart* part,
+	    OnigRegion* region, OnigOptionType option,
+	    OnigMatchScratch* scratch);
+
 extern OnigPosition
 onig_search(regex_t* reg, const UChar* str, const UChar* end,
 	    const UChar* start, const UChar* range, OnigRegion* region, OnigOptionType option)
 {
-  return onig_search_gpos(reg, str, end, start, start, range, region, option);
+  return search_in_range(reg, str, end, start, start, range, NULL, region,
+			 option, NULL);
 }
 
 extern OnigPosition
 onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
 	    const UChar* global_pos,
 	    const UChar* start, const UChar* range, OnigRegion* region, OnigOptionType option)
+{
+  return search_in_range(reg, str, end, global_pos, start, range, NULL,
+			 region, option, NULL);
+}
+
+extern OnigPosition
+onig_search_with_scratch(regex_t* reg, const UChar* str, const UChar* end,
+	    const UChar* start, const UChar* range, OnigRegion* region,
+	    OnigOptionType option, OnigMatchScratch* scratch)
+{
+  return search_in_range(reg, str, end, start, start, range, NULL, region,
+			 option, scratch);
+}
+
+/* The starts from which the literal the optimizer looks for may lie at
+   end or after it: in a part of a subject these are tried one by one. */
+static UChar*
+partial_tail(regex_t* reg, const UChar* str, const UChar* end)
+{
+  OnigDistance d;
+
+  if (reg->dmax == ONIG_INFINITE_DISTANCE) return (UChar* )str;
+  d = reg->dmax +
+      (OnigDistance )(reg->exact_end - reg->exact + 2) * ONIGENC_MBC_MAXLEN(reg->enc);
+  if ((OnigDistance )(end - str) <= d) return (UChar* )str;
+  return ONIGENC_LEFT_ADJUST_CHAR_HEAD(reg->enc, str, end - d, end);
+}
+
+static OnigPosition
+search_in_range(regex_t* reg, const UChar* str, const UChar* end,
+	    const UChar* global_pos,
+	    const UChar* start, const UChar* range, SearchPart* part,
+	    OnigRegion* region, OnigOptionType option,
+	    OnigMatchScratch* scratch)
 {
   ptrdiff_t r;
   UChar *s, *prev;
   OnigMatchArg msa;
+  int partial = IS_NOT_NULL(part) && part->partial;
 #ifdef USE_MATCH_RANGE_MUST_BE_INSIDE_OF_SPECIFIED_RANGE
   const UChar *orig_start = start;
   const UChar *orig_range = range;
+
+  if (IS_NOT_NULL(part) && IS_NOT_NULL(part->data_range)) {
+    if (range > start) orig_range = part->data_range;
+    else orig_start = part->data_range;
+  }
 #endif
 
+  if (partial) part->edge = NULL;
+
 #ifdef ONIG_DEBUG_SEARCH
   fprintf(stderr,
      "onig_search (entry point): str: %"PRIuPTR" (%p), end: %"PRIuPTR", start: %"PRIuPTR", range: %"PRIuPTR"\n",
@@ -3817,21 +5091,35 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
   if (start > end || start < str) goto mismatch_no_msa;
 
 
+#ifdef USE_FIND_LONGEST_SEARCH_ALL_OF_RANGE
+  /* No later start can beat the best match found so far: no match is
+     longer than reg->max_len, and a forward search only has the rest
+     of the string left. */
+# define LONGEST_IS_FINAL(s) \
+  (msa.best_len >= 0 &&\
+   ((OnigDistance )msa.best_len >= reg->max_len ||\
+    (range > start && ! partial && msa.best_len >= end - (s))))
+#endif
+
 #ifdef USE_MATCH_RANGE_MUST_BE_INSIDE_OF_SPECIFIED_RANGE
 # ifdef USE_FIND_LONGEST_SEARCH_ALL_OF_RANGE
 #  define MATCH_AND_RETURN_CHECK(upper_range) \
   r = match_at(reg, str, end, (upper_range), s, prev, &msa); \
+  if (msa.edge) goto edge;\
   if (r != ONIG_MISMATCH) {\
     if (r >= 0) {\
-      if (! IS_FIND_LONGEST(reg->options)) {\
+      if (! IS_FIND_LONGEST(reg->options) ||\
+          IS_LEFTMOST_LONGEST(reg->options)) {\
         goto match;\
       }\
     }\
     else goto finish; /* error */ \
-  }
+  }\
+  if (LONGEST_IS_FINAL(s)) goto mismatch;
 # else
 #  define MATCH_AND_RETURN_CHECK(upper_range) \
   r = match_at(reg, str, end, (upper_range), s, prev, &msa); \
+  if (msa.edge) goto edge;\
   if (r != ONIG_MISMATCH) {\
     if (r >= 0) {\
       goto match;\
@@ -3843,17 +5131,21 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
 # ifdef USE_FIND_LONGEST_SEARCH_ALL_OF_RANGE
 #  define MATCH_AND_RETURN_CHECK(none) \
   r = match_at(reg, str, end, s, prev, &msa);\
+  if (msa.edge) goto edge;\
   if (r != ONIG_MISMATCH) {\
     if (r >= 0) {\
-      if (! IS_FIND_LONGEST(reg->options)) {\
+      if (! IS_FIND_LONGEST(reg->options) ||\
+          IS_LEFTMOST_LONGEST(reg->options)) {\
         goto match;\
       }\
     }\
     else goto finish; /* error */ \
-  }
+  }\
+  if (LONGEST_IS_FINAL(s)) goto mismatch;
 # else
 #  define MATCH_AND_RETURN_CHECK(none) \
   r = match_at(reg, str, end, s, prev, &msa);\
+  if (msa.edge) goto edge;\
   if (r != ONIG_MISMATCH) {\
     if (r >= 0) {\
       goto match;\
@@ -3899,6 +5191,10 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
 	  goto mismatch_no_msa;
       }
     }
+    else if ((reg->anchor & (ANCHOR_END_BUF | ANCHOR_SEMI_END_BUF)) &&
+	     partial) {
+      /* the end of the subject is not in the part */
+    }
     else if (reg->anchor & ANCHOR_END_BUF) {
       min_semi_end = max_semi_end = (UChar* )end;
 
@@ -3966,12 +5262,13 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
     fprintf(stderr, "onig_search: empty string.\n");
 #endif
 
-    if (reg->threshold_len == 0) {
+    if (reg->threshold_len == 0 || partial) {
       start = end = str = address_for_empty_string;
       s = (UChar* )start;
       prev = (UChar* )NULL;
 
-      MATCH_ARG_INIT(msa, option, region, start, start);
+      MATCH_ARG_INIT(msa, option, region, start, start, scratch);
+      if (partial) msa.edge_end = end;
 #ifdef USE_COMBINATION_EXPLOSION_CHECK
       msa.state_check_buff = (void* )0;
       msa.state_check_buff_size = 0;   /* NO NEED, for valgrind */
@@ -3987,7 +5284,8 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
 	  (int )(end - str), (int )(start - str), (int )(range - str));
 #endif
 
-  MATCH_ARG_INIT(msa, option, region, start, global_pos);
+  MATCH_ARG_INIT(msa, option, region, start, global_pos, scratch);
+  if (partial) msa.edge_end = end;
 #ifdef USE_COMBINATION_EXPLOSION_CHECK
   {
     int offset = (MIN(start, range) - str);
@@ -4003,7 +5301,14 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
       prev = (UChar* )NULL;
 
     if (reg->optimize != ONIG_OPTIMIZE_NONE) {
-      UChar *sch_range, *low, *high, *low_prev;
+      UChar *sch_range, *low, *high, *low_prev, *tail;
+
+      /* the optimizer skips starts up to tail, the rest are tried */
+      tail = (UChar* )range;
+      if (partial) {
+	tail = partial_tail(reg, str, end);
+	if (tail > range) tail = (UChar* )range;
+      }
 
       sch_range = (UChar* )range;
       if (reg->dmax != 0) {
@@ -4015,43 +5320,66 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
 	}
       }
 
-      if ((end - start) < reg->threshold_len)
+      if ((end - start) < reg->threshold_len && ! partial)
 	goto mismatch;
 
       if (reg->dmax != ONIG_INFINITE_DISTANCE) {
-	do {
+	while (s < tail) {
 	  if (! forward_search_range(reg, str, end, s, sch_range,
-				     &low, &high, &low_prev)) goto mismatch;
+				     &low, &high, &low_prev) || low >= tail) {
+	    if (! partial) goto mismatch;
+	    s    = tail;
+	    prev = onigenc_get_prev_char_head(reg->enc, str, s, end);
+	    break;
+	  }
 	  if (s < low) {
 	    s    = low;
 	    prev = low_prev;
 	  }
+	  if (partial && high >= tail)
+	    high = tail - 1;
 	  while (s <= high) {
 	    MATCH_AND_RETURN_CHECK(orig_range);
 	    prev = s;
-	    s += enclen(reg->enc, s, end);
+	    s += enc_kind_len(reg->enc_kind, reg->enc, s, end);
 	  }
-	} while (s < range);
-	goto mismatch;
+	}
+	if (! partial) goto mismatch;
       }
       else { /* check only. */
 	if (! forward_search_range(reg, str, end, s, sch_range,
-				   &low, &high, (UChar** )NULL)) goto mismatch;
+				   &low, &high, (UChar** )NULL) && ! partial)
+	  goto mismatch;
 
 	if ((reg->anchor & ANCHOR_ANYCHAR_STAR) != 0) {
 	  do {
 	    MATCH_AND_RETURN_CHECK(orig_range);
 	    prev = s;
-	    s += enclen(reg->enc, s, end);
+	    s += enc_kind_len(reg->enc_kind, reg->enc, s, end);
 
 	    if ((reg->anchor & (ANCHOR_LOOK_BEHIND | ANCHOR_PREC_READ_NOT)) == 0) {
-	      while (!ONIGENC_IS_MBC_NEWLINE_EX(reg->enc, prev, str, end, reg->options, 0)
-		  && s < range) {
-		prev = s;
-		s += enclen(reg->enc, s, end);
+	      if (IS_NEWLINE_LF_BYTE(reg)) {
+		if (*prev != 0x0a && s < range) {
+		  prev = (UChar* )memchr(s, 0x0a, range - s);
+		  if (IS_NULL(prev)) goto mismatch;
+		  s = prev + 1;
+		}
+	      }
+	      else {
+		while (!ONIGENC_IS_MBC_NEWLINE_EX(reg->enc, prev, str, end, reg->options, 0)
+		    && s < range) {
+		  prev = s;
+		  s += enc_kind_len(reg->enc_kind, reg->enc, s, end);
+		}
 	      }
 	    }
 	  } while (s < range);
+	  /* in a part, range is the last start to try */
+	  if (partial && s == range &&
+	      ((reg->anchor & (ANCHOR_LOOK_BEHIND | ANCHOR_PREC_READ_NOT)) != 0 ||
+	       ONIGENC_IS_MBC_NEWLINE_EX(reg->enc, prev, str, end, reg->options, 0))) {
+	    MATCH_AND_RETURN_CHECK(orig_range);
+	  }
 	  goto mismatch;
 	}
       }
@@ -4060,7 +5388,7 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
     do {
       MATCH_AND_RETURN_CHECK(orig_range);
       prev = s;
-      s += enclen(reg->enc, s, end);
+      s += enc_kind_len(reg->enc_kind, reg->enc, s, end);
     } while (s < range);
 
     if (s == range) { /* because empty match with /$/. */
@@ -4071,6 +5399,18 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
     if (reg->optimize != ONIG_OPTIMIZE_NONE) {
       UChar *low, *high, *adjrange, *sch_start;
 
+      if (partial) {
+	/* the starts whose literal may lie at end or after it first */
+	UChar* tail = partial_tail(reg, str, end);
+
+	while (s >= range && s >= tail) {
+	  prev = onigenc_get_prev_char_head(reg->enc, str, s, end);
+	  MATCH_AND_RETURN_CHECK(orig_start);
+	  s = prev;
+	}
+	if (s < range) goto mismatch;
+      }
+
       if (range < end)
 	adjrange = ONIGENC_LEFT_ADJUST_CHAR_HEAD(reg->enc, str, range, end);
       else
@@ -4087,6 +5427,8 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
 
 	  if (s > high)
 	    s = high;
+	  if (partial && low < range)
+	    low = (UChar* )range;
 
 	  while (s >= low) {
 	    prev = onigenc_get_prev_char_head(reg->enc, str, s, end);
@@ -4097,7 +5439,7 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
 	goto mismatch;
       }
       else { /* check only. */
-	if ((end - range) < reg->threshold_len) goto mismatch;
+	if ((end - range) < reg->threshold_len && ! partial) goto mismatch;
 
 	sch_start = s;
 	if (reg->dmax != 0) {
@@ -4112,7 +5454,7 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
 	  }
 	}
 	if (backward_search_range(reg, str, end, sch_start, range, adjrange,
-				  &low, &high) <= 0) goto mismatch;
+				  &low, &high) <= 0 && ! partial) goto mismatch;
       }
     }
 
@@ -4133,6 +5475,11 @@ onig_search_gpos(regex_t* reg, const UChar* str, const UChar* end,
   }
 #endif
   r = ONIG_MISMATCH;
+  goto finish;
+
+ edge:
+  part->edge = s;
+  r = ONIG_MISMATCH;
 
  finish:
   MATCH_ARG_FREE(msa);
@@ -4186,7 +5533,7 @@ onig_scan(regex_t* reg, const UChar* str, const UChar* end,
 
       if (region->end[0] == start - str) {
 	if (start >= end) break;
-	start += enclen(reg->enc, start, end);
+	start += enc_kind_len(reg->enc_kind, reg->enc, start, end);
       }
       else
 	start = str + region->end[0];
@@ -4205,6 +5552,527 @@ onig_scan(regex_t* reg, const UChar* str, const UChar* end,
   return n;
 }
 
+/* Every start position of a match, not only those of the matches
+   onig_scan() reports.  With starts, only these positions are tried:
+   the starts of a regex made by onig_new_append() are among those of
+   the regex it extends, so each keystroke of an incremental search
+   matches at the previous starts instead of searching the text. */
+extern OnigPosition
+onig_scan_starts(regex_t* reg, const UChar* str, const UChar* end,
+	  const OnigPosition* starts, OnigPosition num_starts,
+	  OnigRegion* region, OnigOptionType option,
+	  int (*scan_callback)(OnigPosition, OnigPosition, OnigRegion*, void*),
+	  void* callback_arg)
+{
+  OnigPosition r;
+  OnigPosition n, i;
+  int rs;
+  const UChar* start;
+  OnigMatchScratch* scratch;
+
+  if (IS_NOT_NULL(starts)) {
+    for (i = 0; i < num_starts; i++) {
+      if (starts[i] < 0 || starts[i] > end - str)
+	return ONIGERR_INVALID_ARGUMENT;
+    }
+  }
+
+  scratch = onig_match_scratch_new();
+  CHECK_NULL_RETURN_MEMERR(scratch);
+
+  r = ONIG_MISMATCH;
+  n = 0;
+  if (IS_NULL(starts) && IS_FIND_LONGEST(reg->options) &&
+      ! IS_LEFTMOST_LONGEST(reg->options)) {
+    /* a search returns the start of the longest match, which may not be
+       the leftmost one: try every position */
+    for (start = str; ; start += enc_kind_len(reg->enc_kind, reg->enc,
+					       start, end)) {
+      r = match_in_place(reg, str, end, str, start, region, option, scratch);
+      if (r >= 0) {
+	rs = scan_callback(n, start - str, region, callback_arg);
+	n++;
+	if (rs != 0) {
+	  r = rs;
+	  goto end;
+	}
+      }
+      else if (r != ONIG_MISMATCH)
+	break;
+      if (start >= end) break;
+    }
+  }
+  else if (IS_NULL(starts)) {
+    start = str;
+    while (1) {
+      r = search_in_range(reg, str, end, str, start, end, NULL,
+			  region, option, scratch);
+      if (r < 0) break;
+
+      rs = scan_callback(n, r, region, callback_arg);
+      n++;
+      if (rs != 0) {
+	r = rs;
+	goto end;
+      }
+      if (r >= end - str) break;
+      start = str + r;
+      start += enc_kind_len(reg->enc_kind, reg->enc, start, end);
+    }
+  }
+  else {
+    for (i = 0; i < num_starts; i++) {
+      r = match_in_place(reg, str, end, str, str + starts[i],
+			 region, option, scratch);
+      if (r < 0) {
+	if (r == ONIG_MISMATCH) continue;
+	break;
+      }
+
+      rs = scan_callback(n, starts[i], region, callback_arg);
+      n++;
+      if (rs != 0) {
+	r = rs;
+	goto end;
+      }
+    }
+  }
+  if (r >= 0 || r == ONIG_MISMATCH) r = n;
+
+ end:
+  onig_match_scratch_free(scratch);
+  return r;
+}
+
+/* Searching a subject stored in pieces (a gap buffer, a piece table).
+   match_at() and the encodings address the subject through plain
+   pointers, so the seams are handled here.  The starts of a segment are
+   searched in place as a part of the subject (see SearchPart) until a
+   match looks at the end of the segment.  From that start on a copy of
+   the text around the seam is searched, and the copy is grown while a
+   match still looks at its end, so only as much text is copied as the
+   matches read.  Encodings whose character heads can't be told apart
+   (Shift_JIS, EUC-JP) are searched in a joined copy of the subject. */
+
+typedef struct {
+  const UChar* p;
+  OnigPosition off;         /* offset of the segment in the subject */
+} SegPart;
+
+typedef struct {
+  regex_t* reg;
+  SegPart* parts;           /* non-empty segments, then the end */
+  int n;
+  int unit;                 /* alignment of characters */
+  OnigDistance behind;      /* bytes a match may read before its start */
+  UChar* buf;               /* copy of the text around a seam */
+  OnigPosition bufsize;
+} SegSubject;
+
+#define SEG_TOTAL(st)   ((st)->parts[(st)->n].off)
+
+static int
+seg_unit(regex_t* reg)
+{
+  switch (reg->enc_kind) {
+  case ENC_KIND_SINGLE_BYTE:
+  case ENC_KIND_UTF8:
+    return 1;
+  case ENC_KIND_UTF16LE:
+    return 2;
+  }
+#ifndef RUBY
+  if (reg->enc == ONIG_ENCODING_UTF16_BE)
+    return 2;
+  if (reg->enc == ONIG_ENCODING_UTF32_LE || reg->enc == ONIG_ENCODING_UTF32_BE)
+    return 4;
+#endif
+  return 0;
+}
+
+static int
+seg_index(const SegSubject* st, OnigPosition x)
+{
+  int low = 0, high = st->n - 1;
+
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (st->parts[mid].off <= x) low = mid;
+    else high = mid - 1;
+  }
+  return low;
+}
+
+static UChar
+seg_byte(const SegSubject* st, OnigPosition x)
+{
+  int i = seg_index(st, x);
+  return st->parts[i].p[x - st->parts[i].off];
+}
+
+static void
+seg_copy(const SegSubject* st, OnigPosition lo, OnigPosition hi, UChar* buf)
+{
+  int i = seg_index(st, lo);
+
+  while (lo < hi) {
+    OnigPosition e = MIN(hi, st->parts[i + 1].off);
+    xmemcpy(buf, st->parts[i].p + (lo - st->parts[i].off), e - lo);
+    buf += e - lo;
+    lo = e;
+    i++;
+  }
+}
+
+/* is the code unit at x (aligned) the tail of a character? */
+static int
+seg_is_trail(const SegSubject* st, OnigPosition x)
+{
+  UChar c;
+
+  if (x >= SEG_TOTAL(st)) return 0;
+  switch (st->reg->enc_kind) {
+  case ENC_KIND_UTF8:
+    return (seg_byte(st, x) & 0xc0) == 0x80;
+  case ENC_KIND_UTF16LE:
+    if (x + 1 >= SEG_TOTAL(st)) return 0;
+    c = seg_byte(st, x + 1);
+    return c >= 0xdc && c <= 0xdf;
+  }
+#ifndef RUBY
+  if (st->reg->enc == ONIG_ENCODING_UTF16_BE) {
+    c = seg_byte(st, x);
+    return c >= 0xdc && c <= 0xdf;
+  }
+#endif
+  return 0;
+}
+
+static OnigPosition
+seg_left_head(const SegSubject* st, OnigPosition x)
+{
+  x -= x % st->unit;
+  while (x > 0 && seg_is_trail(st, x))
+    x -= st->unit;
+  return x;
+}
+
+static OnigPosition
+seg_right_head(const SegSubject* st, OnigPosition x)
+{
+  x += (st->unit - x % st->unit) % st->unit;
+  while (x < SEG_TOTAL(st) && seg_is_trail(st, x))
+    x += st->unit;
+  return MIN(x, SEG_TOTAL(st));
+}
+
+/* the start of the text read by matches starting at x or after */
+static OnigPosition
+seg_behind_start(const SegSubject* st, OnigPosition x)
+{
+  return seg_left_head(st, (OnigDistance )x > st->behind ? x - st->behind : 0);
+}
+
+/* the first position whose match reads nothing before s, or past the
+   end */
+static OnigPosition
+seg_behind_first(const SegSubject* st, OnigPosition s)
+{
+  if ((OnigDistance )(SEG_TOTAL(st) - s) <= st->behind)
+    return SEG_TOTAL(st) + 1;
+  return seg_right_head(st, s + st->behind);
+}
+
+#ifdef USE_CAPTURE_HISTORY
+static void
+history_tree_shift(OnigCaptureTreeNode* node, OnigPosition d)
+{
+  int i;
+
+  node->beg += d;
+  node->end += d;
+  for (i = 0; i < node->num_childs; i++)
+    history_tree_shift(node->childs[i], d);
+}
+#endif
+
+static void
+region_shift(OnigRegion* region, OnigPosition d)
+{
+  int i;
+
+  for (i = 0; i < region->num_regs; i++) {
+    if (region->beg[i] != ONIG_REGION_NOTPOS) {
+      region->beg[i] += d;
+      region->end[i] += d;
+    }
+  }
+#ifdef USE_CAPTURE_HISTORY
+  if (IS_NOT_NULL(region->history_root))
+    history_tree_shift(region->history_root, d);
+#endif
+}
+
+static OnigPosition
+seg_search_joined(regex_t* reg, const SegSubject* st,
+		  OnigPosition start, OnigPosition range,
+		  OnigRegion* region, OnigOptionType option)
+{
+  static const UChar empty[] = "";
+  OnigPosition r, total = SEG_TOTAL(st);
+  const UChar* str;
+  UChar* buf = NULL;
+
+  if (st->n == 0)
+    str = empty;
+  else if (st->n == 1)
+    str = st->parts[0].p;
+  else {
+    buf = (UChar* )xmalloc(total);
+    CHECK_NULL_RETURN_MEMERR(buf);
+    seg_copy(st, 0, total, buf);
+    str = buf;
+  }
+
+  r = search_in_range(reg, str, str + total, str + start, str + start,
+		      str + range, NULL, region, option, NULL);
+  if (IS_NOT_NULL(buf)) xfree(buf);
+  return r;
+}
+
+/* Search the starts ps to pr (both included) in the text [blo, bhi):
+   in place in the segment i, or in a copy if i < 0.  Set *edge to the
+   start whose match looked at bhi, or -1. */
+static OnigPosition
+seg_search_part(SegSubject* st, int i, OnigPosition blo, OnigPosition bhi,
+		OnigPosition ps, OnigPosition pr, OnigPosition data,
+		OnigPosition gpos, OnigRegion* region, OnigOptionType option,
+		OnigPosition* edge)
+{
+  OnigPosition r;
+  const UChar* str;
+  SearchPart part;
+
+  if (i >= 0)
+    str = st->parts[i].p + (blo - st->parts[i].off);
+  else {
+    if (st->bufsize < bhi - blo) {
+      UChar* tmp = (UChar* )xrealloc(st->buf, bhi - blo);
+      CHECK_NULL_RETURN_MEMERR(tmp);
+      st->buf = tmp;
+      st->bufsize = bhi - blo;
+    }
+    seg_copy(st, blo, bhi, st->buf);
+    str = st->buf;
+  }
+
+  gpos = MIN(MAX(gpos, blo), bhi);
+  part.data_range = str + (data - blo);
+  part.partial = (bhi < SEG_TOTAL(st));
+  r = search_in_range(st->reg, str, str + (bhi - blo), str + (gpos - blo),
+		      str + (ps - blo), str + (pr - blo), &part,
+		      region, option, NULL);
+  if (r >= 0) {
+    r += blo;
+    if (region) region_shift(region, blo);
+  }
+  *edge = (part.partial && IS_NOT_NULL(part.edge)) ? blo + (part.edge - str) : -1;
+  return r;
+}
+
+extern OnigPosition
+onig_search_segments(regex_t* reg, const OnigSegment* segs, int num_segs,
+		     OnigPosition start, OnigPosition range,
+		     OnigRegion* region, OnigOptionType option)
+{
+  int i, forward, longest;
+  OnigPosition r, total, first, last, pos, w, w0, edge_pos;
+  OnigPosition best, best_len;
+  OnigRegion *rg, tmp, best_region;
+  SegSubject st;
+
+  if (num_segs < 0) return ONIGERR_INVALID_ARGUMENT;
+
+  st.reg = reg;
+  st.n = 0;
+  st.buf = NULL;
+  st.bufsize = 0;
+  st.parts = (SegPart* )xmalloc(sizeof(SegPart) * (num_segs + 1));
+  CHECK_NULL_RETURN_MEMERR(st.parts);
+  total = 0;
+  for (i = 0; i < num_segs; i++) {
+    if (segs[i].end < segs[i].p) {
+      r = ONIGERR_INVALID_ARGUMENT;
+      goto end;
+    }
+    if (segs[i].end == segs[i].p) continue;
+    st.parts[st.n].p = segs[i].p;
+    st.parts[st.n].off = total;
+    total += segs[i].end - segs[i].p;
+    st.n++;
+  }
+  st.parts[st.n].p = NULL;
+  st.parts[st.n].off = total;
+
+  if (start < 0 || start > total) {
+    if (region) {
+      r = onig_region_resize_clear(region, reg->num_mem + 1);
+      if (r) goto end;
+    }
+    r = ONIG_MISMATCH;
+    goto end;
+  }
+  if (range < 0) range = 0;
+  if (range > total) range = total;
+
+  st.unit = seg_unit(reg);
+  st.behind = reg->reach_behind;
+  if (st.behind != ONIG_INFINITE_DISTANCE)  /* and peeks of \b, ^, ... */
+    st.behind += ONIGENC_MBC_MAXLEN(reg->enc) * 4;
+
+  if (st.n <= 1 || st.unit == 0 || st.behind >= (OnigDistance )total) {
+    r = seg_search_joined(reg, &st, start, range, region, option);
+    goto end;
+  }
+
+  /* the starts to try, from first to last */
+  forward = (range >= start);
+  first = start;
+  last  = range;
+  /* in the order of search_in_range() */
+  if (reg->anchor & ANCHOR_BEGIN_POSITION) {
+    last = first;
+  }
+  else if (reg->anchor & ANCHOR_BEGIN_BUF) {
+    if (forward ? start != 0 : range != 0) goto mismatch;
+    first = last = 0;
+  }
+  else if (reg->anchor & (ANCHOR_END_BUF | ANCHOR_SEMI_END_BUF)) {
+    if (reg->anchor_dmax != ONIG_INFINITE_DISTANCE) {
+      OnigDistance d = reg->anchor_dmax + ONIGENC_MBC_MAXLEN(reg->enc) * 4;
+      OnigPosition low = ((OnigDistance )total > d ? total - d : 0);
+
+      if (forward) first = MAX(first, low);
+      else last = MAX(last, low);
+      if (forward ? first > last : first < last) goto mismatch;
+    }
+  }
+  else if (reg->anchor & ANCHOR_ANYCHAR_STAR_ML) {
+    last = first;
+  }
+
+  longest = IS_FIND_LONGEST(reg->options) && ! IS_LEFTMOST_LONGEST(reg->options);
+  rg = region;
+  if (longest) {
+    onig_region_init(&tmp);
+    onig_region_init(&best_region);
+    rg = &tmp;
+  }
+  best = ONIG_MISMATCH;
+  best_len = -1;
+
+  w0 = (OnigPosition )st.behind * 2 + 256;
+  w = w0;
+  edge_pos = -1;
+  pos = first;
+  while (1) {
+    OnigPosition lo, hi, blo, bhi, pr, data, edge;
+
+    i = seg_index(&st, pos);
+    lo = (i == 0 ? 0 : seg_behind_first(&st, seg_right_head(&st, st.parts[i].off)));
+    hi = (i == st.n - 1 ? total : seg_left_head(&st, st.parts[i + 1].off));
+    if (pos != edge_pos && lo <= pos && (pos < hi || hi == total)) {
+      /* in place */
+      blo = (i == 0 ? 0 : seg_right_head(&st, st.parts[i].off));
+      bhi = hi;  /* no char cut by the seam */
+      if (forward)
+	pr = MIN(last, hi == total ? total : seg_left_head(&st, hi - 1));
+      else
+	pr = MAX(last, lo);
+    }
+    else {
+      i = -1;
+      bhi = seg_right_head(&st, MIN(total, pos + w));
+      if (forward) {
+	lo = pos;
+	pr = MIN(last, bhi == total ? total : seg_left_head(&st, bhi - 1));
+      }
+      else {
+	lo = MAX(last, seg_left_head(&st, pos > w ? pos - w : 0));
+	pr = lo;
+      }
+      blo = seg_behind_start(&st, lo);
+    }
+    data = MIN(forward ? range : start, bhi);
+
+    r = seg_search_part(&st, i, blo, bhi, pos, pr, data, start, rg, option,
+			&edge);
+    while (longest && edge >= 0 && edge != pos) {
+      /* the best match of the starts before the (first) edge */
+      OnigPosition before = (forward ? seg_left_head(&st, edge - 1)
+			     : seg_right_head(&st, edge + 1));
+
+      r = seg_search_part(&st, i, blo, bhi, pos, before, data, start, rg,
+			  option, &edge);
+      if (edge < 0) {
+	edge = (forward ? seg_right_head(&st, before + 1)
+		: seg_left_head(&st, before - 1));
+	break;
+      }
+    }
+    if (r >= 0 && longest) {
+      OnigPosition len = rg->end[0] - r;
+
+      if (len > best_len) {
+	best = r;
+	best_len = len;
+	onig_region_copy(&best_region, rg);
+      }
+      if ((OnigDistance )best_len >= reg->max_len) break;
+    }
+    else if (r != ONIG_MISMATCH)
+      break;
+
+    if (edge >= 0) {
+      if (forward ? edge > last : edge < last) break;
+      w = MAX(w0, 2 * (bhi - edge));
+      pos = edge_pos = edge;
+      continue;
+    }
+    if (pr == last) break;
+    pos = (forward ? seg_right_head(&st, pr + 1) : seg_left_head(&st, pr - 1));
+    if (forward ? pos > last : pos < last) break;  /* last in a char */
+    w = w0;
+    edge_pos = -1;
+  }
+
+  if (longest) {
+    if (r >= 0 || r == ONIG_MISMATCH) {
+      r = best;
+      if (region) {
+	if (best >= 0)
+	  onig_region_copy(region, &best_region);
+	else
+	  onig_region_resize_clear(region, reg->num_mem + 1);
+      }
+    }
+    onig_region_free(&tmp, 0);
+    onig_region_free(&best_region, 0);
+  }
+  goto end;
+
+ mismatch:
+  r = ONIG_MISMATCH;
+  if (region) {
+    i = onig_region_resize_clear(region, reg->num_mem + 1);
+    if (i) r = i;
+  }
+ end:
+  if (IS_NOT_NULL(st.buf)) xfree(st.buf);
+  xfree(st.parts);
+  return r;
+}
+
 extern OnigEncoding
 onig_get_encoding(const regex_t* reg)
 {
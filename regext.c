@@ -92,6 +92,57 @@ conv_swap2bytes(const UChar* s, const UChar* end, UChar* conv)
   }
 }
 
+/* Re-encode a pattern between two Unicode encodings (or from ASCII/ISO-8859-1
+   to a Unicode encoding) code point by code point, so that a pattern written
+   in one encoding can be compiled for subjects in another. */
+static int
+conv_unicode(OnigEncoding from, OnigEncoding to, const UChar* s, const UChar* end,
+             UChar** conv, UChar** conv_end)
+{
+  const UChar* p;
+  UChar* q;
+  OnigCodePoint code;
+  ptrdiff_t len = 0;
+  int r, from_sb, clen;
+
+  from_sb = (from == ONIG_ENCODING_ASCII || from == ONIG_ENCODING_ISO_8859_1);
+  if (!((from_sb || ONIGENC_IS_UNICODE(from)) && ONIGENC_IS_UNICODE(to)))
+    return ONIGERR_NOT_SUPPORTED_ENCODING_COMBINATION;
+
+  for (p = s; p < end; p += clen) {
+    if (from_sb) {
+      clen = 1;
+      code = *p;
+    }
+    else {
+      clen = ONIGENC_PRECISE_MBC_ENC_LEN(from, p, end);
+      if (! ONIGENC_MBCLEN_CHARFOUND_P(clen))
+        return ONIGERR_INVALID_CODE_POINT_VALUE;
+      clen = ONIGENC_MBCLEN_CHARFOUND_LEN(clen);
+      code = ONIGENC_MBC_TO_CODE(from, p, end);
+    }
+    r = ONIGENC_CODE_TO_MBCLEN(to, code);
+    if (r < 0) return r;
+    len += r;
+  }
+
+  *conv = (UChar* )xmalloc(len > 0 ? len : 1);
+  CHECK_NULL_RETURN_MEMERR(*conv);
+  for (p = s, q = *conv; p < end; p += clen) {
+    if (from_sb) {
+      clen = 1;
+      code = *p;
+    }
+    else {
+      clen = enclen(from, p, end);
+      code = ONIGENC_MBC_TO_CODE(from, p, end);
+    }
+    q += ONIGENC_CODE_TO_MBC(to, code, q);
+  }
+  *conv_end = q;
+  return 0;
+}
+
 static int
 conv_encoding(OnigEncoding from, OnigEncoding to, const UChar* s, const UChar* end,
               UChar** conv, UChar** conv_end)
@@ -157,7 +208,7 @@ conv_encoding(OnigEncoding from, OnigEncoding to, const UChar* s, const UChar* e
     }
   }
 
-  return ONIGERR_NOT_SUPPORTED_ENCODING_COMBINATION;
+  return conv_unicode(from, to, s, end, conv, conv_end);
 }
 
 extern int
@@ -84,9 +84,22 @@
 
 #define INIT_MATCH_STACK_SIZE                     160
 #define DEFAULT_MATCH_STACK_LIMIT_SIZE              0 /* unlimited */
+#define DEFAULT_MATCH_STACK_POOL_LIMIT_SIZE     16384 /* per thread */
 #define DEFAULT_PARSE_DEPTH_LIMIT                4096
+#define DEFAULT_SUBEXP_CALL_DEPTH_LIMIT             0 /* unlimited */
+#define BOUNDED_NATIVE_STACK_PARSE_DEPTH_LIMIT     32
+#define BOUNDED_NATIVE_STACK_TREE_DEPTH_LIMIT     256
+
+#ifdef USE_BOUNDED_NATIVE_STACK
+# define DEFAULT_BOUNDED_NATIVE_STACK  1
+#else
+# define DEFAULT_BOUNDED_NATIVE_STACK  0
+#endif
+
+#define CACHE_LINE_SIZE    64
 
 #define OPT_EXACT_MAXLEN   24	/* This must be smaller than ONIG_CHAR_TABLE_SIZE. */
+#define ALT_DISPATCH_MIN_BRANCHES  4	/* alternations compiled to OP_ALT_DISPATCH */
 
 /* check config */
 #if defined(USE_PERL_SUBEXP_CALL) || defined(USE_CAPITAL_P_NAMED_GROUP)
@@ -133,16 +146,21 @@
 #else
 # define USE_CAPTURE_HISTORY
 #endif
+#if defined(ONIG_THREAD_LOCAL) && \
+    (defined(_WIN32) || defined(HAVE_PTHREAD_KEY_CREATE))
+# define USE_MATCH_STACK_POOL  /* keep the match stack between searches */
+#endif
 #define USE_VARIABLE_META_CHARS
 #define USE_FIND_LONGEST_SEARCH_ALL_OF_RANGE
 /* #define USE_COMBINATION_EXPLOSION_CHECK */     /* (X*)* */
 
 
 #ifndef xmalloc
-# define xmalloc     malloc
-# define xrealloc    realloc
-# define xcalloc     calloc
-# define xfree       free
+# define USE_ALLOCATOR_HOOK      /* onig_set_allocator() */
+# define xmalloc     onig_xmalloc
+# define xrealloc    onig_xrealloc
+# define xcalloc     onig_xcalloc
+# define xfree       onig_xfree
 #endif
 
 #ifdef RUBY
@@ -345,15 +363,21 @@ RUBY_SYMBOL_EXPORT_BEGIN
 #define STACK_POP_LEVEL_MEM_START   1
 #define STACK_POP_LEVEL_ALL         2
 
-/* optimize flags */
-#define ONIG_OPTIMIZE_NONE              0
-#define ONIG_OPTIMIZE_EXACT             1   /* Slow Search */
-#define ONIG_OPTIMIZE_EXACT_BM          2   /* Boyer Moore Search */
-#define ONIG_OPTIMIZE_EXACT_BM_NOT_REV  3   /* BM (applied to a multibyte string) */
-#define ONIG_OPTIMIZE_EXACT_IC          4   /* Slow Search (ignore case) */
-#define ONIG_OPTIMIZE_MAP               5   /* char map */
-#define ONIG_OPTIMIZE_EXACT_BM_IC         6 /* BM (ignore case) */
-#define ONIG_OPTIMIZE_EXACT_BM_NOT_REV_IC 7 /* BM (applied to a multibyte string) (ignore case) */
+/* encoding kind: encodings whose primitives the matcher inlines */
+#define ENC_KIND_GENERIC            0
+#define ENC_KIND_SINGLE_BYTE        1   /* one byte per char, LF newline */
+#define ENC_KIND_UTF8               2
+#define ENC_KIND_UTF16LE            3
+
+/* optimize flags: ONIG_OPTIMIZE_XXX in onigmo.h */
+
+/* reg->map of ONIG_OPTIMIZE_EXACT_BM(_NOT_REV) holds the skip for a
+   forward search followed by the skip for a backward search */
+#define OPTIMIZE_MAP_SIZE(reg) \
+  (((reg)->optimize == ONIG_OPTIMIZE_EXACT_BM ||\
+    (reg)->optimize == ONIG_OPTIMIZE_EXACT_BM_NOT_REV) ?\
+   ONIG_CHAR_TABLE_SIZE * 2 : ONIG_CHAR_TABLE_SIZE)
+#define BM_BACKWARD_SKIP(reg)   ((reg)->map + ONIG_CHAR_TABLE_SIZE)
 
 /* bit status */
 typedef unsigned int  BitStatusType;
@@ -391,6 +415,7 @@ typedef unsigned int  BitStatusType;
 #define IS_EXTEND(option)         ((option) & ONIG_OPTION_EXTEND)
 #define IS_FIND_LONGEST(option)   ((option) & ONIG_OPTION_FIND_LONGEST)
 #define IS_FIND_NOT_EMPTY(option) ((option) & ONIG_OPTION_FIND_NOT_EMPTY)
+#define IS_LEFTMOST_LONGEST(option) ((option) & ONIG_OPTION_LEFTMOST_LONGEST)
 #define IS_FIND_CONDITION(option) ((option) & \
           (ONIG_OPTION_FIND_LONGEST | ONIG_OPTION_FIND_NOT_EMPTY))
 #define IS_NOTBOL(option)         ((option) & ONIG_OPTION_NOTBOL)
@@ -401,6 +426,7 @@ typedef unsigned int  BitStatusType;
 #define IS_POSIX_BRACKET_ALL_RANGE(option)  ((option) & ONIG_OPTION_POSIX_BRACKET_ALL_RANGE)
 #define IS_WORD_BOUND_ALL_RANGE(option)     ((option) & ONIG_OPTION_WORD_BOUND_ALL_RANGE)
 #define IS_NEWLINE_CRLF(option)   ((option) & ONIG_OPTION_NEWLINE_CRLF)
+#define IS_CONTIGUOUS(option)     ((option) & ONIG_OPTION_CONTIGUOUS)
 
 /* OP_SET_OPTION is required for these options.
 #define IS_DYNAMIC_OPTION(option) \
@@ -531,24 +557,24 @@ typedef struct _BBuf {
 #define BBUF_GET_BYTE(buf, pos) (buf)->p[(pos)]
 
 
-#define ANCHOR_BEGIN_BUF        (1<<0)
-#define ANCHOR_BEGIN_LINE       (1<<1)
-#define ANCHOR_BEGIN_POSITION   (1<<2)
-#define ANCHOR_END_BUF          (1<<3)
-#define ANCHOR_SEMI_END_BUF     (1<<4)
-#define ANCHOR_END_LINE         (1<<5)
+#define ANCHOR_BEGIN_BUF        ONIG_ANCHOR_BEGIN_BUF
+#define ANCHOR_BEGIN_LINE       ONIG_ANCHOR_BEGIN_LINE
+#define ANCHOR_BEGIN_POSITION   ONIG_ANCHOR_BEGIN_POSITION
+#define ANCHOR_END_BUF          ONIG_ANCHOR_END_BUF
+#define ANCHOR_SEMI_END_BUF     ONIG_ANCHOR_SEMI_END_BUF
+#define ANCHOR_END_LINE         ONIG_ANCHOR_END_LINE
 
 #define ANCHOR_WORD_BOUND       (1<<6)
 #define ANCHOR_NOT_WORD_BOUND   (1<<7)
 #define ANCHOR_WORD_BEGIN       (1<<8)
 #define ANCHOR_WORD_END         (1<<9)
 #define ANCHOR_PREC_READ        (1<<10)
-#define ANCHOR_PREC_READ_NOT    (1<<11)
-#define ANCHOR_LOOK_BEHIND      (1<<12)
+#define ANCHOR_PREC_READ_NOT    ONIG_ANCHOR_PREC_READ_NOT
+#define ANCHOR_LOOK_BEHIND      ONIG_ANCHOR_LOOK_BEHIND
 #define ANCHOR_LOOK_BEHIND_NOT  (1<<13)
 
-#define ANCHOR_ANYCHAR_STAR     (1<<14)   /* ".*" optimize info */
-#define ANCHOR_ANYCHAR_STAR_ML  (1<<15)   /* ".*" optimize info (multi-line) */
+#define ANCHOR_ANYCHAR_STAR     ONIG_ANCHOR_ANYCHAR_STAR    /* ".*" optimize info */
+#define ANCHOR_ANYCHAR_STAR_ML  ONIG_ANCHOR_ANYCHAR_STAR_ML /* ".*" optimize info (multi-line) */
 
 #define ANCHOR_KEEP             (1<<16)
 
@@ -572,6 +598,7 @@ enum OpCode {
 
   OP_EXACT1_IC,         /* single byte, N = 1, ignore case */
   OP_EXACTN_IC,         /* single byte,        ignore case */
+  OP_EXACTN_FOLD,       /* ignore case, the chars matched by each char */
 
   OP_CCLASS,
   OP_CCLASS_MB,
@@ -586,6 +613,8 @@ enum OpCode {
   OP_ANYCHAR_ML_STAR,         /* ".*" multi-line */
   OP_ANYCHAR_STAR_PEEK_NEXT,
   OP_ANYCHAR_ML_STAR_PEEK_NEXT,
+  OP_LINEBREAK,               /* "\R" */
+  OP_GRAPHEME_CLUSTER,        /* "\X" (Unicode) */
 
   OP_WORD,
   OP_NOT_WORD,
@@ -631,6 +660,10 @@ enum OpCode {
   OP_POP,
   OP_PUSH_OR_JUMP_EXACT1,  /* if match exact then push, else jump. */
   OP_PUSH_IF_PEEK_NEXT,    /* if match exact then push, else none. */
+  OP_PUSH_SPAN,            /* OP_PUSH of a loop of one single char opcode */
+  OP_PUSH_SPAN_IF_PEEK_NEXT, /* same for OP_PUSH_IF_PEEK_NEXT */
+  OP_ALT_DISPATCH,         /* jump to the first branch for the next byte */
+  OP_ALT_DISPATCH_NEXT,    /* push the next branch for the next byte */
   OP_REPEAT,               /* {n,m} */
   OP_REPEAT_NG,            /* {n,m}? (non greedy) */
   OP_REPEAT_INC,
@@ -651,9 +684,14 @@ enum OpCode {
   OP_LOOK_BEHIND,          /* (?<=...) start (no needs end opcode) */
   OP_PUSH_LOOK_BEHIND_NOT, /* (?<!...) start */
   OP_FAIL_LOOK_BEHIND_NOT, /* (?<!...) end   */
+  OP_LOOK_BEHIND_VAR,      /* (?<=...) start, variable length */
+  OP_LOOK_BEHIND_VAR_END,  /* (?<=...) end,   variable length */
+  OP_PUSH_LOOK_BEHIND_NOT_VAR, /* (?<!...) start, variable length */
+  OP_FAIL_LOOK_BEHIND_NOT_VAR, /* (?<!...) end,   variable length */
   OP_PUSH_ABSENT_POS,      /* (?~...)  start */
   OP_ABSENT,               /* (?~...)  start of inner loop */
   OP_ABSENT_END,           /* (?~...)  end   */
+  OP_ABSENT_EXACT,         /* (?~string) */
 
   OP_CALL,                 /* \g<name> */
   OP_RETURN,
@@ -709,13 +747,24 @@ typedef void* PointerType;
 
 
 /* op-code + arg size */
+/* OP_ALT_DISPATCH: a row of branch bits for each byte and the end */
+#define ALT_DISPATCH_ROWS              (SINGLE_BYTE_SIZE + 1)
+#define ALT_DISPATCH_ROW_SIZE(n)       (((n) + 7) / 8)
+
 #define SIZE_OP_ANYCHAR_STAR            SIZE_OPCODE
 #define SIZE_OP_ANYCHAR_STAR_PEEK_NEXT (SIZE_OPCODE + 1)
+#define SIZE_OP_LINEBREAK               SIZE_OPCODE
+#define SIZE_OP_GRAPHEME_CLUSTER        SIZE_OPCODE
 #define SIZE_OP_JUMP                   (SIZE_OPCODE + SIZE_RELADDR)
 #define SIZE_OP_PUSH                   (SIZE_OPCODE + SIZE_RELADDR)
 #define SIZE_OP_POP                     SIZE_OPCODE
 #define SIZE_OP_PUSH_OR_JUMP_EXACT1    (SIZE_OPCODE + SIZE_RELADDR + 1)
 #define SIZE_OP_PUSH_IF_PEEK_NEXT      (SIZE_OPCODE + SIZE_RELADDR + 1)
+#define SIZE_OP_PUSH_SPAN              SIZE_OP_PUSH
+#define SIZE_OP_PUSH_SPAN_IF_PEEK_NEXT SIZE_OP_PUSH_IF_PEEK_NEXT
+#define SIZE_OP_ALT_DISPATCH(n)        (SIZE_OPCODE + SIZE_LENGTH + SIZE_RELADDR * (n) \
+                                        + ALT_DISPATCH_ROWS * ALT_DISPATCH_ROW_SIZE(n))
+#define SIZE_OP_ALT_DISPATCH_NEXT      (SIZE_OPCODE + SIZE_RELADDR + SIZE_LENGTH)
 #define SIZE_OP_REPEAT_INC             (SIZE_OPCODE + SIZE_MEMNUM)
 #define SIZE_OP_REPEAT_INC_NG          (SIZE_OPCODE + SIZE_MEMNUM)
 #define SIZE_OP_PUSH_POS                SIZE_OPCODE
@@ -738,12 +787,17 @@ typedef void* PointerType;
 #define SIZE_OP_LOOK_BEHIND            (SIZE_OPCODE + SIZE_LENGTH)
 #define SIZE_OP_PUSH_LOOK_BEHIND_NOT   (SIZE_OPCODE + SIZE_RELADDR + SIZE_LENGTH)
 #define SIZE_OP_FAIL_LOOK_BEHIND_NOT    SIZE_OPCODE
+#define SIZE_OP_LOOK_BEHIND_VAR        (SIZE_OPCODE + SIZE_LENGTH * 2)
+#define SIZE_OP_LOOK_BEHIND_VAR_END     SIZE_OPCODE
+#define SIZE_OP_PUSH_LOOK_BEHIND_NOT_VAR (SIZE_OPCODE + SIZE_RELADDR + SIZE_LENGTH * 2)
+#define SIZE_OP_FAIL_LOOK_BEHIND_NOT_VAR SIZE_OPCODE
 #define SIZE_OP_CALL                   (SIZE_OPCODE + SIZE_ABSADDR)
 #define SIZE_OP_RETURN                  SIZE_OPCODE
 #define SIZE_OP_CONDITION              (SIZE_OPCODE + SIZE_MEMNUM + SIZE_RELADDR)
 #define SIZE_OP_PUSH_ABSENT_POS         SIZE_OPCODE
 #define SIZE_OP_ABSENT                 (SIZE_OPCODE + SIZE_RELADDR)
 #define SIZE_OP_ABSENT_END              SIZE_OPCODE
+#define SIZE_OP_ABSENT_EXACT           (SIZE_OPCODE + SIZE_LENGTH)
 
 #ifdef USE_COMBINATION_EXPLOSION_CHECK
 # define SIZE_OP_STATE_CHECK           (SIZE_OPCODE + SIZE_STATE_CHECK_NUM)
@@ -850,9 +904,9 @@ typedef struct _OnigStackType {
     } null_check;
 #ifdef USE_SUBEXP_CALL
     struct {
-      UChar *ret_addr;   /* byte code position */
-      int    num;        /* null check id */
-      UChar *pstr;       /* string position */
+      UChar *ret_addr;       /* byte code position */
+      OnigStackIndex prev;   /* caller's frame (STK_RETURN: the returned frame) */
+      unsigned int level;    /* call nest level */
     } call_frame;
 #endif
     struct {
@@ -862,13 +916,23 @@ typedef struct _OnigStackType {
   } u;
 } OnigStackType;
 
+/* per-thread search data; padded to whole cache lines */
+struct OnigMatchScratchStruct {
+  void*  base;     /* allocated address */
+  void*  stack_p;  /* kept match stack */
+  size_t stack_n;
+};
+
 typedef struct {
   void* stack_p;
   size_t stack_n;
+  OnigMatchScratch* scratch;
   OnigOptionType options;
   OnigRegion*    region;
   const UChar* start;   /* search start position */
   const UChar* gpos;    /* global position (for \G: BEGIN_POSITION) */
+  const UChar* edge_end; /* end of a part of a longer subject, or NULL */
+  int edge;             /* the match looked at edge_end */
 #ifdef USE_FIND_LONGEST_SEARCH_ALL_OF_RANGE
   OnigPosition best_len;  /* for ONIG_OPTION_FIND_LONGEST */
   UChar* best_s;
@@ -889,6 +953,13 @@ typedef struct OnigEndCallListItem {
 } OnigEndCallListItemType;
 
 extern void onig_add_end_call(void (*func)(void));
+#ifdef USE_ALLOCATOR_HOOK
+extern void* onig_xmalloc(size_t size);
+extern void* onig_xrealloc(void* ptr, size_t size);
+extern void* onig_xcalloc(size_t n, size_t size);
+extern void  onig_xfree(void* ptr);
+#endif
+extern int  OnigBoundedNativeStack;
 
 
 #ifdef ONIG_DEBUG
@@ -940,6 +1011,10 @@ extern size_t onig_memsize(const regex_t *reg);
 extern size_t onig_region_memsize(const struct re_registers *regs);
 #endif
 
+/* the bytecode block also holds the exact string and the repeat ranges */
+#define IS_IN_REGEX_BLOCK(reg,ptr) \
+  ((UChar* )(ptr) >= (reg)->p && (UChar* )(ptr) < (reg)->p + (reg)->alloc)
+
 RUBY_SYMBOL_EXPORT_END
 
 #endif /* ONIGMO_REGINT_H */
@@ -63,6 +63,7 @@ const OnigSyntaxType OnigSyntaxRuby = {
   , ( SYN_GNU_REGEX_BV |
       ONIG_SYN_ALLOW_INTERVAL_LOW_ABBREV |
       ONIG_SYN_DIFFERENT_LEN_ALT_LOOK_BEHIND |
+      ONIG_SYN_VARIABLE_LEN_LOOK_BEHIND |
       ONIG_SYN_CAPTURE_ONLY_NAMED_GROUP |
       ONIG_SYN_ALLOW_MULTIPLEX_DEFINITION_NAME |
       ONIG_SYN_FIXED_INTERVAL_IS_GREEDY_ONLY |
@@ -113,6 +114,14 @@ static void CC_DUP_WARN(ScanEnv *env, OnigCodePoint from, OnigCodePoint to);
 
 static unsigned int ParseDepthLimit = DEFAULT_PARSE_DEPTH_LIMIT;
 
+/* In bounded native stack mode the recursion depth of the parser and of
+   the compiler, which follows the shape of the parse tree, is capped.
+   Subexp calls are checked by the compiler. */
+#define PARSE_DEPTH_LIMIT \
+  ((OnigBoundedNativeStack && \
+    ParseDepthLimit > BOUNDED_NATIVE_STACK_PARSE_DEPTH_LIMIT) ? \
+   BOUNDED_NATIVE_STACK_PARSE_DEPTH_LIMIT : ParseDepthLimit)
+
 extern unsigned int
 onig_get_parse_depth_limit(void)
 {
@@ -530,6 +539,11 @@ onig_names_free(regex_t* reg)
   r = names_clear(reg);
   if (r) return r;
 
+  if (IS_NOT_NULL(reg->named_groups)) {
+    xfree(reg->named_groups);
+    reg->named_groups = (OnigNamedGroup* )NULL;
+  }
+
   t = (NameTable* )reg->name_table;
   if (IS_NOT_NULL(t)) onig_st_free_table(t);
   reg->name_table = (void* )NULL;
@@ -711,6 +725,11 @@ onig_names_free(regex_t* reg)
   r = names_clear(reg);
   if (r) return r;
 
+  if (IS_NOT_NULL(reg->named_groups)) {
+    xfree(reg->named_groups);
+    reg->named_groups = (OnigNamedGroup* )NULL;
+  }
+
   t = (NameTable* )reg->name_table;
   if (IS_NOT_NULL(t)) xfree(t);
   reg->name_table = NULL;
@@ -905,13 +924,11 @@ onig_name_to_group_numbers(regex_t* reg, const UChar* name,
   return e->back_num;
 }
 
-extern int
-onig_name_to_backref_number(regex_t* reg, const UChar* name,
-			    const UChar* name_end, const OnigRegion *region)
+static int
+backref_number(int n, const int* nums, const OnigRegion* region)
 {
-  int i, n, *nums;
+  int i;
 
-  n = onig_name_to_group_numbers(reg, name, name_end, &nums);
   if (n < 0)
     return n;
   else if (n == 0)
@@ -929,6 +946,95 @@ onig_name_to_backref_number(regex_t* reg, const UChar* name,
   }
 }
 
+extern int
+onig_name_to_backref_number(regex_t* reg, const UChar* name,
+			    const UChar* name_end, const OnigRegion *region)
+{
+  int n, *nums;
+
+  n = onig_name_to_group_numbers(reg, name, name_end, &nums);
+  return backref_number(n, nums, region);
+}
+
+typedef struct {
+  OnigNamedGroup* list;
+  int n;
+} NamesListArg;
+
+static int
+i_names_list(const UChar* name, const UChar* name_end, int back_num,
+	     int* back_refs, regex_t* reg ARG_UNUSED, void* arg)
+{
+  NamesListArg* larg = (NamesListArg* )arg;
+  OnigNamedGroup* g;
+  int i;
+
+  /* insert in the order of the first group number */
+  for (i = larg->n; i > 0; i--) {
+    if (larg->list[i - 1].back_refs[0] < back_refs[0]) break;
+    larg->list[i] = larg->list[i - 1];
+  }
+  g = &(larg->list[i]);
+  g->name      = name;
+  g->name_end  = name_end;
+  g->back_num  = back_num;
+  g->back_refs = back_refs;
+  larg->n++;
+  return 0;
+}
+
+/* Make the flat list of names after the group numbers are fixed, so that
+   the named captures of a match can be read without any hashing. */
+extern int
+onig_names_make_list(regex_t* reg)
+{
+  NamesListArg larg;
+  int num = onig_number_of_names(reg);
+
+  if (IS_NOT_NULL(reg->named_groups)) {
+    xfree(reg->named_groups);
+    reg->named_groups = (OnigNamedGroup* )NULL;
+  }
+  if (num == 0) return 0;
+
+  larg.list = (OnigNamedGroup* )xmalloc(sizeof(OnigNamedGroup) * num);
+  CHECK_NULL_RETURN_MEMERR(larg.list);
+  larg.n = 0;
+  onig_foreach_name(reg, i_names_list, &larg);
+  reg->named_groups = larg.list;
+  return 0;
+}
+
+extern int
+onig_get_named_groups(const regex_t* reg, const OnigNamedGroup** groups)
+{
+  *groups = reg->named_groups;
+  return IS_NULL(reg->named_groups) ? 0 : onig_number_of_names(reg);
+}
+
+extern const OnigNamedGroup*
+onig_name_to_named_group(regex_t* reg, const UChar* name,
+			 const UChar* name_end)
+{
+  int i, n, *nums;
+
+  n = onig_name_to_group_numbers(reg, name, name_end, &nums);
+  if (n <= 0 || IS_NULL(reg->named_groups)) return NULL;
+
+  for (i = onig_number_of_names(reg) - 1; i >= 0; i--) {
+    if (reg->named_groups[i].back_refs == nums)
+      return &(reg->named_groups[i]);
+  }
+  return NULL;
+}
+
+extern int
+onig_named_group_backref_number(const OnigNamedGroup* group,
+				const OnigRegion *region)
+{
+  return backref_number(group->back_num, group->back_refs, region);
+}
+
 #else /* USE_NAMED_GROUP */
 
 extern int
@@ -957,6 +1063,27 @@ onig_number_of_names(const regex_t* reg)
 {
   return 0;
 }
+
+extern int
+onig_get_named_groups(const regex_t* reg, const OnigNamedGroup** groups)
+{
+  *groups = NULL;
+  return 0;
+}
+
+extern const OnigNamedGroup*
+onig_name_to_named_group(regex_t* reg, const UChar* name,
+			 const UChar* name_end)
+{
+  return NULL;
+}
+
+extern int
+onig_named_group_backref_number(const OnigNamedGroup* group,
+				const OnigRegion* region)
+{
+  return ONIG_NO_SUPPORT_CONFIG;
+}
 #endif /* else USE_NAMED_GROUP */
 
 extern int
@@ -1228,6 +1355,7 @@ onig_node_new_anchor(int type)
   NANCHOR(node)->type     = type;
   NANCHOR(node)->target   = NULL;
   NANCHOR(node)->char_len = -1;
+  NANCHOR(node)->char_max_len = -1;
   NANCHOR(node)->ascii_range = 0;
   return node;
 }
@@ -3315,6 +3443,7 @@ fetch_token(OnigToken* tok, UChar** src, UChar* end, ScanEnv* env)
  start:
   if (PEND) {
     tok->type = TK_EOT;
+    env->end_option = env->option;
     return tok->type;
   }
 
@@ -4574,7 +4703,7 @@ parse_char_class(Node** np, Node** asc_np, OnigToken* tok, UChar** src, UChar* e
 
   *np = *asc_np = NULL_NODE;
   env->parse_depth++;
-  if (env->parse_depth > ParseDepthLimit)
+  if (env->parse_depth > PARSE_DEPTH_LIMIT)
     return ONIGERR_PARSE_DEPTH_LIMIT_OVER;
   prev_cc = asc_prev_cc = (CClassNode* )NULL;
   r = fetch_token_in_cc(tok, src, end, env);
@@ -5687,10 +5816,11 @@ node_linebreak(Node** np, ScanEnv* env)
   left = NULL;
   target1 = NULL;
 
-  /* (?>...) */
+  /* (?>...), compiled to OP_LINEBREAK */
   *np = node_new_enclose(ENCLOSE_STOP_BACKTRACK);
   if (IS_NULL(*np)) goto err;
   NENCLOSE(*np)->target = target2;
+  SET_ENCLOSE_STATUS(*np, NST_LINEBREAK);
   return ONIG_NORMAL;
 
  err:
@@ -6030,6 +6160,14 @@ node_extended_grapheme_cluster(Node** np, ScanEnv* env)
   NENCLOSE(tmp)->target = top_alt;
   np1 = tmp;
 
+#ifdef USE_UNICODE_PROPERTIES
+  /* The tree above still gives the lengths and the optimization info,
+   * but it is compiled to OP_GRAPHEME_CLUSTER, which follows the same
+   * rules with one table lookup per char. */
+  if (ONIGENC_IS_UNICODE(env->enc))
+    SET_ENCLOSE_STATUS(tmp, NST_GRAPHEME_CLUSTER);
+#endif
+
 #ifdef USE_UNICODE_PROPERTIES
   if (ONIGENC_IS_UNICODE(env->enc)) {
     /* Don't ignore case. */
@@ -6440,7 +6578,7 @@ parse_exp(Node** np, OnigToken* tok, int term,
 	return ONIGERR_TARGET_OF_REPEAT_OPERATOR_INVALID;
 
       parse_depth++;
-      if (parse_depth > ParseDepthLimit)
+      if (parse_depth > PARSE_DEPTH_LIMIT)
 	return ONIGERR_PARSE_DEPTH_LIMIT_OVER;
 
       qn = node_new_quantifier(tok->u.repeat.lower, tok->u.repeat.upper,
@@ -6544,7 +6682,7 @@ parse_subexp(Node** top, OnigToken* tok, int term,
 
   *top = NULL;
   env->parse_depth++;
-  if (env->parse_depth > ParseDepthLimit)
+  if (env->parse_depth > PARSE_DEPTH_LIMIT)
     return ONIGERR_PARSE_DEPTH_LIMIT_OVER;
   r = parse_branch(&node, tok, term, src, end, env);
   if (r < 0) {
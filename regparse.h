@@ -140,6 +140,8 @@ RUBY_SYMBOL_EXPORT_BEGIN
 #define NST_IN_REPEAT             (1<<12) /* STK_REPEAT is nested in stack. */
 #define NST_NEST_LEVEL            (1<<13)
 #define NST_BY_NUMBER             (1<<14) /* {n,m} */
+#define NST_GRAPHEME_CLUSTER      (1<<15) /* \X, compiled to one opcode */
+#define NST_LINEBREAK             (1<<16) /* \R, compiled to one opcode */
 
 #define SET_ENCLOSE_STATUS(node,f)      (node)->u.enclose.state |=  (f)
 #define CLEAR_ENCLOSE_STATUS(node,f)    (node)->u.enclose.state &= ~(f)
@@ -156,6 +158,9 @@ RUBY_SYMBOL_EXPORT_BEGIN
     (((en)->state & NST_STOP_BT_SIMPLE_REPEAT) != 0)
 #define IS_ENCLOSE_NAMED_GROUP(en)     (((en)->state & NST_NAMED_GROUP)   != 0)
 #define IS_ENCLOSE_NAME_REF(en)        (((en)->state & NST_NAME_REF)      != 0)
+#define IS_ENCLOSE_GRAPHEME_CLUSTER(en) \
+    (((en)->state & NST_GRAPHEME_CLUSTER) != 0)
+#define IS_ENCLOSE_LINEBREAK(en)       (((en)->state & NST_LINEBREAK)     != 0)
 
 #define SET_CALL_RECURSION(node)       (node)->u.call.state |= NST_RECURSION
 #define IS_CALL_RECURSION(cn)          (((cn)->state & NST_RECURSION)  != 0)
@@ -246,6 +251,7 @@ typedef struct {
   int type;
   struct _Node* target;
   int char_len;
+  int char_max_len;     /* variable length look-behind: char_len is the min */
   int ascii_range;
 } AnchorNode;
 
@@ -289,6 +295,7 @@ typedef struct _Node {
 
 typedef struct {
   OnigOptionType   option;
+  OnigOptionType   end_option; /* option at the end of the pattern */
   OnigCaseFoldType case_fold_flag;
   OnigEncoding     enc;
   const OnigSyntaxType* syntax;
@@ -337,6 +344,7 @@ typedef struct {
 } GroupNumRemap;
 
 extern int    onig_renumber_name_table(regex_t* reg, GroupNumRemap* map);
+extern int    onig_names_make_list(regex_t* reg);
 #endif
 
 extern int    onig_strncmp(const UChar* s1, const UChar* s2, int n);
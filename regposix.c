@@ -36,18 +36,18 @@
 #define ONIG_C(reg)    ((onig_regex_t* )((reg)->onig))
 #define PONIG_C(reg)   ((onig_regex_t** )(&(reg)->onig))
 
-/* #define ENC_STRING_LEN(enc,s,len)    len = strlen(s) */
 #define ENC_STRING_LEN(enc,s,len) do { \
   if (ONIGENC_MBC_MINLEN(enc) == 1) { \
-    UChar* tmps = (UChar* )(s); \
-    while (*tmps != 0) tmps++; \
-    len = (int )(tmps - (UChar* )(s)); \
+    len = (int )strlen((const char* )(s)); \
   } \
   else { \
     len = onigenc_str_bytelen_null(enc, (UChar* )s); \
   } \
 } while(0)
 
+/* Regions up to this size are kept on the C stack in regexec(). */
+#define POSIX_REGION_STACK_SIZE  ONIG_NREGION
+
 typedef struct {
   int onig_err;
   int posix_err;
@@ -147,6 +147,8 @@ regcomp(regex_t* reg, const char* pattern, int posix_options)
     ONIG_OPTION_ON( options, ONIG_OPTION_NEGATE_SINGLELINE);
     ONIG_OPTION_OFF(options, ONIG_OPTION_SINGLELINE);
   }
+  if ((posix_options & REG_LONGEST) != 0)
+    ONIG_OPTION_ON(options, ONIG_OPTION_LEFTMOST_LONGEST);
 
   reg->comp_options = posix_options;
 
@@ -166,34 +168,71 @@ extern int
 regexec(regex_t* reg, const char* str, size_t nmatch,
 	regmatch_t pmatch[], int posix_options)
 {
-  int r, i, len;
-  UChar* end;
+  int r, i, len, nregs;
+  UChar *start, *end;
+  regoff_t offset;
   OnigRegion* region = NULL;
+  OnigRegion  stack_region;
+  OnigPosition stack_beg[POSIX_REGION_STACK_SIZE];
+  OnigPosition stack_end[POSIX_REGION_STACK_SIZE];
   OnigOptionType options;
 
   options = ONIG_OPTION_NONE;
   if ((posix_options & REG_NOTBOL) != 0) options |= ONIG_OPTION_NOTBOL;
   if ((posix_options & REG_NOTEOL) != 0) options |= ONIG_OPTION_NOTEOL;
 
+  if ((posix_options & REG_STARTEND) != 0) {
+    if (pmatch[0].rm_so < 0 || pmatch[0].rm_eo < pmatch[0].rm_so)
+      return REG_EONIG_BADARG;
+    offset = pmatch[0].rm_so;
+    start  = (UChar* )(str + pmatch[0].rm_so);
+    end    = (UChar* )(str + pmatch[0].rm_eo);
+  }
+  else {
+    offset = 0;
+    ENC_STRING_LEN(ONIG_C(reg)->enc, str, len);
+    start  = (UChar* )str;
+    end    = start + len;
+  }
+
+  nregs = ONIG_C(reg)->num_mem + 1;
   if ((reg->comp_options & REG_NOSUB) != 0) {
     nmatch = 0;
   }
   else if (nmatch != 0) {
-    region = onig_region_new();
-    if (region == NULL)
-      return REG_ESPACE;
+    if (nregs <= POSIX_REGION_STACK_SIZE) {
+      /* Use the stack buffers, onig_search() never has to grow them. */
+      region = &stack_region;
+      onig_region_init(region);
+      region->allocated = POSIX_REGION_STACK_SIZE;
+      region->beg = stack_beg;
+      region->end = stack_end;
+    }
+    else {
+      region = onig_region_new();
+      if (region == NULL)
+	return REG_ESPACE;
+    }
   }
 
-  ENC_STRING_LEN(ONIG_C(reg)->enc, str, len);
-  end = (UChar* )(str + len);
-  r = (int )onig_search(ONIG_C(reg), (UChar* )str, end, (UChar* )str, end,
+  r = (int )onig_search(ONIG_C(reg), start, end, start, end,
 		  region, options);
 
   if (r >= 0) {
     r = 0; /* Match */
+    if (nmatch > (size_t )nregs) {
+      for (i = nregs; i < (int )nmatch; i++)
+	pmatch[i].rm_so = pmatch[i].rm_eo = ONIG_REGION_NOTPOS;
+      nmatch = nregs;
+    }
     for (i = 0; i < (int )nmatch; i++) {
-      pmatch[i].rm_so = (regoff_t )region->beg[i];
-      pmatch[i].rm_eo = (regoff_t )region->end[i];
+      if (region->beg[i] == ONIG_REGION_NOTPOS) {
+	pmatch[i].rm_so = pmatch[i].rm_eo = ONIG_REGION_NOTPOS;
+      }
+      else {
+	pmatch[i].rm_so = (regoff_t )region->beg[i] + offset;
+	pmatch[i].rm_eo = (regoff_t )region->end[i] + offset;
+      }
     }
   }
   else if (r == ONIG_MISMATCH) {
@@ -205,7 +244,12 @@ regexec(regex_t* reg, const char* str, size_t nmatch,
     r = onig2posix_error_code(r);
   }
 
-  if (region != NULL)
+  if (region == &stack_region) {
+    /* Only the capture history (if any) is owned by the region. */
+    region->allocated = 0;
+    onig_region_free(region, 0);
+  }
+  else if (region != NULL)
     onig_region_free(region, 1);
 
 #if 0
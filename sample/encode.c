@@ -226,6 +226,18 @@ extern int main(int argc, char* argv[])
                   "b\000\000\000a\000\000\000a\000\000\000a\000\000\000c\000\000\000c\000\000\000\000\000\000\000",
                   "\000\000\000x\000\000\000b\000\000\000a\000\000\000a\000\000\000a\000\000\000c\000\000\000c\000\000\000\000");
 
+  r |= exec_deluxe(ONIG_ENCODING_UTF8, ONIG_ENCODING_UTF16_LE,
+                  ONIG_OPTION_NONE, "\343\201\202+\\d",
+                  "x\000B0B01\000\000\000");
+
+  r |= exec_deluxe(ONIG_ENCODING_UTF8, ONIG_ENCODING_UTF32_BE,
+                  ONIG_OPTION_IGNORECASE, "\303\237",
+                  "\000\000\000x\000\000\000S\000\000\000s\000\000\000\000");
+
+  r |= exec_deluxe(ONIG_ENCODING_UTF16_LE, ONIG_ENCODING_UTF8,
+                  ONIG_OPTION_NONE, "B0+\000\000",
+                  "x\343\201\202\343\201\202");
+
   r |= exec_deluxe(ONIG_ENCODING_ISO_8859_1, ONIG_ENCODING_UTF16_BE,
                   ONIG_OPTION_IGNORECASE,
                   "\337", "\000S\000S\000\000");
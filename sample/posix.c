@@ -88,6 +88,28 @@ extern int main(int argc, char* argv[])
   }
   x(&reg, pattern, (UChar* )"a\nb\n");
 
+  /* REG_STARTEND: search only in [rm_so, rm_eo), no NUL terminator needed */
+  pattern = (UChar* )"^(b+)c";
+  r = regcomp(&reg, (char* )pattern, REG_EXTENDED);
+  if (r) {
+    regerror(r, &reg, buf, sizeof(buf));
+    fprintf(stderr, "ERROR: %s\n", buf);
+    return -1;
+  }
+  {
+    regmatch_t pmatch[2];
+
+    pmatch[0].rm_so = 2;
+    pmatch[0].rm_eo = 6;
+    r = regexec(&reg, "aabbcbbc", 2, pmatch, REG_STARTEND);
+    if (r == 0 && pmatch[0].rm_so == 2 && pmatch[0].rm_eo == 5
+	&& pmatch[1].rm_so == 2 && pmatch[1].rm_eo == 4)
+      fprintf(stderr, "OK: /%s/ REG_STARTEND\n", pattern);
+    else
+      fprintf(stderr, "FAIL: /%s/ REG_STARTEND\n", pattern);
+  }
+  regfree(&reg);
+
   /* Error test */
   pattern = (UChar* )" [";
   r = regcomp(&reg, (char* )pattern, REG_EXTENDED);
@@ -175,6 +175,14 @@ static const struct st_hash_type type_strcasehash = {
 #define free ruby_xfree
 #else /* RUBY */
 #define MEMCPY(p1,p2,type,n)  memcpy((p1), (p2), sizeof(type)*(n))
+#undef malloc
+#undef realloc
+#undef calloc
+#undef free
+#define malloc xmalloc
+#define calloc xcalloc
+#define realloc xrealloc
+#define free xfree
 #endif /* RUBY */
 
 #define EQUAL(tab,x,y) ((x) == (y) || (*(tab)->type->compare)((x),(y)) == 0)
@@ -7,6 +7,8 @@ import onigmo
 import sys
 import io
 import locale
+import threading
+import random
 
 nerror = 0
 nsucc = 0
@@ -268,6 +270,105 @@ def x3(pattern, target, s_from, s_to, mem, **kwargs):
 def n(pattern, target, **kwargs):
     xx(pattern, target, 0, 0, 0, True, **kwargs)
 
+_optimize_names = ["NONE", "EXACT", "EXACT_BM", "EXACT_BM_NOT_REV",
+        "EXACT_IC", "MAP", "EXACT_BM_IC", "EXACT_BM_NOT_REV_IC"]
+_anchor_names = ["BEGIN_BUF", "BEGIN_LINE", "BEGIN_POSITION", "END_BUF",
+        "SEMI_END_BUF", "END_LINE", "PREC_READ_NOT", "LOOK_BEHIND",
+        "ANYCHAR_STAR", "ANYCHAR_STAR_ML"]
+
+def anchor_to_str(anchor):
+    names = [a for a in _anchor_names
+             if anchor & getattr(onigmo, "ONIG_ANCHOR_" + a)]
+    return "|".join(names)
+
+INF = "inf"
+
+def o(pattern, optimize, exact=None, anchor="", sub_anchor="",
+        map_count=0, dmin=0, dmax=0,
+        syn=syntax_default, opt=onigmo.ONIG_OPTION_DEFAULT):
+    """Check the search strategy chosen by the optimizer.
+
+    arguments:
+      pattern   -- regex pattern
+      optimize  -- expected strategy (name of ONIG_OPTIMIZE_XXX without prefix)
+      exact     -- expected exact string (for EXACT*)
+      anchor, sub_anchor -- expected anchors ("BEGIN_BUF|END_BUF" etc.)
+      map_count -- expected number of bytes in the char map (for MAP)
+      dmin, dmax -- expected distance of exact or map (INF for infinite)
+    """
+    global nerror
+    global nsucc
+    global nfail
+
+    encoding = get_encoding_name(onig_encoding)
+    reg = onigmo.OnigRegex()
+    einfo = onigmo.OnigErrorInfo()
+    info = onigmo.OnigOptimizeInfo()
+
+    pattern2 = pattern.encode(encoding)
+    patternp = strptr(pattern2)
+    r = onigmo.onig_new(ctypes.byref(reg),
+            patternp.getptr(), patternp.getptr(-1),
+            opt, onig_encoding, syn, ctypes.byref(einfo))
+    if r != 0:
+        msg = ctypes.create_string_buffer(onigmo.ONIG_MAX_ERROR_MESSAGE_LEN)
+        onigmo.onig_error_code_to_str(msg, r, ctypes.byref(einfo))
+        nerror += 1
+        print_result("ERROR", "%s (/%s/)" % (decode_errmsg(msg), pattern),
+                file=sys.stderr)
+        return
+
+    onigmo.onig_get_optimize_info(reg, ctypes.byref(info))
+    actual_exact = None
+    if info.exact:
+        actual_exact = ctypes.string_at(info.exact,
+                info.exact_end - info.exact).decode(encoding, 'replace')
+    inf = ctypes.c_size_t(-1).value
+    actual = (_optimize_names[info.optimize], actual_exact,
+            anchor_to_str(info.anchor), anchor_to_str(info.sub_anchor),
+            info.map_count,
+            INF if info.dmin == inf else info.dmin,
+            INF if info.dmax == inf else info.dmax)
+    expected = (optimize, exact, anchor, sub_anchor, map_count, dmin, dmax)
+    if actual == expected:
+        nsucc += 1
+        print_result("OK", "/%s/ %s" % (pattern, optimize))
+    else:
+        nfail += 1
+        print_result("FAIL", "/%s/ %s : %s" % (pattern, expected, actual))
+    onigmo.onig_free(reg)
+
+
+def check(result, message):
+    """Count the result of a test which is not a pattern match."""
+    global nsucc
+    global nfail
+
+    if result:
+        nsucc += 1
+        print_result("OK", message)
+    else:
+        nfail += 1
+        print_result("FAIL", message)
+
+
+def memsize(pattern, opt=onigmo.ONIG_OPTION_DEFAULT):
+    """Return onig_memsize() of the compiled pattern."""
+    encoding = get_encoding_name(onig_encoding)
+    reg = onigmo.OnigRegex()
+    einfo = onigmo.OnigErrorInfo()
+
+    pattern2 = pattern.encode(encoding)
+    patternp = strptr(pattern2)
+    r = onigmo.onig_new(ctypes.byref(reg),
+            patternp.getptr(), patternp.getptr(-1),
+            opt, onig_encoding, syntax_default, ctypes.byref(einfo))
+    if r != 0:
+        return -1
+    size = onigmo.onig_memsize(reg)
+    onigmo.onig_free(reg)
+    return size
+
 
 def set_encoding(enc):
     """Set the encoding used for testing.
@@ -619,6 +720,13 @@ def main():
     x2("a|b|c", "dc", 1, 2);
     x2("a|b|cd|efg|h|ijk|lmn|o|pq|rstuvwx|yz", "pqr", 0, 2);
     n("a|b|cd|efg|h|ijk|lmn|o|pq|rstuvwx|yz", "mn");
+    x2("ab|ac|b|a|c", "ad", 0, 1);
+    x2("(?i)foo|bar|baz|qux", "xBAZ", 1, 4);
+    x2("(a)|(b)|(c)|(d)|", "x", 0, 0);
+    x2("\\A(?:a|[b-d]x|\\d+|.)\\z", "cx", 0, 2);
+    x2("\\A(?:foo|(?=b)\\w+|\\Abar|z)\\z", "baz", 0, 3);
+    x2("(?:xa|xb|xc|xd)*e", "xaxdxbe", 0, 7);
+    n("\\A(?:a|b|c|d)(?:aa|bb|cc|dd)", "ab");
     x2("a|^z", "ba", 1, 2);
     x2("a|^z", "za", 0, 1);
     x2("a|\\Gz", "bza", 2, 3);
@@ -1152,11 +1260,34 @@ def main():
     n("(?i)(?<!b|aa)c", "Aac")
     x2("(?<=\\babc)d", " abcd", 4, 5)
     x2("(?<=\\Babc)d", "aabcd", 4, 5)
-    n("(?<!a(?:bb|c))", "", err=onigmo.ONIGERR_INVALID_LOOK_BEHIND_PATTERN)
+    n("(?<!a(?:bb|c))", "", syn=onigmo.ONIG_SYNTAX_PERL, err=onigmo.ONIGERR_INVALID_LOOK_BEHIND_PATTERN)
+    n("(?<=a+)b", "", err=onigmo.ONIGERR_INVALID_LOOK_BEHIND_PATTERN)
+    n("(?<=(a)\\1)b", "", err=onigmo.ONIGERR_INVALID_LOOK_BEHIND_PATTERN)
+    x2("(?<=a(?:bb|c))d", "acd", 2, 3)
+    x2("(?<=a(?:bb|c))d", "abbd", 3, 4)
+    n("(?<=a(?:bb|c))d", "abd")
+    x2("(?<!a(?:bb|c))d", "abd", 2, 3)
+    n("(?<!a(?:bb|c))d", "abbd")
+    n("(?<!a(?:bb|c))d", "acd")
+    x2("(?<!ab?c)d", "d", 0, 1)
+    x2("(?<=ab?)c", "ac", 1, 2)
+    x2("(?<=ab?)c", "abc", 2, 3)
+    x2("(?<=a\\w?)b", "ab", 1, 2)
+    x2("(?<=\\d{1,3}px )x", "x 123px x", 8, 9)
+    x3("(?<=(a|bc)d?)e", "bcde", 0, 2, 1)
+    x2("(?<=\u3042\u3044?)\u3046", "\u3042\u3044\u3046", 2, 3)
+    x2("(?<!\u3042\u3044?)\u3046", "\u3042\u3044\u3046\u3044\u3046", 4, 5)
     x2("a\\b?a", "aa", 0, 2)
     x2("[^x]*x", "aaax", 0, 4)
     x2("(?i)[\\x{0}-B]+", "\x00\x01\x02\x1f\x20@AaBbC", 0, 10)
     x2("(?i)a{2}", "AA", 0, 2)
+    x2("(?i)(\\w+)\\s+\\1", "x Deduplicate dEDUPLICATE", 2, 25)
+    x2("(?i)(.+) \\1", "[Some Longer Text@Z] [sOME lONGER tEXT@z]", 0, 41)
+    n("(?i)(.+) \\1", "abcdefghij[ ABCDEFGHIJ{")
+    n("(?i)(.+) \\1", "A@ a`")
+    x2("(?i)(\u3042abcdefgh\u3044ijklmnopq) \\1", "\u3042ABCDEFGH\u3044ijklmnopq \u3042abcdefgh\u3044IJKLMNOPQ", 0, 39)
+    x2("(\u3042abcdefghij)\\1", "\u3042abcdefghij\u3042abcdefghij", 0, 22)
+    n("(abcdefghijk) \\1", "abcdefghijk abcdefghijK")
     if is_unicode_encoding(onig_encoding):
         # The longest script name
         x2("\\p{Other_Default_Ignorable_Code_Point}+", "\u034F\uFFF8\U000E0FFF", 0, 3)
@@ -1344,6 +1475,21 @@ def main():
     x2("foo|foobar", "foobar", 0, 3)
     x2("foo|foobar", "foobar", 0, 6, opt=onigmo.ONIG_OPTION_FIND_LONGEST)
     x2("a*", "aa aaa aaaa aaaaa ", 12, 17, opt=onigmo.ONIG_OPTION_FIND_LONGEST)
+    x2("ab|abcd", "ab abcd abcd", 3, 7, opt=onigmo.ONIG_OPTION_FIND_LONGEST)
+    x2("\\w+", "ab abcd ab", 3, 7, opt=onigmo.ONIG_OPTION_FIND_LONGEST)
+    x3("(a|ab)(c|bcd)", "xabcd abc", 2, 5, 2, opt=onigmo.ONIG_OPTION_FIND_LONGEST)
+
+    # ONIG_OPTION_LEFTMOST_LONGEST option
+    x2("a*", "aa aaa aaaa aaaaa ", 0, 2, opt=onigmo.ONIG_OPTION_LEFTMOST_LONGEST)
+    x2("foo|foobar", "xfoobar foobarbaz", 1, 7, opt=onigmo.ONIG_OPTION_LEFTMOST_LONGEST)
+    x2("a|ab|abc", "xab abc", 1, 3, opt=onigmo.ONIG_OPTION_LEFTMOST_LONGEST)
+    x2("a+|b+", "xxbb aaa", 2, 4, opt=onigmo.ONIG_OPTION_LEFTMOST_LONGEST)
+    n("a|ab", "xyz", opt=onigmo.ONIG_OPTION_LEFTMOST_LONGEST)
+    if is_unicode_encoding(onig_encoding):
+        x2("(?i:k)yzw", "a\u212ayzw", 1, 5)
+        x2("(?i:k)\\z", "a\u212a", 1, 2)
+    if onig_encoding == onigmo.ONIG_ENCODING_UTF8:
+        x2("(?i)k", "ak\u212a", 2, 3, opt=onigmo.ONIG_OPTION_FIND_LONGEST)
 
     # ONIG_OPTION_FIND_NOT_EMPTY option
     x2("\w*", " a", 0, 0)
@@ -1392,11 +1538,33 @@ def main():
     x2("\\R", "\n", 0, 1)
     x2("\\R", "\r", 0, 1)
     x2("\\R{3}", "\r\r\n\n", 0, 4)
+    x2("\\R", "\r\n", 0, 2)
+    n("\\R\\n", "\r\n")
+    x2("\\R\\R", "\r\n\n", 0, 3)
+    x2("\\R", "\x0b", 0, 1)
+    x2("\\R", "\x0c", 0, 1)
+    x2("a\\R", "ab\ra\r", 3, 5)
+    x2("\\R+", "ab\r\n\r\nc", 2, 6)
+    x2("\u3042\\R\u3044", "\u3042\r\n\u3044", 0, 4)
+    n("\\R", "ab\tc")
+    n("a\\Rb", "a\r\rb")
 
     if (is_unicode_encoding(onig_encoding)):
         x2("\\R", "\u0085", 0, 1)
         x2("\\R", "\u2028", 0, 1)
         x2("\\R", "\u2029", 0, 1)
+        x2("\\R\\R", "\u2028\r\n", 0, 3)
+
+    # beginning of line and .* searches over many lines
+    x2("^abc", "xabc\nzz\nabc", 8, 11)
+    x2("^abc", "xabc\r\nabc", 6, 9)
+    x2("^b", "ab\n\nb", 4, 5)
+    n("^abc", "xabc\nzabc")
+    x2(".*b", "a\na\nab", 4, 6)
+    x2(".*\\Rb", "aa\r\nb", 0, 5)
+    x2("(?m:.*)b", "a\na\nb", 0, 5)
+    x2("^\u3042", "\u3044\u3042\n\u3044\u3044\n\u3042", 6, 7)
+    n(".*b", "a\na\na")
 
     # extended grapheme cluster
     x2("\\X{5}", "あいab\n", 0, 5)
@@ -1417,6 +1585,15 @@ def main():
         x2("\\A\\X\\z", "\U0001F468\u200D\U0001F393", 0, 3)
         x2("\\A\\X\\z", "\U0001F46F\u200D\u2642\uFE0F", 0, 4)
         x2("\\A\\X\\z", "\U0001F469\u200d\u2764\ufe0f\u200d\U0001F469", 0, 6)
+        x2("\\A\\X\\z", "\u1100\u1161\u11a8\u0308", 0, 4)  # L V T Extend
+        x2("\\A\\X\\z", "\uac01\u11a8", 0, 2)  # LVT T
+        x2("\\A\\X\\z", "\u1100\u1100\u0903", 0, 3)  # L L SpacingMark
+        x2("\\A\\X\\z", "\U0001F1E6\U0001F1E7", 0, 2)
+        x2("\\X", "\U0001F1E6\U0001F1E7\U0001F1E8", 0, 2)
+        x2("\\A\\X\\X\\z", "\u0600\u0001", 0, 2)  # Prepend Control
+        x2("\\A\\X\\X\\z", "\u0600\r\n", 0, 3)
+        x2("\\X{2}a", "\u0600\u0300a\u0300a", 0, 5)
+        x2("\\X*\\u0300", "a\u0300\u0300", 1, 2)
 
     # keep
     x2("ab\\Kcd", "abcd", 2, 4)
@@ -1592,6 +1769,14 @@ def main():
     x2("(?i)абвгдеёжзийклмнопрстуфхцчшщъыьэюя", "АБВГДЕЁЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЫЬЭЮЯ", 0, 33);
     x2("(?i)АБВГДЕЁЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЫЬЭЮЯ", "абвгдеёжзийклмнопрстуфхцчшщъыьэюя", 0, 33);
     x2("(?i)АБВГДЕЁЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЫЬЭЮЯ", "АБВГДЕЁЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЫЬЭЮЯ", 0, 33);
+    x2("(?i)жёЛТый", "xЖЁлтЫЙ", 1, 7);
+    n("(?i)жёлтый", "ЖЁЛТЫ");
+    x2("(?i)(?:жёлтый)+", "ЖЁЛТЫЙжёлтый", 0, 12);
+    if is_unicode_encoding(onig_encoding):
+        x2("(?i)kelvin", "\u212aELVIN", 0, 6)
+        x2("(?i)\u212aelvin\u017f", "KElvins", 0, 7)
+        x2("(?i)ωmega", "\u2126MEGA", 0, 5)
+        n("(?i)\u212aelvin", "kelvi")
 
     # multiple name definition
     x2("(?<a>a)(?<a>b)\\k<a>", "aba", 0, 3)
@@ -1617,6 +1802,9 @@ def main():
     x2("(?:(a)|(b))(?(1)c|d)", "bd", 0, 2)
     n("(?:(a)|(b))(?(1)c|d)", "ad")
     n("(?:(a)|(b))(?(1)c|d)", "bc")
+    x2("(a)?(?(1)bdef|cdef)", "xxcdef", 2, 6)
+    x2("(a)?(?(1)bdef|cdef)", "xabdef", 1, 6)
+    n("(a)?(?(1)bdef|cdef)", "xbdef")
     x2("(?:(a)|(b))(?:(?(1)cd)e|fg)", "acde", 0, 4)
     x2("(?:(a)|(b))(?:(?(1)cd|x)e|fg)", "bxe", 0, 3)
     n("(?:(a)|(b))(?:(?(2)cd|x)e|fg)", "bxe")
@@ -1686,6 +1874,13 @@ def main():
     x2("(?~abc|def)x", "defx", 1, 4)
     x2("^(?~\\S+)TEST", "TEST", 0, 4)
     x3('(?~(a)c)', 'aab', -1, -1, 1)    # $1 should not match.
+    x2("/\\*(?~\\*/)\\*/", "/* a */ b */", 0, 7)
+    x2("(?~abc)", "xxabxabc", 0, 7)
+    x2("(?~ab)c", "abc", 1, 3)
+    x2("(?~abc)d", "abxd", 0, 4)
+    n("a(?~b)c", "abc")
+    x2("(?~\u3044\u3046)", "\u3042\u3044\u3044\u3046", 0, 3)
+    x2("(?~\u3044)\u3044", "\u3042\u3044", 0, 2)
 
     # Perl syntax
     x2("\\Q()\\[a]\\E[b]", "()\\[a]b", 0, 7, syn=onigmo.ONIG_SYNTAX_PERL)
@@ -1713,6 +1908,15 @@ def main():
     x2(".*[a-z]bc", "abcabc", 3, 6, searchtype=SearchType.BACKWARD) # Issue #69
     x2(".+[a-z]bc", "abcabc", 2, 6, searchtype=SearchType.BACKWARD) # Issue #69
     x2(".{1,3}[a-z]bc", "abcabc", 2, 6, searchtype=SearchType.BACKWARD)
+    x2("needle", "needle" + "x" * 200 + "needle" + "y" * 200, 206, 212,
+       searchtype=SearchType.BACKWARD)
+    x2("needle", "needle" + "x" * 300, 0, 6, searchtype=SearchType.BACKWARD)
+    n("needle", "needl" + "xn" * 150, searchtype=SearchType.BACKWARD)
+    x2("[!?]", "!" + "a" * 200 + "?" + "b" * 150, 201, 202,
+       searchtype=SearchType.BACKWARD)
+    x2("\\\\", "\\" + "表" * 150, 0, 1, searchtype=SearchType.BACKWARD)
+    x2("\\\\ab", "\\ab" + "表ab" * 150, 0, 3, searchtype=SearchType.BACKWARD)
+    x2("あい", "あい" + "いう" * 100, 0, 2, searchtype=SearchType.BACKWARD)
 
     # onig_match()
     x2("abc", "abcabc", 0, 3, searchtype=SearchType.MATCH)
@@ -1728,16 +1932,353 @@ def main():
     x2("abc\\G", "abc ", 0, 3, searchtype=SearchType.BACKWARD, endpos=3)
     x2("abc\\G", "abc ", 0, 3, searchtype=SearchType.BACKWARD, gpos=3)
 
+    # optimizer decisions (onig_get_optimize_info())
+    #   The expected values were recorded with UTF-8; exact strings, char
+    #   maps and distances depend on the encoding.
+    if onig_encoding == onigmo.ONIG_ENCODING_UTF8:
+        o("a", "EXACT", exact="a")
+        o("ab", "EXACT_BM", exact="ab")
+        o("abc", "EXACT_BM", exact="abc")
+        o("abcd", "EXACT_BM", exact="abcd")
+        o("abcdefgh", "EXACT_BM", exact="abcdefgh")
+        o("a|b", "MAP", map_count=2)
+        o("ab|cd", "MAP", map_count=2)
+        o("abc|abd", "EXACT_BM", exact="ab")
+        o("abc|xyz", "MAP", map_count=2)
+        o("foo|bar|baz", "MAP", map_count=2)
+        o("[abc]", "MAP", map_count=3)
+        o("[a-z]", "MAP", map_count=26)
+        o("[^a]", "NONE")
+        o("\\d", "NONE")
+        o("\\w", "NONE")
+        o("\\s", "NONE")
+        o("\\D", "NONE")
+        o("\\W", "NONE")
+        o(".", "NONE")
+        o(".*", "NONE", anchor="ANYCHAR_STAR")
+        o(".+", "NONE")
+        o(".*abc", "EXACT_BM", exact="abc", anchor="ANYCHAR_STAR", dmax=INF)
+        o(".+abc", "EXACT_BM", exact="abc", dmin=1, dmax=INF)
+        o("a.*b", "EXACT", exact="a")
+        o("^abc", "EXACT_BM", exact="abc", sub_anchor="BEGIN_LINE")
+        o("abc$", "EXACT_BM", exact="abc")
+        o("\\Aabc", "EXACT_BM", exact="abc", anchor="BEGIN_BUF")
+        o("abc\\z", "EXACT_BM", exact="abc", anchor="END_BUF")
+        o("abc\\Z", "EXACT_BM", exact="abc", anchor="SEMI_END_BUF")
+        o("\\Gabc", "EXACT_BM", exact="abc", anchor="BEGIN_POSITION")
+        o("^a", "EXACT", exact="a", sub_anchor="BEGIN_LINE")
+        o("a$", "EXACT", exact="a")
+        o("^$", "NONE", sub_anchor="BEGIN_LINE|END_LINE")
+        o("\\A", "NONE", anchor="BEGIN_BUF")
+        o("\\z", "NONE", anchor="END_BUF")
+        o("(?i)a", "EXACT_IC", exact="a")
+        o("(?i)ab", "EXACT_IC", exact="ab")
+        o("(?i)abc", "EXACT_BM_IC", exact="abc")
+        o("(?i)abcdef", "EXACT_BM_IC", exact="abcdef")
+        o("(?i)foo|bar", "MAP", map_count=4)
+        o("(?i)[a-c]x", "EXACT_IC", exact="x", dmin=1, dmax=1)
+        o("a*", "NONE")
+        o("a+", "EXACT", exact="a")
+        o("a?", "NONE")
+        o("a{2}", "EXACT_BM", exact="aa")
+        o("a{2,}", "EXACT_BM", exact="aa")
+        o("a{2,5}", "EXACT_BM", exact="aa")
+        o("(ab)*", "NONE")
+        o("(ab)+", "EXACT_BM", exact="ab")
+        o("(ab){3}", "EXACT_BM", exact="ababab")
+        o("x(ab)*y", "EXACT", exact="x")
+        o("x(ab)+y", "EXACT_BM", exact="xab")
+        o("a*b", "EXACT", exact="b", dmax=INF)
+        o("a+b", "EXACT", exact="a")
+        o("a?bc", "EXACT_BM", exact="bc", dmax=1)
+        o("ab*c", "EXACT", exact="a")
+        o("ab+c", "EXACT_BM", exact="ab")
+        o("[0-9]+abc", "MAP", map_count=10)
+        o("\\d+-\\d+", "EXACT", exact="-", dmin=1, dmax=INF)
+        o("\\w+@\\w+", "EXACT", exact="@", dmin=1, dmax=INF)
+        o("(a)\\1", "EXACT", exact="a")
+        o("(abc)\\1", "EXACT_BM", exact="abc")
+        o("(?<n>x)\\k<n>", "EXACT", exact="x")
+        o("(?=abc)", "MAP", map_count=1)
+        o("(?!abc)abc", "EXACT_BM", exact="abc", anchor="PREC_READ_NOT")
+        o("(?<=a)b", "EXACT", exact="b", anchor="LOOK_BEHIND")
+        o("(?<!a)b", "EXACT", exact="b")
+        o("abc(?=d)", "EXACT_BM", exact="abc")
+        o("abc(?!d)", "EXACT_BM", exact="abc", anchor="PREC_READ_NOT")
+        o("(?>abc)", "EXACT_BM", exact="abc")
+        o("(?>a*)b", "EXACT", exact="b", dmax=INF)
+        o("a(?:bc)d", "EXACT_BM", exact="abcd")
+        o("(?:abc)+", "EXACT_BM", exact="abc")
+        o("(?:abc)?x", "EXACT", exact="x", dmax=3)
+        o("\\bfoo\\b", "EXACT_BM", exact="foo")
+        o("\\Bfoo", "EXACT_BM", exact="foo")
+        o("foo\\b", "EXACT_BM", exact="foo")
+        o("(?m)a.*b", "EXACT", exact="a")
+        o("(?m).*abc", "EXACT_BM", exact="abc", anchor="ANYCHAR_STAR_ML", dmax=INF)
+        o("(?m)^abc", "EXACT_BM", exact="abc", sub_anchor="BEGIN_LINE")
+        o("(?m)abc$", "EXACT_BM", exact="abc")
+        o("abc|a", "EXACT", exact="a")
+        o("a|abc", "EXACT", exact="a")
+        o("abc|ab|a", "EXACT", exact="a")
+        o("[ab]c|d", "MAP", map_count=2, dmax=1)
+        o("x[ab]", "EXACT", exact="x")
+        o("[ab]x", "EXACT", exact="x", dmin=1, dmax=1)
+        o("\\p{Alpha}", "NONE")
+        o("\\p{Alpha}abc", "EXACT_BM", exact="abc", dmin=1, dmax=4)
+        o("abc\\p{Digit}", "EXACT_BM", exact="abc")
+        o("[[:alpha:]]", "NONE")
+        o("[[:digit:]]+x", "EXACT", exact="x", dmin=1, dmax=INF)
+        o("\\x41", "EXACT", exact="A")
+        o("\\x41\\x42\\x43", "EXACT_BM", exact="ABC")
+        o("\\101", "EXACT", exact="A")
+        o("\\u0041", "EXACT", exact="A")
+        o("(?~abc)", "NONE")
+        o("(?~abc)x", "EXACT", exact="x", dmax=INF)
+        o("x(?~abc)", "EXACT", exact="x")
+        o("(a)(?(1)b|c)", "EXACT", exact="a")
+        o("(a)?(?(1)bc|bd)", "EXACT", exact="b", dmax=1)
+        o("\\R", "NONE")
+        o("\\X", "NONE")
+        o("\\h", "MAP", map_count=22)
+        o("\\H", "NONE")
+        o("\\K", "NONE")
+        o("a\\Kb", "EXACT_BM", exact="ab")
+        o("(?i:abc)d", "EXACT_BM_IC", exact="abc")
+        o("(?-i:abc)", "EXACT_BM", exact="abc")
+        o("a(?i)bc", "EXACT", exact="a")
+        o("[a-z]{3}", "MAP", map_count=26)
+        o("[a-z]{3}x", "EXACT", exact="x", dmin=3, dmax=3)
+        o("x[a-z]{3}", "EXACT", exact="x")
+        o("\\d{4}-\\d{2}-\\d{2}", "EXACT", exact="-", dmin=4, dmax=16)
+        o("(?:a|b)(?:c|d)", "MAP", map_count=2)
+        o("(?:ab|cd)(?:ef|gh)", "MAP", map_count=2)
+        o("(a|b)*c", "EXACT", exact="c", dmax=INF)
+        o("(a|b)+c", "MAP", map_count=2)
+        o("ab(c|d)ef", "EXACT_BM", exact="ab")
+        o("ab(cd|ef)gh", "EXACT_BM", exact="ab")
+        o("(?:xyz)*abc", "EXACT_BM", exact="abc", dmax=INF)
+        o("abc(?:xyz)*", "EXACT_BM", exact="abc")
+        o("abc.*xyz", "EXACT_BM", exact="abc")
+        o(".*abc.*xyz", "EXACT_BM", exact="abc", anchor="ANYCHAR_STAR", dmax=INF)
+        o("a\\nb", "EXACT_BM", exact="a\nb")
+        o("\\n", "EXACT", exact="\n")
+        o("\\t\\t", "EXACT_BM", exact="\t\t")
+        o("\\r\\n", "EXACT_BM", exact="\r\n")
+        o("(?x) a b c ", "EXACT_BM", exact="abc")
+        o("(?x) a # comment", "EXACT", exact="a")
+        o("(?<x>a)\\g<x>", "EXACT_BM", exact="aa")
+        o("\\((?:[^()]|\\g<0>)*\\)", "MAP", map_count=1)
+        o("[^abc]+x", "EXACT", exact="x", dmin=1, dmax=INF)
+        o("x[^abc]+", "EXACT", exact="x")
+        o("[\\s\\S]", "NONE")
+        o("[\\w&&[^a]]", "NONE")
+        o("a{0}", "NONE")
+        o("a{0}b", "EXACT", exact="b")
+        o("a{,3}b", "EXACT", exact="b", dmax=3)
+        o("(?:a{2}){2}", "EXACT_BM", exact="aaaa")
+        o("hello world", "EXACT_BM", exact="hello world")
+        o("HELLO", "EXACT_BM", exact="HELLO")
+        o("hello|world", "MAP", map_count=2)
+        o("(?i)hello world", "EXACT_BM_IC", exact="hello world")
+        o("(?:foo)?bar", "EXACT_BM", exact="bar", dmax=3)
+        o("foo(?:bar)?", "EXACT_BM", exact="foo")
+        o("(foo)?(bar)?", "NONE")
+        o("(?:a?){3}b", "EXACT", exact="b", dmax=3)
+        o("\\d\\d\\d", "NONE")
+        o("[0-9][0-9]x", "EXACT", exact="x", dmin=2, dmax=2)
+        o("x\\d", "EXACT", exact="x")
+        o("(?<=abc)def", "EXACT_BM", exact="def", anchor="LOOK_BEHIND")
+        o("(?<=ab|cd)e", "EXACT", exact="e", anchor="LOOK_BEHIND")
+        o("(?<!abc)def", "EXACT_BM", exact="def")
+        o("abcdefghijklmnopqrstuvwxyz", "EXACT_BM", exact="abcdefghijklmnopqrstuvwx")
+        o("(?i)abcdefghijklmnopqrstuvwxyz", "EXACT_BM_IC", exact="abcdefghij")
+        o("a{10}", "EXACT_BM", exact="aaaaaaaaaa")
+        o("(?i)a{10}", "EXACT_BM_IC", exact="aaaaaaaaaa")
+        o("ss", "EXACT_BM", exact="ss")
+        o("(?i)ss", "MAP", map_count=5)
+        o("(?i)s", "EXACT_IC", exact="s")
+        o("(?i)k", "EXACT_IC", exact="k")
+        o("st", "EXACT_BM", exact="st")
+        o("(?i)st", "MAP", map_count=4)
+        o("ab\\b", "EXACT_BM", exact="ab")
+        o("\\bab", "EXACT_BM", exact="ab")
+        o("\\b", "NONE")
+        o("\\B", "NONE")
+        o("[ab][cd][ef]", "MAP", map_count=2)
+        o("[a][b][c]", "EXACT_BM", exact="abc")
+        o("(?:[ab]|c)d", "EXACT", exact="d", dmin=1, dmax=1)
+        o("[a-c]+[x-z]+", "MAP", map_count=3)
+        o("x|[a-c]", "MAP", map_count=4)
+        o("a|\\d", "NONE")
+        o("a.c", "EXACT", exact="a")
+        o("a..d", "EXACT", exact="a")
+        o("a...e", "EXACT", exact="a")
+        o("....", "NONE")
+        o("(?:)", "NONE")
+        o("()", "NONE")
+        o("(a)|(b)", "MAP", map_count=2)
+        o("((a)b)c", "EXACT_BM", exact="abc")
+        o("あ", "EXACT_BM", exact="あ")
+        o("あい", "EXACT_BM", exact="あい")
+        o("あいう", "EXACT_BM", exact="あいう")
+        o("あいうえお", "EXACT_BM", exact="あいうえお")
+        o("[あいう]", "NONE")
+        o("[ぁ-ん]+", "NONE")
+        o("\\p{Hiragana}", "NONE")
+        o("\\p{Han}+x", "EXACT", exact="x", dmin=1, dmax=INF)
+        o("日本語", "EXACT_BM", exact="日本語")
+        o("(?i)日本語", "EXACT_BM_IC", exact="日本語")
+        o("日本|中国", "MAP", map_count=2)
+        o("x日本語y", "EXACT_BM", exact="x日本語y")
+        o("日本.*語", "EXACT_BM", exact="日本")
+        o("^日本", "EXACT_BM", exact="日本", sub_anchor="BEGIN_LINE")
+        o("語$", "EXACT_BM", exact="語")
+        o("(?i)ｱｲｳ", "EXACT_BM_IC", exact="ｱｲｳ")
+        o("ａｂｃ", "EXACT_BM", exact="ａｂｃ")
+        o("(?i)ａｂｃ", "EXACT_BM_IC", exact="ａｂｃ")
+        o("é", "EXACT_BM", exact="é")
+        o("(?i)é", "MAP", map_count=1)
+        o("(?i)ß", "NONE")
+        o("ßx", "EXACT_BM", exact="ßx")
+        o("(?i)straße", "MAP", map_count=4)
+        o("abc(?=あ)", "EXACT_BM", exact="abc")
+        o("[a-zあ-ん]", "NONE")
+        o("\\d+円", "EXACT_BM", exact="円", dmin=1, dmax=INF)
+        o("[0-9]+ドル", "MAP", map_count=10)
+        o("foo.*bar.*baz", "EXACT_BM", exact="foo")
+        o("(?:foo|bar)baz", "EXACT_BM", exact="baz", dmin=3, dmax=3)
+        o("baz(?:foo|bar)", "EXACT_BM", exact="baz")
+        o("(?:abc|abd)e", "EXACT_BM", exact="ab")
+        o("(?:ab|ac)+d", "EXACT", exact="a")
+        o("a{3,}b", "EXACT_BM", exact="aaa")
+        o("a{1,3}bc", "EXACT", exact="a")
+        o("(?:ab){2,}c", "EXACT_BM", exact="abab")
+        o("(?:ab){0,2}c", "EXACT", exact="c", dmax=4)
+        o("x{5}y{5}", "EXACT_BM", exact="xxxxxyyyyy")
+        o("\\Afoo|bar", "MAP", map_count=2)
+        o("foo\\z|bar", "MAP", map_count=2)
+        o("^foo|^bar", "MAP", sub_anchor="BEGIN_LINE", map_count=2)
+        o("foo$|bar$", "MAP", map_count=2)
+        o("(?:^|,)abc", "EXACT_BM", exact="abc", dmax=1)
+        o("abc(?:,|$)", "EXACT_BM", exact="abc")
+        o(".*\\z", "NONE", anchor="END_BUF|ANYCHAR_STAR")
+        o(".*$", "NONE", anchor="ANYCHAR_STAR")
+        o("^.*$", "NONE", anchor="ANYCHAR_STAR", sub_anchor="BEGIN_LINE")
+        o("(?m)^.*$", "NONE", anchor="ANYCHAR_STAR_ML", sub_anchor="BEGIN_LINE")
+        o("\\A.*", "NONE", anchor="BEGIN_BUF|ANYCHAR_STAR")
+        o("(?m).*", "NONE", anchor="ANYCHAR_STAR_ML")
+        o("[^\\n]*abc", "EXACT_BM", exact="abc", dmax=INF)
+        o("[^x]*x", "EXACT", exact="x", dmax=INF)
+        o("\\S+abc", "EXACT_BM", exact="abc", dmin=1, dmax=INF)
+        o("\\w+\\.com", "EXACT_BM", exact=".com", dmin=1, dmax=INF)
+        o("(?i)[a-z]+ing", "EXACT_BM_IC", exact="ing", dmin=1, dmax=INF)
+        o("(?i)Ing\\b", "EXACT_BM_IC", exact="ing")
+        o("(?i)\\bthe\\b", "EXACT_BM_IC", exact="the")
+        o("\\bthe\\b", "EXACT_BM", exact="the")
+        o("(?<year>\\d{4})-(?<mon>\\d\\d)", "EXACT", exact="-", dmin=4, dmax=16)
+        o("(?<a>abc)|(?<b>abd)", "EXACT_BM", exact="ab")
+        o("(?=.*a)(?=.*b)", "MAP", map_count=1, dmax=INF)
+        o("(?!x).", "NONE", anchor="PREC_READ_NOT")
+        o("(?<=\\d)px", "EXACT_BM", exact="px", anchor="LOOK_BEHIND")
+        o('(?<!\\\\)"', "EXACT", exact='"')
+        o('"[^"]*"', "EXACT", exact='"')
+        o("'(?:[^'\\\\]|\\\\.)*'", "MAP", map_count=1)
+        o("/\\*.*?\\*/", "EXACT_BM", exact="/*")
+        o("<[^>]+>", "EXACT", exact="<")
+        o("</?\\w+>", "EXACT", exact="<")
+        o("\\d+\\.\\d+", "EXACT", exact=".", dmin=1, dmax=INF)
+        o("[+-]?\\d+", "NONE")
+        o("0x[0-9a-f]+", "EXACT_BM", exact="0x")
+        o("(?i)0x[0-9a-f]+", "EXACT_IC", exact="0x")
+        o("key=\\w+", "EXACT_BM", exact="key=")
+        o("\\w+=value", "EXACT_BM", exact="=value", dmin=1, dmax=INF)
+        o("GET /\\S+ HTTP", "EXACT_BM", exact="GET /")
+        o("ERROR|WARN", "MAP", map_count=2)
+        o("(?i)error|warn", "MAP", map_count=4)
+        o("a(?#comment)bc", "EXACT_BM", exact="abc")
+        o("\\Qabc\\E", "EXACT_BM", exact="QabcE")
+        o("a\\.b", "EXACT_BM", exact="a.b")
+        o("\\$\\d+", "MAP", map_count=1)
+        o("\\^x", "EXACT_BM", exact="^x")
+        o("[.]", "EXACT", exact=".")
+        o("[*+?]abc", "EXACT_BM", exact="abc", dmin=1, dmax=1)
+        o("\\[abc\\]", "EXACT_BM", exact="[abc]")
+        o("\\{\\}", "EXACT_BM", exact="{}")
+        o("(a(b(c)))", "EXACT_BM", exact="bc", dmin=1, dmax=1)
+        o("((a|b)c)+d", "EXACT", exact="c", dmin=1, dmax=1)
+        o("(a*)*b", "EXACT", exact="b", dmax=INF)
+        o("(a+)+b", "EXACT", exact="a")
+        o("(a|aa)+b", "EXACT", exact="a")
+        o("(?:a|b|c|d|e|f|g)", "MAP", map_count=7)
+        o("(?:ab|ab)", "EXACT_BM", exact="ab")
+        o("[aa]", "EXACT", exact="a")
+        o("a|a", "EXACT", exact="a")
+        o("bdef|cdef", "EXACT_BM", exact="def", dmin=1, dmax=1)
+        o("(?:bde|ccde)fgh", "EXACT_BM", exact="defgh", dmin=1, dmax=2)
+        o("(?:abcd|bcd|cd)e", "EXACT_BM", exact="cde", dmax=2)
+        o("(a)?(?(1)bdef|cdef)", "EXACT_BM", exact="def", dmin=1, dmax=2)
+        o("(a)?(?(1)xy|xz)", "EXACT", exact="x", dmax=1)
+        o("(?~a)bcd", "EXACT_BM", exact="bcd", dmax=INF)
+
     # stack size
     stack_size = onigmo.onig_get_match_stack_limit_size()
     print("Default stack size:", stack_size)
     onigmo.onig_set_match_stack_limit_size(1000)
     print("New stack size:", onigmo.onig_get_match_stack_limit_size())
     # These patterns need deep stack.
-    n("^a*$", "a" * 200 + "b")
-    n("^a*$", "a" * 2000 + "b", execerr=onigmo.ONIGERR_MATCH_STACK_LIMIT_OVER)
+    n("^(?:ab)*$", "ab" * 100 + "b")
+    n("^(?:ab)*$", "ab" * 1000 + "b",
+      execerr=onigmo.ONIGERR_MATCH_STACK_LIMIT_OVER)
+    if onig_encoding == onigmo.ONIG_ENCODING_UTF8:
+        # Greedy loops of a single character keep their backtrack points
+        # in a single stack entry.
+        n("^a*$", "a" * 2000 + "b")
+        x2("^a*$", "a" * 2000, 0, 2000)
+        x2("[a-z]*z", "a" * 2000 + "z" + "a" * 2000, 0, 2001)
+        x2("\\w+foo", "a" * 2000 + "foo", 0, 2003)
+        x2("\\A\\w+foo", "é" * 2000 + "foo" + "é" * 10, 0, 2003)
+        x2("[^\"]*\"", "é" * 2000 + "\"", 0, 2001)
+        x2("\\A(\\w*)(\\d)", "a1" * 1000 + "b", 0, 2000)
+        n("\\A[^a]*a", "b" * 2000)
+        # Only the exit points followed by the next byte are tried.
+        x2("\\A[ab]*bbz", "ab" * 1000 + "bz", 0, 2002)
+        x2("\\A[ab]*bz", "ab" * 1000 + "z", 0, 2001)
+        n("\\A[ab]*bbz", "ab" * 1000 + "b")
+        # ".*" keeps its backtrack points in a single stack entry.
+        x2("\\A.*b", "a" * 2000 + "b" + "a" * 2000, 0, 2001)
+        x2("\\A(?m:.*)b", "a\n" * 1000 + "b" + "a\n" * 1000, 0, 2001)
+        x2("\\A.*bc", "ab" * 2000 + "c" + "ab" * 1000, 0, 4001)
+        x2("\\A.*\\d", "é" * 2000 + "1" + "é" * 2000, 0, 2001)
+        x2("\\A(?:.*x)*\\z", "ax" * 1000, 0, 2000)
+        x2("\\A(.*)-\\1\\z", "é" * 1000 + "-" + "é" * 1000, 0, 2001)
+        x2("\\A.*(?<=é)a", "éa" * 1000, 0, 2000)
+        n("\\A(?>.*)b", "a" * 2000 + "b")
+        x2("\\A.*\\Kb", "a" * 2000 + "b" + "a" * 2000, 2000, 2001)
     onigmo.onig_set_match_stack_limit_size(0)
 
+    # pooled match stack
+    pool_size = onigmo.onig_get_match_stack_pool_limit_size()
+    print("Default stack pool size:", pool_size)
+    if pool_size > 0:
+        # The second search reuses the stack grown by the first one.
+        n("^(?:ab)*$", "ab" * 1000 + "b")
+        n("^(?:ab)*$", "ab" * 1000 + "b")
+        # A pooled stack larger than the stack limit must not be used.
+        onigmo.onig_set_match_stack_limit_size(1000)
+        n("^(?:ab)*$", "ab" * 100 + "b")
+        n("^(?:ab)*$", "ab" * 1000 + "b",
+          execerr=onigmo.ONIGERR_MATCH_STACK_LIMIT_OVER)
+        onigmo.onig_set_match_stack_limit_size(0)
+        onigmo.onig_set_match_stack_pool_limit_size(0)
+        n("^(?:ab)*$", "ab" * 1000 + "b")
+        onigmo.onig_set_match_stack_pool_limit_size(pool_size)
+        onigmo.onig_trim_match_stack_pool()
+        # The stack kept by another thread is freed when it exits.
+        t = threading.Thread(target=n, args=("^(?:ab)*$",
+                                             "ab" * 1000 + "b"))
+        t.start()
+        t.join()
+
     # parse depth
     parse_depth = onigmo.onig_get_parse_depth_limit()
     print("Default parse depth:", parse_depth)
@@ -1750,6 +2291,436 @@ def main():
     n("X" + "+" * 10000, "X", err=onigmo.ONIGERR_PARSE_DEPTH_LIMIT_OVER)
     onigmo.onig_set_parse_depth_limit(0)
 
+    # subexp call depth
+    call_depth = onigmo.onig_get_subexp_call_depth_limit()
+    print("Default subexp call depth:", call_depth)
+    onigmo.onig_set_subexp_call_depth_limit(100)
+    print("New subexp call depth:", onigmo.onig_get_subexp_call_depth_limit())
+    n("\\A(?<p>\\((?:[^()]|\\g<p>)*\\))\\z", "(" * 101 + ")" * 101, execerr=onigmo.ONIGERR_SUBEXP_CALL_DEPTH_LIMIT_OVER)
+    # the outermost group is not a call: 101 levels are 100 \g<p> calls,
+    # and the lookahead keeps the loop from trying one more
+    x2("\\A(?<p>\\((?:[^()]|(?=\\()\\g<p>)*\\))\\z", "(" * 101 + ")" * 101, 0, 202)
+    n("\\A(?<p>\\((?:[^()]|(?=\\()\\g<p>)*\\))\\z", "(" * 102 + ")" * 102, execerr=onigmo.ONIGERR_SUBEXP_CALL_DEPTH_LIMIT_OVER)
+    onigmo.onig_set_subexp_call_depth_limit(1)
+    x2("\\g<a>(?<a>x(?<b>y))\\g<b>", "xyxyy", 0, 5)
+    n("\\g<a>(?<a>x\\g<b>)(?<b>y)", "xyxyy", execerr=onigmo.ONIGERR_SUBEXP_CALL_DEPTH_LIMIT_OVER)
+    onigmo.onig_set_subexp_call_depth_limit(0)
+    x2("\\A(?<p>\\((?:[^()]|\\g<p>)*\\))\\z", "(" * 1000 + ")" * 1000, 0, 2000)
+    x2("(?<a>x\\g<a>?y)z", "xxxyyz", 1, 6)
+    x2("(?<a>x\\g<a>?y)(?<b>y)", "xxyy", 1, 4)
+    x2("\\A(?<a>|.|(?:(?<b>.)\\g<a>\\k<b+0>))\\z", "abcdcba", 0, 7)
+    n("\\A(?<a>|.|(?:(?<b>.)\\g<a>\\k<b+0>))\\z", "abcdcab")
+    x3("(?<a>\\[(?:\\g<a>|\\d)*\\])", "x[1[2][[3]]]", 1, 12, 1)
+
+    # contiguous block
+    opt = onigmo.ONIG_OPTION_CONTIGUOUS
+    x2("abcdefghij", "xyzabcdefghij", 3, 13, opt=opt)
+    x2("(?i)abcdefghij", "xyzABCdefghij", 3, 13, opt=opt)
+    x2("(?:ab){2,3}c", "abababc", 0, 7, opt=opt)
+    x3("(?<x>a+)b\\k<x>", "aaba", 1, 2, 1, opt=opt)
+    x2("a{3,}|b{2}", "xbbaaa", 1, 3, opt=opt)
+    n("(?:ab){2,3}c", "abc", opt=opt)
+    m1 = memsize("(?:abcdefg){2,3}(?:hij){4,5}")
+    m2 = memsize("(?:abcdefg){2,3}(?:hij){4,5}", opt=opt)
+    # the block only adds alignment padding
+    pad = 2 * ctypes.sizeof(onigmo.OnigDistance)
+    check(0 < m2 <= m1 + pad, "memsize contiguous %d <= %d" % (m2, m1 + pad))
+    # the 256 byte map is allocated only for BM and MAP
+    m1 = memsize("a*")
+    m2 = memsize("a*xyzxyz")
+    check(m2 - m1 >= 256, "memsize map %d >= %d + 256" % (m2, m1))
+
+    # allocator
+    allocated = {}
+    ncalls = [0]
+    def test_malloc(size, context):
+        ncalls[0] += 1
+        p = libc.malloc(size)
+        allocated[p] = size
+        return p
+    def test_realloc(ptr, size, context):
+        if ptr:
+            del allocated[ptr]
+        p = libc.realloc(ptr, size)
+        allocated[p] = size
+        return p
+    def test_free(ptr, context):
+        allocated.pop(ptr, None)
+        libc.free(ptr)
+    libc = ctypes.CDLL(None)
+    libc.malloc.argtypes = [ctypes.c_size_t]
+    libc.malloc.restype = ctypes.c_void_p
+    libc.realloc.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+    libc.realloc.restype = ctypes.c_void_p
+    libc.free.argtypes = [ctypes.c_void_p]
+    allocator = onigmo.OnigAllocator(onigmo.OnigMallocFunc(test_malloc),
+            onigmo.OnigReallocFunc(test_realloc),
+            onigmo.OnigFreeFunc(test_free), None)
+    # The allocator can be changed only while the library is not
+    # initialized.  onig_end() also frees the pooled match stack.
+    check(onigmo.onig_set_allocator(ctypes.byref(allocator)) ==
+            onigmo.ONIGERR_INVALID_ARGUMENT,
+            "allocator: rejected while initialized")
+    onigmo.onig_end()
+    onigmo.onig_set_allocator(ctypes.byref(allocator))
+    x2("(?<x>a|b)+c\\k<x>", "ababcb", 0, 6)
+    x2("(?:abcdefg){2,3}", "abcdefgabcdefg", 0, 14, opt=opt)
+    n("^(?:ab)*$", "ab" * 1000 + "b")
+    check(onigmo.onig_set_allocator(None) == onigmo.ONIGERR_INVALID_ARGUMENT,
+            "allocator: rejected after compile")
+    onigmo.onig_end()
+    onigmo.onig_set_allocator(None)
+    check(ncalls[0] > 0 and len(allocated) == 0,
+            "allocator: %d calls, %d blocks left" % (ncalls[0], len(allocated)))
+
+    # bounded native stack
+    # The mode can be changed only while the library is not initialized.
+    bounded = onigmo.onig_get_bounded_native_stack()
+    print("Default bounded native stack:", bounded)
+    onigmo.onig_init()
+    check(onigmo.onig_set_bounded_native_stack(1) ==
+            onigmo.ONIGERR_INVALID_ARGUMENT,
+            "bounded native stack: rejected while initialized")
+    onigmo.onig_end()
+    onigmo.onig_set_bounded_native_stack(1)
+    x2("(" * 10 + "a" + ")" * 10, "a", 0, 1)
+    n("(" * 200 + "a" + ")" * 200, "a", err=onigmo.ONIGERR_PARSE_DEPTH_LIMIT_OVER)
+    n("X" + "+" * 100, "X", err=onigmo.ONIGERR_PARSE_DEPTH_LIMIT_OVER)
+    x2("(a)" * 120 + "(b)", "a" * 120 + "b", 0, 121)
+    x3("(?:(a)|b)*c", "abac", 2, 3, 1)
+    n("^(?:ab)*$", "ab" * 1000 + "b")
+    # the compiler follows the calls through the chain of groups
+    chain = "(?<g0>a)" + "".join("(?<g%d>\\g<g%d>)" % (i, i - 1)
+            for i in range(1, 20))
+    x2(chain, "a" * 20, 0, 20)
+    chain = "(?<g0>a)" + "".join("(?<g%d>\\g<g%d>)" % (i, i - 1)
+            for i in range(1, 2000))
+    n(chain, "a", err=onigmo.ONIGERR_PARSE_DEPTH_LIMIT_OVER)
+    x2("(?<p>\\((?:[^()]|\\g<p>)*\\))", "(" * 1000 + ")" * 1000, 0, 2000)
+    check(onigmo.onig_set_bounded_native_stack(0) ==
+            onigmo.ONIGERR_INVALID_ARGUMENT,
+            "bounded native stack: rejected after compile")
+    onigmo.onig_end()
+    onigmo.onig_set_bounded_native_stack(bounded)
+
+    # one shared regex searched by threads, each with its own region and
+    # scratch
+    encoding = get_encoding_name(onig_encoding)
+    subjects = [("%s foo%d %s bar%s %s" % ("ab" * (i % 7), i, "c" * (i % 5),
+            "x" * (i % 3), "word word" if i % 2 else "word wort"))
+            .encode(encoding) for i in range(200)]
+    for pattern in ["(\\w+) \\1", "foo\\d+|bar(?:x|y)*|baz",
+            "(?<=ab)c+|(?<!a)b", "^(?:(ab)+|.)*?(\\d+)"]:
+        reg = onigmo.OnigRegex()
+        einfo = onigmo.OnigErrorInfo()
+        pattern2 = pattern.encode(encoding)
+        patternp = strptr(pattern2)
+        r = onigmo.onig_new(ctypes.byref(reg),
+                patternp.getptr(), patternp.getptr(-1),
+                onigmo.ONIG_OPTION_DEFAULT, onig_encoding, syntax_default,
+                ctypes.byref(einfo))
+        if r == 0:
+            r = onigmo.onig_regex_share(reg)
+        if r != 0:
+            check(False, "shared regex /%s/: %d" % (pattern, r))
+            continue
+
+        def search_all(results):
+            scratch = onigmo.onig_match_scratch_new()
+            region = onigmo.onig_region_new()
+            for subject in subjects:
+                sp = strptr(subject)
+                r = onigmo.onig_search_with_scratch(reg,
+                        sp.getptr(), sp.getptr(-1), sp.getptr(), sp.getptr(-1),
+                        region, onigmo.ONIG_OPTION_NONE, scratch)
+                results.append((r, [(region[0].beg[i], region[0].end[i])
+                        for i in range(region[0].num_regs)]))
+            onigmo.onig_region_free(region, 1)
+            onigmo.onig_match_scratch_free(scratch)
+
+        expected = []
+        search_all(expected)
+        results = [[] for i in range(8)]
+        threads = [threading.Thread(target=search_all, args=(res,))
+                for res in results]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        nbad = sum(1 for res in results if res != expected)
+        check(nbad == 0, "shared regex /%s/ in %d threads" % (pattern,
+                len(threads)))
+        onigmo.onig_free(reg)
+
+    # named groups resolved once
+    pattern = "(?<y>b)(?<x>a)?|(?<z>c)(?<x>d)"
+    reg = onigmo.OnigRegex()
+    einfo = onigmo.OnigErrorInfo()
+    patternp = strptr(pattern.encode(encoding))
+    r = onigmo.onig_new(ctypes.byref(reg),
+            patternp.getptr(), patternp.getptr(-1),
+            onigmo.ONIG_OPTION_DEFAULT, onig_encoding, syntax_default,
+            ctypes.byref(einfo))
+    groups = ctypes.POINTER(onigmo.OnigNamedGroup)()
+    num = onigmo.onig_get_named_groups(reg, ctypes.byref(groups))
+    names = [(ctypes.string_at(groups[i].name,
+            groups[i].name_end - groups[i].name).decode(encoding),
+            [groups[i].back_refs[j] for j in range(groups[i].back_num)])
+            for i in range(num)]
+    check(r == 0 and names == [("y", [1]), ("x", [2, 4]), ("z", [3])],
+            "named groups %s" % names)
+    namep = strptr("x".encode(encoding))
+    group = onigmo.onig_name_to_named_group(reg,
+            namep.getptr(), namep.getptr(-1))
+    check(ctypes.addressof(group[0]) == ctypes.addressof(groups[1]),
+            "name to named group")
+    namep = strptr("w".encode(encoding))
+    check(not onigmo.onig_name_to_named_group(reg,
+            namep.getptr(), namep.getptr(-1)), "name to named group, unknown")
+    region = onigmo.onig_region_new()
+    for subject, expected in [("cd", 4), ("ba", 2), ("b", 4)]:
+        sp = strptr(subject.encode(encoding))
+        onigmo.onig_search(reg, sp.getptr(), sp.getptr(-1),
+                sp.getptr(), sp.getptr(-1), region, onigmo.ONIG_OPTION_NONE)
+        num = onigmo.onig_named_group_backref_number(group, region)
+        check(num == expected, "named group backref %s: %d" % (subject, num))
+    onigmo.onig_region_free(region, 1)
+    onigmo.onig_free(reg)
+
+    # subject stored in segments, searched as if joined
+    def search_segments(pattern, subject, cuts, start, range_,
+            opt=onigmo.ONIG_OPTION_DEFAULT, option=onigmo.ONIG_OPTION_NONE,
+            in_bytes=False):
+        reg = onigmo.OnigRegex()
+        einfo = onigmo.OnigErrorInfo()
+        patternp = strptr(pattern.encode(encoding))
+        r = onigmo.onig_new(ctypes.byref(reg),
+                patternp.getptr(), patternp.getptr(-1),
+                opt, onig_encoding, syntax_default,
+                ctypes.byref(einfo))
+        if r != 0:
+            return None
+        # start and range are character offsets (or byte offsets,
+        # which may fall inside a character), -1 for the end
+        if not in_bytes:
+            start = len(subject[:start].encode(encoding)) if start >= 0 \
+                    else len(subject.encode(encoding))
+            range_ = len(subject[:range_].encode(encoding)) if range_ >= 0 \
+                    else len(subject.encode(encoding))
+        subject = subject.encode(encoding)
+        sp = strptr(subject)
+        region = onigmo.onig_region_new()
+        r = onigmo.onig_search(reg, sp.getptr(), sp.getptr(-1),
+                sp.getptr(start), sp.getptr(range_), region, option)
+        expected = (r, [(region[0].beg[i], region[0].end[i])
+                for i in range(region[0].num_regs)])
+        nbad = 0
+        for cut in cuts:
+            bounds = [0] + [c for c in cut if c < len(subject)] + [len(subject)]
+            pieces = [ctypes.create_string_buffer(subject[a:b], b - a)
+                    for a, b in zip(bounds, bounds[1:])]
+            segs = (onigmo.OnigSegment * len(pieces))()
+            for i, piece in enumerate(pieces):
+                segs[i].p = ctypes.addressof(piece)
+                segs[i].end = ctypes.addressof(piece) + len(piece)
+            r = onigmo.onig_search_segments(reg, segs, len(pieces),
+                    start, range_, region, option)
+            result = (r, [(region[0].beg[i], region[0].end[i])
+                    for i in range(region[0].num_regs)])
+            if result != expected:
+                nbad += 1
+        onigmo.onig_region_free(region, 1)
+        onigmo.onig_free(reg)
+        return nbad
+
+    subject = "xx foo bar\nbaz  foobar\naaab qux foo"
+    n_bytes = len(subject.encode(encoding))
+    cuts = [(i,) for i in range(1, n_bytes)] + \
+            [(i, i + 3) for i in range(1, n_bytes, 5)] + \
+            [tuple(range(i, n_bytes, 4)) for i in range(1, 4)]
+    for pattern, start, range_ in [("foobar", 0, -1), ("o+b", 0, -1),
+            ("a.*b", 0, -1), ("a.*b", -1, 0), ("(?<=foo)bar", 0, -1),
+            ("(?<!\\s)ba.", -1, 0), ("\\bqux\\b", 0, -1),
+            ("(a|ba)\\1*b", 0, -1), ("^baz\\s+(\\w+)$", 0, -1),
+            ("(?m:b.*q)", 0, -1), ("(?i)FOO(?=bar)", 0, -1), ("xyz", 0, -1),
+            ("$", -1, 0), ("\\Ax", 0, -1), ("o\\z", -1, 0),
+            ("\\s+", 0, -1), ("[^\"]*r", 0, -1), ("\\W*q", 0, -1),
+            ("(?m:o.*)", -1, 0), ("(?<a>b)\\g<a>*a", 0, -1),
+            ("a(?~foo)o", 0, -1), ("fo+", 5, 30), ("a.*b", 30, 12),
+            ("(?<=o)o|ba", 4, 19), ("\\Gfoo", 3, -1), ("^\\w+", 11, 28)]:
+        nbad = search_segments(pattern, subject, cuts, start, range_)
+        check(nbad == 0, "search segments /%s/ %d..%d: %s" % (pattern,
+                start, range_, nbad))
+    for pattern, opt, option in [
+            ("\\w+", onigmo.ONIG_OPTION_FIND_LONGEST, onigmo.ONIG_OPTION_NONE),
+            ("o|oob|[a-z]+ ?", onigmo.ONIG_OPTION_FIND_LONGEST,
+                onigmo.ONIG_OPTION_NONE),
+            ("^x|^b\\w*", onigmo.ONIG_OPTION_DEFAULT,
+                onigmo.ONIG_OPTION_NOTBOL),
+            ("o$|foo\\Z", onigmo.ONIG_OPTION_DEFAULT,
+                onigmo.ONIG_OPTION_NOTEOL),
+            ("\\w*", onigmo.ONIG_OPTION_FIND_NOT_EMPTY,
+                onigmo.ONIG_OPTION_NONE)]:
+        nbad = search_segments(pattern, subject, cuts, 2, -1, opt, option)
+        check(nbad == 0, "search segments /%s/ option %d %d: %s" % (pattern,
+                opt, option, nbad))
+
+    if is_unicode_encoding(onig_encoding):
+        # the range ends inside a character
+        subject = "x" * 30 + "\u00e9b"
+        n_bytes = len(subject.encode(encoding))
+        start = len(subject[:31].encode(encoding))
+        range_ = len(subject[:30].encode(encoding)) + 1
+        nbad = search_segments("\u00e9|x", subject,
+                [(i,) for i in range(1, n_bytes)], start, range_,
+                in_bytes=True)
+        check(nbad == 0, "search segments, range inside a char: %s" % nbad)
+
+    # random subjects, splits and ranges, forward and backward
+    rand = random.Random(74)
+    units = ["a", "b", "o", "foo", " ", "\n", "\r\n", "x"]
+    if is_unicode_encoding(onig_encoding):
+        units += ["\u00e9", "\u00df", "\u212a", "\U0001f600"]
+    for pattern, opt in [
+            ("(?m:.*)\\z", onigmo.ONIG_OPTION_FIND_LONGEST),
+            ("(?m:.*)\\Z", onigmo.ONIG_OPTION_FIND_NOT_EMPTY),
+            ("(?!b).*?", onigmo.ONIG_OPTION_DEFAULT),
+            ("a.*b|\\s+", onigmo.ONIG_OPTION_FIND_LONGEST),
+            ("(?<=o)\\w*", onigmo.ONIG_OPTION_FIND_NOT_EMPTY),
+            ("[^a]*a|fo+$", onigmo.ONIG_OPTION_DEFAULT),
+            ("(?i)\\bFOO\\b|b\\z", onigmo.ONIG_OPTION_DEFAULT),
+            ("(?:ab)*o|(?~oo)x", onigmo.ONIG_OPTION_FIND_LONGEST),
+            ("^\\W*|(?m:o.)+", onigmo.ONIG_OPTION_FIND_NOT_EMPTY)]:
+        nbad = 0
+        for k in range(30):
+            subject = "".join(rand.choice(units)
+                    for i in range(rand.randrange(40)))
+            n_bytes = len(subject.encode(encoding))
+            cuts = [sorted(rand.randrange(n_bytes + 1)
+                    for i in range(rand.randrange(1, 5))) for j in range(3)]
+            # now and then a range inside a character
+            in_bytes = (k % 3 == 0)
+            start = rand.randrange(len(subject) + 1)
+            range_ = rand.randrange(len(subject) + 1)
+            if in_bytes:
+                start = len(subject[:start].encode(encoding))
+                range_ = rand.randrange(n_bytes + 1)
+            option = rand.choice([onigmo.ONIG_OPTION_NONE,
+                    onigmo.ONIG_OPTION_NOTBOL, onigmo.ONIG_OPTION_NOTEOL])
+            nbad += search_segments(pattern, subject, cuts, start, range_,
+                    opt, option, in_bytes)
+        check(nbad == 0, "search segments /%s/ option %d, random: %s" % (
+                pattern, opt, nbad))
+
+    # incremental search: each keystroke tries the previous starts
+    def scan_starts(reg, subject, starts):
+        sp = strptr(subject)
+        found = []
+        def callback(n, pos, region, arg):
+            found.append(pos)
+            return 0
+        region = onigmo.onig_region_new()
+        if starts is None:
+            r = onigmo.onig_scan_starts(reg, sp.getptr(), sp.getptr(-1),
+                    None, 0, region, onigmo.ONIG_OPTION_NONE,
+                    onigmo.OnigScanCallback(callback), None)
+        else:
+            array = (ctypes.c_ssize_t * max(len(starts), 1))(*starts)
+            r = onigmo.onig_scan_starts(reg, sp.getptr(), sp.getptr(-1),
+                    array, len(starts), region, onigmo.ONIG_OPTION_NONE,
+                    onigmo.OnigScanCallback(callback), None)
+        onigmo.onig_region_free(region, 1)
+        return found if r == len(found) else r
+
+    def start_offsets(subject, chars):
+        return [len(subject[:i].encode(encoding)) for i in chars]
+
+    subject = "aaaa"
+    reg = onigmo.OnigRegex()
+    einfo = onigmo.OnigErrorInfo()
+    patternp = strptr("aa".encode(encoding))
+    onigmo.onig_new(ctypes.byref(reg), patternp.getptr(), patternp.getptr(-1),
+            onigmo.ONIG_OPTION_DEFAULT, onig_encoding, syntax_default,
+            ctypes.byref(einfo))
+    found = scan_starts(reg, subject.encode(encoding), None)
+    check(found == start_offsets(subject, [0, 1, 2]),
+            "scan starts /aa/: %s" % found)
+    onigmo.onig_free(reg)
+
+    # FIND_LONGEST: every start, not only the one of the longest match
+    subject = "ab aaab"
+    patternp = strptr("a+b".encode(encoding))
+    onigmo.onig_new(ctypes.byref(reg), patternp.getptr(), patternp.getptr(-1),
+            onigmo.ONIG_OPTION_FIND_LONGEST, onig_encoding, syntax_default,
+            ctypes.byref(einfo))
+    found = scan_starts(reg, subject.encode(encoding), None)
+    check(found == start_offsets(subject, [0, 3, 4, 5]),
+            "scan starts /a+b/ longest: %s" % found)
+    starts = scan_starts(reg, subject.encode(encoding), found)
+    check(starts == found, "scan starts /a+b/ longest, starts: %s" % starts)
+    onigmo.onig_free(reg)
+
+    subject = "Foo fooBar foo.bar (foo) foobaz FOOBAR foo\nbar foo.b"
+    for base, typed, option in [("", "foo.b", onigmo.ONIG_OPTION_NONE),
+            ("", "FOOBA", onigmo.ONIG_OPTION_IGNORECASE),
+            ("\\bfo", "o", onigmo.ONIG_OPTION_NONE),
+            ("(f|\\()o+", "b", onigmo.ONIG_OPTION_IGNORECASE),
+            ("a|f", "oo", onigmo.ONIG_OPTION_NONE),
+            ("(?i)f", "oo", onigmo.ONIG_OPTION_NONE)]:
+        basep = strptr(base.encode(encoding))
+        prev = onigmo.OnigRegex()
+        onigmo.onig_new(ctypes.byref(prev), basep.getptr(), basep.getptr(-1),
+                option, onig_encoding, syntax_default, ctypes.byref(einfo))
+        starts = scan_starts(prev, subject.encode(encoding), None)
+        nbad = 0
+        for k in range(1, len(typed) + 1):
+            reg = onigmo.OnigRegex()
+            typedp = strptr(typed[:k].encode(encoding))
+            r = onigmo.onig_new_append(ctypes.byref(reg), prev,
+                    basep.getptr(), basep.getptr(-1),
+                    typedp.getptr(), typedp.getptr(-1), ctypes.byref(einfo))
+            if r != 0:
+                nbad += 1
+                break
+            expected = scan_starts(reg, subject.encode(encoding), None)
+            starts = scan_starts(reg, subject.encode(encoding), starts)
+            if starts != expected:
+                nbad += 1
+            onigmo.onig_free(prev)
+            prev = reg
+        onigmo.onig_free(prev)
+        check(nbad == 0, "incremental search /%s/ + %s: %d" % (base, typed,
+                nbad))
+        if base == "" and option == onigmo.ONIG_OPTION_NONE:
+            check(starts == start_offsets(subject, [11, 47]),
+                    "incremental search literal %s: %s" % (typed, starts))
+        if base == "" and option == onigmo.ONIG_OPTION_IGNORECASE:
+            check(starts == start_offsets(subject, [4, 25, 32]),
+                    "incremental search ignorecase %s: %s" % (typed, starts))
+
+    # the typed text is under the options at the end of the pattern
+    for base, typed, subject, expected in [("(?i)", "foo", "xFOO", [1]),
+            ("a(?i)", "b", "aB Ab", [0]), ("(?i:a)", "b", "AB Ab", [3]),
+            ("(?i)a(?-i)", "b", "AB Ab", [3]), ("a|(?i)", "b", "aB", [0, 1])]:
+        prev = onigmo.OnigRegex()
+        emptyp = strptr(b"")
+        onigmo.onig_new(ctypes.byref(prev), emptyp.getptr(), emptyp.getptr(-1),
+                onigmo.ONIG_OPTION_NONE, onig_encoding, syntax_default,
+                ctypes.byref(einfo))
+        basep = strptr(base.encode(encoding))
+        typedp = strptr(typed.encode(encoding))
+        reg = onigmo.OnigRegex()
+        r = onigmo.onig_new_append(ctypes.byref(reg), prev,
+                basep.getptr(), basep.getptr(-1),
+                typedp.getptr(), typedp.getptr(-1), ctypes.byref(einfo))
+        found = scan_starts(reg, subject.encode(encoding), None) \
+                if r == 0 else r
+        check(found == start_offsets(subject, expected),
+                "append /%s/ + %s in %s: %s" % (base, typed, subject, found))
+        if r == 0:
+            onigmo.onig_free(reg)
+        onigmo.onig_free(prev)
+
     # syntax functions
     onigmo.onig_set_syntax_op(syntax_default,
         onigmo.onig_get_syntax_op(onigmo.ONIG_SYNTAX_DEFAULT))
@@ -0,0 +1,94 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# Make the Grapheme_Cluster_Break table used by \X from name2ctype.h.
+#
+# Usage:
+#   $ python grapheme-break.py name2ctype.h > graphemebreak.h
+
+from __future__ import print_function
+import sys
+import re
+
+# (property in name2ctype.h, value in the table)
+properties = [
+    ("Grapheme_Cluster_Break_CR",          "ONIGENC_GCB_CR"),
+    ("Grapheme_Cluster_Break_LF",          "ONIGENC_GCB_LF"),
+    ("Grapheme_Cluster_Break_Control",     "ONIGENC_GCB_CONTROL"),
+    ("Grapheme_Cluster_Break_Extend",      "ONIGENC_GCB_EXTEND"),
+    ("Grapheme_Cluster_Break_ZWJ",         "ONIGENC_GCB_ZWJ"),
+    ("Regional_Indicator",                 "ONIGENC_GCB_REGIONAL_INDICATOR"),
+    ("Grapheme_Cluster_Break_Prepend",     "ONIGENC_GCB_PREPEND"),
+    ("Grapheme_Cluster_Break_SpacingMark", "ONIGENC_GCB_SPACINGMARK"),
+    ("Grapheme_Cluster_Break_L",           "ONIGENC_GCB_L"),
+    ("Grapheme_Cluster_Break_V",           "ONIGENC_GCB_V"),
+    ("Grapheme_Cluster_Break_T",           "ONIGENC_GCB_T"),
+    ("Grapheme_Cluster_Break_LV",          "ONIGENC_GCB_LV"),
+    ("Grapheme_Cluster_Break_LVT",         "ONIGENC_GCB_LVT"),
+]
+extpict = "Extended_Pictographic"
+
+def read_ranges(src):
+    ranges = {}
+    aliases = {}
+    for m in re.finditer(r"static const OnigCodePoint CR_(\w+)\[\] = \{\n"
+            r"\t(\d+),\n(.*?)\}; /\* CR_\1 \*/", src, re.S):
+        nums = [int(x, 16) for x in re.findall(r"0x([0-9a-f]+)", m.group(3))]
+        ranges[m.group(1)] = list(zip(nums[0::2], nums[1::2]))
+        if len(ranges[m.group(1)]) != int(m.group(2)):
+            raise ValueError(m.group(1))
+    for m in re.finditer(r"#define CR_(\w+) CR_(\w+)", src):
+        aliases[m.group(1)] = m.group(2)
+    def get(name):
+        while name in aliases:
+            name = aliases[name]
+        return ranges[name]
+    return get
+
+def main():
+    src = open(sys.argv[1]).read()
+    get = read_ranges(src)
+
+    values = {}
+    for prop, value in properties:
+        for lo, hi in get(prop):
+            for c in range(lo, hi + 1):
+                if c in values:
+                    raise ValueError("U+%04X in two classes" % c)
+                values[c] = value
+    for lo, hi in get(extpict):
+        for c in range(lo, hi + 1):
+            values[c] = values.get(c, "0") + "|" + \
+                    "ONIGENC_GCB_EXTENDED_PICTOGRAPHIC"
+
+    # Hangul syllables are LV or LVT by arithmetic, see
+    # onigenc_unicode_grapheme_cluster_break().
+    for c in range(0xac00, 0xd7a4):
+        if (c - 0xac00) % 28 == 0:
+            expected = "ONIGENC_GCB_LV"
+        else:
+            expected = "ONIGENC_GCB_LVT"
+        if values.pop(c) != expected:
+            raise ValueError("U+%04X" % c)
+
+    table = []
+    for c in sorted(values):
+        if table and table[-1][1] == c - 1 and table[-1][2] == values[c]:
+            table[-1][1] = c
+        else:
+            table.append([c, c, values[c]])
+
+    print("/* This file was generated by tool/grapheme-break.py. */")
+    print()
+    print("/* Grapheme_Cluster_Break (and Extended_Pictographic) of the code")
+    print(" * points above U+007F, except Hangul syllables. */")
+    print("static const GraphemeBreakRange GraphemeBreakTable[] = {")
+    for lo, hi, value in table:
+        if lo < 0x80:
+            continue
+        value = value.replace("0|", "")
+        print("  { 0x%04x, 0x%04x, %s }," % (lo, hi, value))
+    print("};")
+
+if __name__ == '__main__':
+    main()
@@ -44,6 +44,7 @@
 #define GETGROUPS_T int
 #define RETSIGTYPE void
 #define HAVE_ALLOCA 1
+#define ONIG_THREAD_LOCAL __declspec(thread)
 #define HAVE_DUP2 1
 #define HAVE_MEMCMP 1
 #define HAVE_MEMMOVE 1